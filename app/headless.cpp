@@ -0,0 +1,358 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "kernels.h"
+#include "profiler.h"
+#include "scene.h"
+
+#include "../src/private_impl/renderers/renderer_path.h"
+#include "../src/private_impl/renderers/renderer_whitted.h"
+
+using Raytracer::Scene;
+using Raytracer::Graphics::FrameBudget;
+using Raytracer::Graphics::Renderer;
+using Raytracer::Graphics::RendererPath;
+using Raytracer::Graphics::RendererWhitted;
+
+namespace {
+struct Options
+{
+  std::string scene = "cornell";
+  /// whitted or path
+  std::string renderer = "whitted";
+  uint16_t width = 800;
+  uint16_t height = 600;
+  uint32_t frames = 1;
+  uint32_t threads = 0;
+  uint8_t samples_per_pixel = 1;
+  bool adaptive_anti_aliasing = false;
+  bool reuse_primary_hits = false;
+  bool pin_threads = false;
+  bool node_local_buffers = false;
+  bool replicate_scene = false;
+  std::string output = "render.ppm";
+  /// Timing report is printed to stdout if empty
+  std::string report = "";
+  /// Chrome trace of the run is only recorded if set
+  std::string trace = "";
+};
+
+void
+print_usage(const char* program)
+{
+  std::cerr << "Usage: " << program << " [options] [scene]\n"
+            << "Renders frames of a scene with a cpu renderer, without a "
+               "window.\n"
+            << "Scenes are cornell (default), whitted, mandelbulb or the path "
+               "of a glTF file.\n"
+            << "  --renderer <name>      whitted (default) or path, whose "
+               "frames add up\n"
+            << "  --width <pixels>       default 800\n"
+            << "  --height <pixels>      default 600\n"
+            << "  --frames <count>       default 1\n"
+            << "  --threads <count>      default 0, one per hardware thread\n"
+            << "  --spp <samples>        samples per pixel, default 1\n"
+            << "Whitted only:\n"
+            << "  --adaptive-aa          anti-alias edges with 4 samples\n"
+            << "  --reuse-primary-hits   shade the primary hits of the first "
+               "frame again\n"
+            << "  --pin-threads          keep each thread to a cpu, by NUMA "
+               "node\n"
+            << "  --node-local-buffers   place frame buffers on the node of "
+               "their pinned thread\n"
+            << "  --replicate-scene      trace a copy of the scene on each "
+               "NUMA node\n"
+            << "Output:\n"
+            << "  --output <file.ppm>    default render.ppm\n"
+            << "  --report <file.json>   timing report, default stdout\n"
+            << "  --trace <file.json>    record a Chrome trace of the run\n"
+            << "Set RAYTRACER_NUMA_NODES to emulate that many NUMA nodes.\n";
+}
+
+bool
+parse_number(const char* text, uint32_t max, uint32_t& value)
+{
+  char* end = nullptr;
+  auto result = std::strtoul(text, &end, 10);
+  if (end == text || *end != '\0' || result > max) {
+    return false;
+  }
+  value = static_cast<uint32_t>(result);
+  return true;
+}
+
+bool
+parse_options(int argc, char* argv[], Options& options)
+{
+  for (int i = 1; i < argc; ++i) {
+    std::string argument = argv[i];
+    if (argument == "--help" || argument == "-h") {
+      return false;
+    }
+    if (argument == "--adaptive-aa") {
+      options.adaptive_anti_aliasing = true;
+      continue;
+    }
+    if (argument == "--reuse-primary-hits") {
+      options.reuse_primary_hits = true;
+      continue;
+    }
+    if (argument == "--pin-threads") {
+      options.pin_threads = true;
+      continue;
+    }
+    if (argument == "--node-local-buffers") {
+      options.node_local_buffers = true;
+      continue;
+    }
+    if (argument == "--replicate-scene") {
+      options.replicate_scene = true;
+      continue;
+    }
+    if (argument.rfind("--", 0) != 0) {
+      options.scene = argument;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      std::cerr << "Err: Missing value for " << argument << std::endl;
+      return false;
+    }
+    const char* value = argv[++i];
+    uint32_t number = 0;
+    bool valid = true;
+    if (argument == "--renderer") {
+      options.renderer = value;
+      valid = options.renderer == "whitted" || options.renderer == "path";
+    } else if (argument == "--width") {
+      valid = parse_number(value, UINT16_MAX, number) && number > 0;
+      options.width = static_cast<uint16_t>(number);
+    } else if (argument == "--height") {
+      valid = parse_number(value, UINT16_MAX, number) && number > 0;
+      options.height = static_cast<uint16_t>(number);
+    } else if (argument == "--frames") {
+      valid = parse_number(value, UINT32_MAX, number) && number > 0;
+      options.frames = number;
+    } else if (argument == "--threads") {
+      valid = parse_number(value, UINT32_MAX, number);
+      options.threads = number;
+    } else if (argument == "--spp") {
+      valid = parse_number(value, UINT8_MAX, number) && number > 0;
+      options.samples_per_pixel = static_cast<uint8_t>(number);
+    } else if (argument == "--output") {
+      options.output = value;
+    } else if (argument == "--report") {
+      options.report = value;
+    } else if (argument == "--trace") {
+      options.trace = value;
+    } else {
+      std::cerr << "Err: Unknown option " << argument << std::endl;
+      return false;
+    }
+    if (!valid) {
+      std::cerr << "Err: Invalid value " << value << " for " << argument
+                << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<Scene>
+load_scene(const std::string& name)
+{
+  if (name == "cornell") {
+    return Scene::load_cornell_box();
+  }
+  if (name == "whitted") {
+    return Scene::load_whitted_scene();
+  }
+  if (name == "mandelbulb") {
+    return Scene::load_mandrelbulb();
+  }
+  return Scene::load_from_gltf(name);
+}
+
+/// Binary ppm, top row first
+bool
+write_ppm(const std::string& file_name,
+          const std::vector<uint32_t>& frame,
+          uint16_t width,
+          uint16_t height)
+{
+  std::ofstream file(file_name, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  file << "P6\n" << width << " " << height << "\n255\n";
+  std::vector<uint8_t> row(width * 3);
+  for (int32_t y = height - 1; y >= 0; --y) {
+    for (uint16_t x = 0; x < width; ++x) {
+      auto color = frame[x + y * width];
+      for (uint8_t i = 0; i < 3; ++i) {
+        row[x * 3 + i] = static_cast<uint8_t>(color >> (i * 8));
+      }
+    }
+    file.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+  return static_cast<bool>(file);
+}
+
+std::string
+escape_json(const std::string& text)
+{
+  std::string result;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+      result += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      result += escaped;
+    } else {
+      result += c;
+    }
+  }
+  return result;
+}
+
+void
+write_report(std::ostream& stream,
+             const Options& options,
+             const Renderer& renderer,
+             const std::vector<double>& frame_times)
+{
+  double total = 0.0;
+  for (auto time : frame_times) {
+    total += time;
+  }
+  auto sorted = frame_times;
+  std::sort(sorted.begin(), sorted.end());
+  double samples = static_cast<double>(options.width) * options.height *
+                   options.samples_per_pixel * frame_times.size();
+
+  stream << "{\n"
+         << "  \"scene\": \"" << escape_json(options.scene) << "\",\n"
+         << "  \"renderer\": \"" << options.renderer << "\",\n"
+         << "  \"width\": " << options.width << ",\n"
+         << "  \"height\": " << options.height << ",\n"
+         << "  \"threads\": " << renderer.get_thread_count() << ",\n"
+         << "  \"samples_per_pixel\": "
+         << static_cast<uint32_t>(options.samples_per_pixel) << ",\n"
+         << "  \"adaptive_anti_aliasing\": "
+         << (options.adaptive_anti_aliasing ? "true" : "false") << ",\n"
+         << "  \"reuse_primary_hits\": "
+         << (options.reuse_primary_hits ? "true" : "false") << ",\n"
+         << "  \"pin_threads\": " << (options.pin_threads ? "true" : "false")
+         << ",\n"
+         << "  \"node_local_buffers\": "
+         << (options.node_local_buffers ? "true" : "false") << ",\n"
+         << "  \"replicate_scene\": "
+         << (options.replicate_scene ? "true" : "false") << ",\n"
+         << "  \"kernels\": \"" << Raytracer::Kernels::get().name << "\",\n"
+         << "  \"frames\": " << frame_times.size() << ",\n"
+         << "  \"total_ms\": " << total << ",\n"
+         << "  \"mean_ms\": " << total / frame_times.size() << ",\n"
+         << "  \"min_ms\": " << sorted.front() << ",\n"
+         << "  \"median_ms\": " << sorted[sorted.size() / 2] << ",\n"
+         << "  \"max_ms\": " << sorted.back() << ",\n"
+         << "  \"samples_per_second\": "
+         << (total > 0.0 ? samples * 1000.0 / total : 0.0) << ",\n"
+         << "  \"frame_ms\": [";
+  for (size_t i = 0; i < frame_times.size(); ++i) {
+    stream << (i > 0 ? ", " : "") << frame_times[i];
+  }
+  stream << "]\n}\n";
+}
+} // namespace
+
+int
+main(int argc, char* argv[])
+{
+  Options options;
+  if (!parse_options(argc, argv, options)) {
+    print_usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  Raytracer::Profiler::set_thread_name("main");
+  if (!options.trace.empty()) {
+    Raytracer::Profiler::set_enabled(true);
+  }
+
+  auto scene = load_scene(options.scene);
+  if (!scene) {
+    std::cerr << "Err: Could not load scene " << options.scene << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::unique_ptr<RendererWhitted> whitted;
+  std::unique_ptr<RendererPath> path;
+  Renderer* renderer = nullptr;
+  if (options.renderer == "path") {
+    // The camera stays still, so the last frame averages the samples of all
+    // of them
+    path = std::make_unique<RendererPath>(nullptr);
+    path->set_thread_count(options.threads);
+    path->set_samples_per_pixel(options.samples_per_pixel);
+    renderer = path.get();
+  } else {
+    // Every frame is traced in full at the requested resolution so timings
+    // are comparable between runs, unless primary hits are reused
+    whitted = std::make_unique<RendererWhitted>(nullptr);
+    whitted->set_thread_count(options.threads);
+    whitted->set_pinned_threads(options.pin_threads);
+    whitted->set_node_local_buffers(options.node_local_buffers);
+    whitted->set_scene_replicas(options.replicate_scene);
+    whitted->set_samples_per_pixel(options.samples_per_pixel);
+    whitted->set_frame_budget_policy(FrameBudget::Policy::Fixed);
+    whitted->set_progressive(false);
+    whitted->set_adaptive_anti_aliasing(options.adaptive_anti_aliasing);
+    whitted->set_reuse_primary_hits(options.reuse_primary_hits);
+    renderer = whitted.get();
+  }
+  renderer->set_backbuffer_size(options.width, options.height);
+  scene->run(options.width, options.height);
+
+  std::vector<double> frame_times;
+  frame_times.reserve(options.frames);
+  for (uint32_t i = 0; i < options.frames; ++i) {
+    auto frame_start = std::chrono::steady_clock::now();
+    renderer->run(*scene);
+    std::chrono::duration<double, std::milli> frame_time =
+      std::chrono::steady_clock::now() - frame_start;
+    frame_times.push_back(frame_time.count());
+    scene->run(options.width, options.height);
+  }
+
+  auto& frame = path ? path->get_frame() : whitted->get_frame();
+  if (!write_ppm(options.output, frame, options.width, options.height)) {
+    std::cerr << "Err: Could not write " << options.output << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  if (options.report.empty()) {
+    write_report(std::cout, options, *renderer, frame_times);
+  } else {
+    std::ofstream report(options.report);
+    write_report(report, options, *renderer, frame_times);
+    if (!report) {
+      std::cerr << "Err: Could not write " << options.report << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!options.trace.empty() && !Raytracer::Profiler::dump(options.trace)) {
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -2,7 +2,8 @@
 
 #include <array>
 
-#include <aabb.h>
+#include <aabb_simd.h>
+#include <math/random.h>
 #include <math/vec3_simd.h>
 #include <ray.h>
 
@@ -168,11 +169,11 @@ ray_aabb_simd4_hit_random(benchmark::State& state)
   }
   uint32_t intersection_count = 0;
   for (auto _ : state) {
-    AabbSimd<simd_multiplier>::hit(
+    benchmark::DoNotOptimize(AabbSimd<simd_multiplier>::hit(
       combos[intersection_count % combos.size()].box,
       combos[intersection_count % combos.size()].ray,
       float_simd_t<simd_multiplier>(0.0f),
-      float_simd_t<simd_multiplier>(1e10f));
+      float_simd_t<simd_multiplier>(1e10f)));
     ++intersection_count;
   }
   state.counters["intersections_per_second"] =
@@ -212,11 +213,11 @@ ray_aabb_simd8_hit_random(benchmark::State& state)
   }
   uint32_t intersection_count = 0;
   for (auto _ : state) {
-    AabbSimd<simd_multiplier>::hit(
+    benchmark::DoNotOptimize(AabbSimd<simd_multiplier>::hit(
       combos[intersection_count % combos.size()].box,
       combos[intersection_count % combos.size()].ray,
       float_simd_t<simd_multiplier>(0.0f),
-      float_simd_t<simd_multiplier>(1e10f));
+      float_simd_t<simd_multiplier>(1e10f)));
     ++intersection_count;
   }
   state.counters["intersections_per_second"] =
@@ -224,6 +225,44 @@ ray_aabb_simd8_hit_random(benchmark::State& state)
 }
 BENCHMARK(ray_aabb_simd8_hit_random);
 
+#if __AVX512F__
+static void
+ray_aabb_simd16_hit_random(benchmark::State& state)
+{
+  constexpr uint8_t simd_multiplier = 16;
+  struct ray_aabb_combo
+  {
+    AabbSimd<simd_multiplier> box;
+    Ray ray;
+  };
+  std::array<ray_aabb_combo, 1000> combos;
+  for (uint32_t i = 0; i < combos.size(); ++i) {
+    combos[i].ray = Ray(random_in_unit_sphere(), random_in_unit_sphere());
+    combos[i].ray.direction.make_unit_vector();
+    vec3 min[simd_multiplier];
+    vec3 max[simd_multiplier];
+    for (uint8_t j = 0; j < simd_multiplier; ++j) {
+      min[j] = random_in_unit_sphere();
+      max[j] = random_in_unit_sphere();
+    }
+    combos[i].box.min = vec3_simd<simd_multiplier>(min);
+    combos[i].box.max = vec3_simd<simd_multiplier>(max);
+  }
+  uint32_t intersection_count = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(AabbSimd<simd_multiplier>::hit(
+      combos[intersection_count % combos.size()].box,
+      combos[intersection_count % combos.size()].ray,
+      float_simd_t<simd_multiplier>(0.0f),
+      float_simd_t<simd_multiplier>(1e10f)));
+    ++intersection_count;
+  }
+  state.counters["intersections_per_second"] =
+    intersection_count * simd_multiplier;
+}
+BENCHMARK(ray_aabb_simd16_hit_random);
+#endif
+
 static void
 ray_simd4_aabb_hit_random(benchmark::State& state)
 {
@@ -251,10 +290,11 @@ ray_simd4_aabb_hit_random(benchmark::State& state)
   }
   uint32_t intersection_count = 0;
   for (auto _ : state) {
-    Aabb::hit(combos[intersection_count % combos.size()].box,
-              combos[intersection_count % combos.size()].ray,
-              float_simd_t<simd_multiplier>(0.0f),
-              float_simd_t<simd_multiplier>(1e10f));
+    benchmark::DoNotOptimize(
+      Aabb::hit(combos[intersection_count % combos.size()].box,
+                combos[intersection_count % combos.size()].ray,
+                float_simd_t<simd_multiplier>(0.0f),
+                float_simd_t<simd_multiplier>(1e10f)));
     ++intersection_count;
   }
   state.counters["intersections_per_second"] =
@@ -297,13 +337,53 @@ ray_simd8_aabb_hit_random(benchmark::State& state)
   }
   uint32_t intersection_count = 0;
   for (auto _ : state) {
-    Aabb::hit(combos[intersection_count % combos.size()].box,
-              combos[intersection_count % combos.size()].ray,
-              float_simd_t<simd_multiplier>(0.0f),
-              float_simd_t<simd_multiplier>(1e10f));
+    benchmark::DoNotOptimize(
+      Aabb::hit(combos[intersection_count % combos.size()].box,
+                combos[intersection_count % combos.size()].ray,
+                float_simd_t<simd_multiplier>(0.0f),
+                float_simd_t<simd_multiplier>(1e10f)));
     ++intersection_count;
   }
   state.counters["intersections_per_second"] =
     intersection_count * simd_multiplier;
 }
 BENCHMARK(ray_simd8_aabb_hit_random);
+
+#if __AVX512F__
+static void
+ray_simd16_aabb_hit_random(benchmark::State& state)
+{
+  constexpr uint8_t simd_multiplier = 16;
+  struct ray_aabb_combo
+  {
+    Aabb box;
+    RaySimd<simd_multiplier> ray;
+  };
+  std::array<ray_aabb_combo, 1000> combos;
+  for (uint32_t i = 0; i < combos.size(); ++i) {
+    vec3 origins[simd_multiplier];
+    vec3 directions[simd_multiplier];
+    for (uint8_t j = 0; j < simd_multiplier; ++j) {
+      origins[j] = random_in_unit_sphere();
+      directions[j] = random_in_unit_sphere();
+    }
+    combos[i].ray.origin = vec3_simd<simd_multiplier>(origins);
+    combos[i].ray.direction = vec3_simd<simd_multiplier>(directions);
+    combos[i].ray.direction.make_unit_vector();
+    combos[i].box.min = random_in_unit_sphere();
+    combos[i].box.max = random_in_unit_sphere();
+  }
+  uint32_t intersection_count = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+      Aabb::hit(combos[intersection_count % combos.size()].box,
+                combos[intersection_count % combos.size()].ray,
+                float_simd_t<simd_multiplier>(0.0f),
+                float_simd_t<simd_multiplier>(1e10f)));
+    ++intersection_count;
+  }
+  state.counters["intersections_per_second"] =
+    intersection_count * simd_multiplier;
+}
+BENCHMARK(ray_simd16_aabb_hit_random);
+#endif
@@ -1,7 +1,9 @@
 #include <benchmark/benchmark.h>
 
 #include <memory>
+#include <set>
 
+#include <hittable/instance.h>
 #include <hittable/triangle_mesh.h>
 #include <scene.h>
 
@@ -148,15 +150,28 @@ protected:
   void SetUp(::benchmark::State& state) override
   {
     auto scene = Scene::load_from_gltf(get_filename().data());
+    // Meshes are instanced, only build each shared mesh once
+    std::set<const Object*> shared_meshes;
     for (auto& object : scene->get_world()) {
-      auto triangles = dynamic_cast<TriangleMesh*>(object.get());
-      if (triangles) {
-        meshes.emplace_back(std::make_unique<TriangleMesh>(
-          *dynamic_cast<TriangleMesh*>(scene->get_world()[0].get())));
+      auto instance = dynamic_cast<const Instance*>(object.get());
+      if (instance && shared_meshes.insert(instance->blas.get()).second) {
+        auto triangles =
+          dynamic_cast<const TriangleMesh*>(instance->blas.get());
+        if (triangles) {
+          meshes.emplace_back(std::make_unique<TriangleMesh>(*triangles));
+        }
       }
     }
     TriangleBvhFixture::SetUp(state);
   }
+
+  void load_test(benchmark::State& state)
+  {
+    for (auto _ : state) {
+      auto scene = Scene::load_from_gltf(get_filename().data());
+      benchmark::DoNotOptimize(scene.get());
+    }
+  }
 };
 
 class BoxTextured : public GltfFixture
@@ -170,6 +185,11 @@ BENCHMARK_F(BoxTextured, BuildBvh)(benchmark::State& state)
   build_bvh_test(state);
 }
 
+BENCHMARK_F(BoxTextured, Load)(benchmark::State& state)
+{
+  load_test(state);
+}
+
 class Duck : public GltfFixture
 {
 protected:
@@ -181,6 +201,11 @@ BENCHMARK_F(Duck, BuildBvh)(benchmark::State& state)
   build_bvh_test(state);
 }
 
+BENCHMARK_F(Duck, Load)(benchmark::State& state)
+{
+  load_test(state);
+}
+
 class DamagedHelmet : public GltfFixture
 {
 protected:
@@ -195,6 +220,11 @@ BENCHMARK_F(DamagedHelmet, BuildBvh)(benchmark::State& state)
   build_bvh_test(state);
 }
 
+BENCHMARK_F(DamagedHelmet, Load)(benchmark::State& state)
+{
+  load_test(state);
+}
+
 class Sponza : public GltfFixture
 {
 protected:
@@ -205,3 +235,8 @@ BENCHMARK_F(Sponza, BuildBvh)(benchmark::State& state)
 {
   build_bvh_test(state);
 }
+
+BENCHMARK_F(Sponza, Load)(benchmark::State& state)
+{
+  load_test(state);
+}
@@ -0,0 +1,99 @@
+#include <benchmark/benchmark.h>
+
+#include <camera.h>
+#include <kernels.h>
+#include <ray.h>
+
+using Raytracer::Camera;
+using Raytracer::Ray;
+using Raytracer::Kernels::Isa;
+using Raytracer::Math::vec3;
+
+constexpr uint16_t frame_width = 1280;
+constexpr uint16_t frame_height = 720;
+constexpr uint16_t row_length = 16;
+
+static Camera
+make_camera()
+{
+  return Camera(vec3(0, 1, 5),
+                vec3(0, 0, -1),
+                vec3(0, 1, 0),
+                60.0f,
+                static_cast<float>(frame_width) / frame_height,
+                1.0f,
+                0.0f);
+}
+
+// One scalar call per pixel, the way primary rays used to be computed
+static void
+camera_get_ray(benchmark::State& state)
+{
+  auto camera = make_camera();
+  Ray rays[row_length];
+  uint32_t pixel = 0;
+  for (auto _ : state) {
+    uint16_t x = pixel % frame_width;
+    uint16_t y = (pixel / frame_width) % frame_height;
+    for (uint16_t i = 0; i < row_length; ++i) {
+      rays[i] = camera.get_ray(static_cast<float>(x + i) / frame_width,
+                               static_cast<float>(y) / frame_height);
+    }
+    benchmark::DoNotOptimize(rays);
+    pixel += row_length;
+  }
+  state.counters["rays_per_second"] = ::benchmark::Counter(
+    static_cast<double>(pixel), benchmark::Counter::kIsRate);
+}
+BENCHMARK(camera_get_ray);
+
+// Rows of a tile at a time with the kernels of each instruction set
+static void
+camera_rays_isa(benchmark::State& state)
+{
+  auto previous_isa = Raytracer::Kernels::get().isa;
+  if (!Raytracer::Kernels::select(static_cast<Isa>(state.range(0)))) {
+    state.SkipWithError("instruction set not supported by this cpu");
+    return;
+  }
+  auto& kernels = Raytracer::Kernels::get();
+  state.SetLabel(kernels.name);
+
+  auto camera = make_camera();
+  Ray rays[row_length];
+  float jitter[row_length * 2];
+  for (uint16_t i = 0; i < row_length * 2; ++i) {
+    jitter[i] = 0.5f;
+  }
+  bool jittered = state.range(1) != 0;
+  uint32_t pixel = 0;
+  for (auto _ : state) {
+    uint16_t x = pixel % frame_width;
+    uint16_t y = (pixel / frame_width) % frame_height;
+    kernels.camera_rays(camera,
+                        frame_width,
+                        frame_height,
+                        x,
+                        y,
+                        row_length,
+                        jittered ? jitter : nullptr,
+                        rays);
+    benchmark::DoNotOptimize(rays);
+    pixel += row_length;
+  }
+  state.counters["rays_per_second"] = ::benchmark::Counter(
+    static_cast<double>(pixel), benchmark::Counter::kIsRate);
+  Raytracer::Kernels::select(previous_isa);
+}
+
+static void
+camera_rays_isa_arguments(benchmark::internal::Benchmark* benchmark)
+{
+  for (int isa = static_cast<int>(Isa::Scalar);
+       isa <= static_cast<int>(Isa::Avx512);
+       ++isa) {
+    benchmark->Args({ isa, 0 });
+    benchmark->Args({ isa, 1 });
+  }
+}
+BENCHMARK(camera_rays_isa)->Apply(camera_rays_isa_arguments);
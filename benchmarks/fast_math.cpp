@@ -0,0 +1,133 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cmath>
+
+#include <math/fast_math.h>
+
+using Raytracer::Math::float_simd_t;
+namespace fast = Raytracer::Math::fast;
+
+constexpr uint32_t input_count = 0x400;
+
+/// Inputs spread over [min, max]
+static std::array<float, input_count>
+make_inputs(float min, float max)
+{
+  std::array<float, input_count> inputs;
+  for (uint32_t i = 0; i < input_count; ++i) {
+    inputs[i] = min + (max - min) * static_cast<float>(i) / input_count;
+  }
+  return inputs;
+}
+
+template<uint8_t D>
+struct Lanes
+{
+  typedef float_simd_t<D> type;
+  static type load(const float* values) { return type(values); }
+};
+
+template<>
+struct Lanes<1>
+{
+  typedef float type;
+  static type load(const float* values) { return *values; }
+};
+
+/// Evaluate a function over all inputs, D at a time
+template<uint8_t D, typename F>
+static void
+evaluate(benchmark::State& state, float min, float max, F function)
+{
+  auto inputs = make_inputs(min, max);
+  uint64_t evaluation_count = 0;
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < input_count; i += D) {
+      auto result = function(Lanes<D>::load(&inputs[i]));
+      benchmark::DoNotOptimize(result);
+    }
+    evaluation_count += input_count;
+  }
+  state.counters["evaluations_per_second"] = ::benchmark::Counter(
+    static_cast<double>(evaluation_count), benchmark::Counter::kIsRate);
+}
+
+#define FAST_MATH_BENCHMARKS(name, min, max)                                   \
+  static void std_##name(benchmark::State& state)                              \
+  {                                                                            \
+    evaluate<1>(state, min, max, [](float x) { return std::name(x); });        \
+  }                                                                            \
+  BENCHMARK(std_##name);                                                       \
+  static void fast_##name(benchmark::State& state)                             \
+  {                                                                            \
+    evaluate<1>(state, min, max, [](float x) { return fast::name(x); });       \
+  }                                                                            \
+  BENCHMARK(fast_##name);                                                      \
+  static void fast_simd4_##name(benchmark::State& state)                       \
+  {                                                                            \
+    evaluate<4>(                                                               \
+      state, min, max, [](float_simd_t<4> x) { return fast::name(x); });      \
+  }                                                                            \
+  BENCHMARK(fast_simd4_##name);                                                \
+  static void fast_simd8_##name(benchmark::State& state)                       \
+  {                                                                            \
+    evaluate<8>(                                                               \
+      state, min, max, [](float_simd_t<8> x) { return fast::name(x); });      \
+  }                                                                            \
+  BENCHMARK(fast_simd8_##name)
+
+FAST_MATH_BENCHMARKS(asin, -1.0f, 1.0f);
+FAST_MATH_BENCHMARKS(acos, -1.0f, 1.0f);
+FAST_MATH_BENCHMARKS(sin, -10.0f, 10.0f);
+FAST_MATH_BENCHMARKS(cos, -10.0f, 10.0f);
+FAST_MATH_BENCHMARKS(exp, -10.0f, 10.0f);
+FAST_MATH_BENCHMARKS(log, 0.001f, 100.0f);
+
+static void
+std_atan2(benchmark::State& state)
+{
+  evaluate<1>(
+    state, -10.0f, 10.0f, [](float x) { return std::atan2(x, 1.0f - x); });
+}
+BENCHMARK(std_atan2);
+
+static void
+fast_atan2(benchmark::State& state)
+{
+  evaluate<1>(
+    state, -10.0f, 10.0f, [](float x) { return fast::atan2(x, 1.0f - x); });
+}
+BENCHMARK(fast_atan2);
+
+static void
+fast_simd8_atan2(benchmark::State& state)
+{
+  evaluate<8>(state, -10.0f, 10.0f, [](float_simd_t<8> x) {
+    return fast::atan2(x, float_simd_t<8>(1.0f) - x);
+  });
+}
+BENCHMARK(fast_simd8_atan2);
+
+static void
+std_pow(benchmark::State& state)
+{
+  evaluate<1>(state, 0.0f, 2.0f, [](float x) { return std::pow(x, 8.0f); });
+}
+BENCHMARK(std_pow);
+
+static void
+fast_pow(benchmark::State& state)
+{
+  evaluate<1>(state, 0.0f, 2.0f, [](float x) { return fast::pow(x, 8.0f); });
+}
+BENCHMARK(fast_pow);
+
+static void
+fast_simd8_pow(benchmark::State& state)
+{
+  evaluate<8>(state, 0.0f, 2.0f, [](float_simd_t<8> x) {
+    return fast::pow(x, float_simd_t<8>(8.0f));
+  });
+}
+BENCHMARK(fast_simd8_pow);
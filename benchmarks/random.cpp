@@ -0,0 +1,84 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+
+#include <math/random.h>
+
+using Raytracer::Math::float_simd_t;
+using Raytracer::Math::low_discrepancy_sample;
+using Raytracer::Math::random_unit_float;
+using Raytracer::Math::random_unit_floats;
+
+constexpr uint32_t pixel_count = 0x400;
+
+/// Draws from std::rand, whose state is shared by every thread
+static void
+std_rand(benchmark::State& state)
+{
+  uint64_t number_count = 0;
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < pixel_count; ++i) {
+      auto result = static_cast<float>(std::rand()) / (RAND_MAX + 1.0f);
+      benchmark::DoNotOptimize(result);
+    }
+    number_count += pixel_count;
+  }
+  state.counters["numbers_per_second"] = ::benchmark::Counter(
+    static_cast<double>(number_count), benchmark::Counter::kIsRate);
+}
+BENCHMARK(std_rand)->ThreadRange(1, 8)->UseRealTime();
+
+/// Draws one number for each of the pixels, D at a time
+template<uint8_t D, typename F>
+static void
+draw(benchmark::State& state, F function)
+{
+  uint32_t sample = 0;
+  uint64_t number_count = 0;
+  for (auto _ : state) {
+    for (uint32_t i = 0; i < pixel_count; i += D) {
+      auto result = function(i, sample);
+      benchmark::DoNotOptimize(result);
+    }
+    ++sample;
+    number_count += pixel_count;
+  }
+  state.counters["numbers_per_second"] = ::benchmark::Counter(
+    static_cast<double>(number_count), benchmark::Counter::kIsRate);
+}
+
+static void
+pcg4d(benchmark::State& state)
+{
+  draw<1>(state, [](uint32_t pixel, uint32_t sample) {
+    return random_unit_float(pixel, sample, 0, 0);
+  });
+}
+BENCHMARK(pcg4d)->ThreadRange(1, 8)->UseRealTime();
+
+static void
+pcg4d_simd4(benchmark::State& state)
+{
+  draw<4>(state, [](uint32_t pixel, uint32_t sample) {
+    return random_unit_floats<4>(pixel, sample, 0, 0);
+  });
+}
+BENCHMARK(pcg4d_simd4)->ThreadRange(1, 8)->UseRealTime();
+
+static void
+pcg4d_simd8(benchmark::State& state)
+{
+  draw<8>(state, [](uint32_t pixel, uint32_t sample) {
+    return random_unit_floats<8>(pixel, sample, 0, 0);
+  });
+}
+BENCHMARK(pcg4d_simd8)->ThreadRange(1, 8)->UseRealTime();
+
+static void
+sample_02(benchmark::State& state)
+{
+  draw<1>(state, [](uint32_t pixel, uint32_t sample) {
+    return low_discrepancy_sample(pixel, sample, 0, 0);
+  });
+}
+BENCHMARK(sample_02)->ThreadRange(1, 8)->UseRealTime();
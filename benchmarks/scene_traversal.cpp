@@ -1,22 +1,64 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
 #include <random>
 
 #include <benchmark/benchmark.h>
 
 #include <camera.h>
+#include <hittable/point.h>
+#include <kernels.h>
+#include <materials/emissive_quadratic_drop_off.h>
+#include <math/fast_math.h>
+#include <math/random.h>
 #include <ray.h>
 #include <scene.h>
 
+#include "../src/private_impl/renderers/renderer_path.h"
 #include "../src/private_impl/renderers/renderer_whitted.h"
 
 using Raytracer::Camera;
 using Raytracer::Ray;
 using Raytracer::Scene;
+using Raytracer::Graphics::RendererPath;
 using Raytracer::Graphics::RendererWhitted;
+using Raytracer::Hittable::Point;
+using Raytracer::Kernels::Isa;
+using Raytracer::Materials::EmissiveQuadraticDropOff;
+using Raytracer::Math::Accuracy;
 using Raytracer::Math::random_double;
+using Raytracer::Math::random_unit_float;
+using Raytracer::Math::transcendental_accuracy;
 using Raytracer::Math::vec3;
 
 constexpr uint32_t ray_count = 0x1000;
 
+/// Heap allocations made by the calling thread, counted by operator new
+thread_local uint64_t heap_allocations = 0;
+
+void*
+operator new(std::size_t size)
+{
+  heap_allocations++;
+  auto memory = std::malloc(size > 0 ? size : 1);
+  if (memory == nullptr) {
+    std::abort();
+  }
+  return memory;
+}
+
+void
+operator delete(void* memory) noexcept
+{
+  std::free(memory);
+}
+
+void
+operator delete(void* memory, std::size_t) noexcept
+{
+  std::free(memory);
+}
+
 /// Base fixture: This sets up the renderer and generates rays
 class BaseSceneFixture : public ::benchmark::Fixture
 {
@@ -27,8 +69,11 @@ protected:
     total_rays = 0;
 
     renderer = std::make_unique<RendererWhitted>(nullptr);
-    for (auto& r : rays) {
-      r = scene->get_camera().get_ray(random_double(), random_double());
+    renderer->build_light_tree(*scene);
+    // The same rays for every benchmark
+    for (uint32_t i = 0; i < ray_count; ++i) {
+      rays[i] = scene->get_camera().get_ray(random_unit_float(i, 0, 0, 0),
+                                            random_unit_float(i, 0, 0, 1));
     }
   }
 
@@ -55,6 +100,23 @@ protected:
     }
   }
 
+  /// Same as raygen_test once every ray was traced, failing if any of them
+  /// allocated on the heap
+  inline void raygen_heap_allocations_test(benchmark::State& state)
+  {
+    for (auto& ray : rays) {
+      vec3 color = vec3(0.0f, 0.0f, 0.0f);
+      renderer->raygen(ray, *scene, false, color);
+    }
+    auto allocations = heap_allocations;
+    raygen_test(state);
+    allocations = heap_allocations - allocations;
+    state.counters["heap_allocations"] = static_cast<double>(allocations);
+    if (allocations > 0) {
+      state.SkipWithError("raygen allocated on the heap");
+    }
+  }
+
   std::unique_ptr<RendererWhitted> renderer;
   std::unique_ptr<Scene> scene;
   Ray rays[ray_count];
@@ -77,6 +139,198 @@ BENCHMARK_F(Whitted, PrimaryRayTraverse)(benchmark::State& state)
   raygen_test(state);
 }
 
+BENCHMARK_F(Whitted, RaygenHeapAllocations)(benchmark::State& state)
+{
+  raygen_heap_allocations_test(state);
+}
+
+/// Whole frames rendered by the worker threads, state.range(0) of them
+BENCHMARK_DEFINE_F(Whitted, Frame)(benchmark::State& state)
+{
+  constexpr uint16_t width = 320;
+  constexpr uint16_t height = 240;
+  renderer->set_thread_count(static_cast<uint32_t>(state.range(0)));
+  // Every frame is a full frame, as if the camera had just moved
+  renderer->set_progressive(false);
+  renderer->set_backbuffer_size(width, height);
+  scene->run(width, height);
+
+  float busy_time = 0.0f;
+  float idle_time = 0.0f;
+  for (auto _ : state) {
+    renderer->run(*scene);
+    for (auto& [format, value] : renderer->evaluate_metrics()) {
+      if (format.find("thread busy") != std::string::npos) {
+        busy_time += value;
+      } else if (format.find("thread idle") != std::string::npos) {
+        idle_time += value;
+      }
+    }
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["idle_fraction"] = idle_time / (busy_time + idle_time);
+}
+
+BENCHMARK_REGISTER_F(Whitted, Frame)
+  ->RangeMultiplier(2)
+  ->Range(1, 16)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+/// Full frames with 4 samples on every pixel for state.range(0) == 0, or only
+/// on edges with adaptive anti-aliasing
+BENCHMARK_DEFINE_F(Whitted, AntiAliasedFrame)(benchmark::State& state)
+{
+  constexpr uint16_t width = 320;
+  constexpr uint16_t height = 240;
+  bool adaptive = state.range(0) != 0;
+  state.SetLabel(adaptive ? "adaptive 4x" : "uniform 4x");
+  renderer->set_progressive(false);
+  renderer->set_samples_per_pixel(adaptive ? 1 : 4);
+  renderer->set_adaptive_anti_aliasing(adaptive);
+  renderer->set_adaptive_samples(4);
+  renderer->set_backbuffer_size(width, height);
+  scene->run(width, height);
+
+  float extra_rays = 0.0f;
+  for (auto _ : state) {
+    renderer->run(*scene);
+    for (auto& [format, value] : renderer->evaluate_metrics()) {
+      if (format.find("vs uniform") != std::string::npos) {
+        extra_rays += value;
+      }
+    }
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["extra_rays_vs_uniform_percent"] =
+    adaptive ? extra_rays / state.iterations() : 100.0f;
+}
+
+BENCHMARK_REGISTER_F(Whitted, AntiAliasedFrame)
+  ->Arg(0)
+  ->Arg(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+/// Camera rays through the whitted scene with state.range(0) dim point lights
+/// scattered around it, each only lighting what is near it. Every light is
+/// shaded for state.range(1) == 0, or only those the light tree cannot rule out
+BENCHMARK_DEFINE_F(Whitted, ManyLights)(benchmark::State& state)
+{
+  auto& materials = scene->get_material_list();
+  materials.emplace_back(
+    std::make_unique<EmissiveQuadraticDropOff>(vec3(1, 1, 1), 1e13f));
+  auto mat_id = static_cast<uint16_t>(materials.size() - 1);
+  auto& lights = scene->get_lights();
+  for (int64_t i = 0; i < state.range(0); ++i) {
+    vec3 position(static_cast<float>(random_double() * 1000.0 - 500.0),
+                  5.0f,
+                  static_cast<float>(random_double() * 1000.0 - 500.0));
+    lights.emplace_back(std::make_unique<Point>(position, mat_id));
+  }
+  bool cull = state.range(1) != 0;
+  state.SetLabel(cull ? "light tree" : "every light");
+  if (!cull) {
+    renderer->set_light_threshold(0.0f);
+  }
+  renderer->build_light_tree(*scene);
+  raygen_test(state);
+}
+
+BENCHMARK_REGISTER_F(Whitted, ManyLights)
+  ->RangeMultiplier(4)
+  ->Ranges({ { 16, 1024 }, { 0, 1 } });
+
+/// Still full frames tracing their primary rays again for state.range(0) == 0,
+/// or shading what they hit in the first frame again
+BENCHMARK_DEFINE_F(Whitted, StillFrame)(benchmark::State& state)
+{
+  constexpr uint16_t width = 320;
+  constexpr uint16_t height = 240;
+  bool reuse = state.range(0) != 0;
+  state.SetLabel(reuse ? "reused primary hits" : "traced primary rays");
+  renderer->set_progressive(false);
+  renderer->set_reuse_primary_hits(reuse);
+  renderer->set_backbuffer_size(width, height);
+  scene->run(width, height);
+  renderer->run(*scene);
+  scene->run(width, height);
+
+  for (auto _ : state) {
+    renderer->run(*scene);
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+
+BENCHMARK_REGISTER_F(Whitted, StillFrame)
+  ->Arg(0)
+  ->Arg(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
+/// Time the main loop spends editing the scene and in the renderer each
+/// iteration, tracing every frame itself for state.range(0) == 0, or only
+/// presenting the last frame finished by the render thread
+BENCHMARK_DEFINE_F(Whitted, MainLoopLatency)(benchmark::State& state)
+{
+  constexpr uint16_t width = 320;
+  constexpr uint16_t height = 240;
+  bool asynchronous = state.range(0) != 0;
+  state.SetLabel(asynchronous ? "asynchronous" : "synchronous");
+  renderer->set_progressive(false);
+  renderer->set_backbuffer_size(width, height);
+  renderer->set_asynchronous(asynchronous);
+  scene->run(width, height);
+
+  for (auto _ : state) {
+    // Edits replace what they change, as the interface does
+    auto& world = scene->get_world();
+    world[0] = world[0]->copy();
+    scene->mark_geometry_changed();
+    renderer->run(*scene);
+    scene->run(width, height);
+  }
+  renderer->set_asynchronous(false);
+}
+
+BENCHMARK_REGISTER_F(Whitted, MainLoopLatency)
+  ->Arg(0)
+  ->Arg(1)
+  ->UseRealTime()
+  ->Unit(benchmark::kMicrosecond);
+
+/// Synchronous frames after the render thread was stopped with a frame in
+/// flight, failing if any of them comes out blank
+BENCHMARK_F(Whitted, SynchronousAfterAsynchronous)(benchmark::State& state)
+{
+  constexpr uint16_t width = 160;
+  constexpr uint16_t height = 120;
+  renderer->set_progressive(false);
+  renderer->set_backbuffer_size(width, height);
+  scene->run(width, height);
+  renderer->set_asynchronous(true);
+  renderer->run(*scene);
+  renderer->set_asynchronous(false);
+
+  uint32_t blank_frames = 0;
+  for (auto _ : state) {
+    renderer->run(*scene);
+    auto& frame = renderer->get_frame();
+    if (std::all_of(frame.begin(), frame.end(), [](uint32_t pixel) {
+          return pixel == 0;
+        })) {
+      blank_frames++;
+    }
+  }
+  state.counters["blank_frames"] = blank_frames;
+  if (blank_frames > 0) {
+    state.SkipWithError("synchronous frame left blank");
+  }
+}
+
 class Cornell : public BaseSceneFixture
 {
 protected:
@@ -92,6 +346,11 @@ BENCHMARK_F(Cornell, PrimaryRayTraverse)(benchmark::State& state)
   raygen_test(state);
 }
 
+BENCHMARK_F(Cornell, RaygenHeapAllocations)(benchmark::State& state)
+{
+  raygen_heap_allocations_test(state);
+}
+
 class Mandelbulb : public BaseSceneFixture
 {
 protected:
@@ -107,6 +366,13 @@ BENCHMARK_F(Mandelbulb, PrimaryRayTraverse)(benchmark::State& state)
   raygen_test(state);
 }
 
+BENCHMARK_F(Mandelbulb, PrimaryRayTraverseExactMath)(benchmark::State& state)
+{
+  transcendental_accuracy = Accuracy::Exact;
+  raygen_test(state);
+  transcendental_accuracy = Accuracy::Fast;
+}
+
 class glTFBox : public BaseSceneFixture
 {
 protected:
@@ -137,6 +403,72 @@ BENCHMARK_F(glTFDuck, PrimaryRayTraverse)(benchmark::State& state)
   raygen_test(state);
 }
 
+BENCHMARK_F(glTFDuck, RaygenHeapAllocations)(benchmark::State& state)
+{
+  raygen_heap_allocations_test(state);
+}
+
+/// Same traversal with the kernels of each instruction set
+BENCHMARK_DEFINE_F(glTFDuck, PrimaryRayTraverseIsa)(benchmark::State& state)
+{
+  auto previous_isa = Raytracer::Kernels::get().isa;
+  if (!Raytracer::Kernels::select(static_cast<Isa>(state.range(0)))) {
+    state.SkipWithError("instruction set not supported by this cpu");
+    return;
+  }
+  state.SetLabel(Raytracer::Kernels::get().name);
+  raygen_test(state);
+  Raytracer::Kernels::select(previous_isa);
+}
+
+BENCHMARK_REGISTER_F(glTFDuck, PrimaryRayTraverseIsa)
+  ->DenseRange(static_cast<int>(Isa::Scalar), static_cast<int>(Isa::Avx512));
+
+/// Whole frames rendered by state.range(0) threads, unpinned for
+/// state.range(1) == 0, pinned for 1, with node local frame buffers for 2 and
+/// with a copy of the scene on each node for 3. Without a multi-socket
+/// machine, set RAYTRACER_NUMA_NODES to emulate the nodes
+BENCHMARK_DEFINE_F(glTFDuck, NumaFrame)(benchmark::State& state)
+{
+  constexpr uint16_t width = 640;
+  constexpr uint16_t height = 480;
+  auto placement = state.range(1);
+  const char* labels[] = { "unpinned", "pinned", "node local buffers",
+                           "scene replicas" };
+  state.SetLabel(labels[placement]);
+  renderer->set_thread_count(static_cast<uint32_t>(state.range(0)));
+  renderer->set_pinned_threads(placement >= 1);
+  renderer->set_node_local_buffers(placement >= 2);
+  renderer->set_scene_replicas(placement >= 3);
+  renderer->set_progressive(false);
+  renderer->set_backbuffer_size(width, height);
+  scene->run(width, height);
+
+  for (auto _ : state) {
+    renderer->run(*scene);
+  }
+  float numa_nodes = 1.0f;
+  for (auto& [format, value] : renderer->evaluate_metrics()) {
+    if (format.find("numa nodes") != std::string::npos) {
+      numa_nodes = value;
+    }
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+  state.counters["numa_nodes"] = numa_nodes;
+}
+
+BENCHMARK_REGISTER_F(glTFDuck, NumaFrame)
+  ->Apply([](benchmark::internal::Benchmark* benchmark) {
+    for (int64_t threads = 1; threads <= 64; threads *= 2) {
+      for (int64_t placement = 0; placement < 4; ++placement) {
+        benchmark->Args({ threads, placement });
+      }
+    }
+  })
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+
 class glTFDamagedHelmet : public BaseSceneFixture
 {
 protected:
@@ -166,3 +498,31 @@ BENCHMARK_F(glTFSponza, PrimaryRayTraverse)(benchmark::State& state)
 {
   raygen_test(state);
 }
+
+/// Frames of the path tracer adding up to one image of the cornell box, traced
+/// by state.range(0) threads
+static void
+path_accumulation(benchmark::State& state)
+{
+  constexpr uint16_t width = 320;
+  constexpr uint16_t height = 240;
+  auto scene = Scene::load_cornell_box();
+  RendererPath renderer(nullptr);
+  renderer.set_thread_count(static_cast<uint32_t>(state.range(0)));
+  renderer.set_backbuffer_size(width, height);
+  scene->run(width, height);
+
+  for (auto _ : state) {
+    renderer.run(*scene);
+    scene->run(width, height);
+  }
+  state.counters["samples_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()) * width * height,
+    benchmark::Counter::kIsRate);
+}
+
+BENCHMARK(path_accumulation)
+  ->RangeMultiplier(2)
+  ->Range(1, 16)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
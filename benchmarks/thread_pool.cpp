@@ -0,0 +1,48 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "../src/private_impl/threading/thread_pool.h"
+
+using Raytracer::Threading::ThreadPool;
+
+// Per frame overhead of running an empty task on every thread, the way
+// RendererWhitted::run used to do it: one new thread per core and frame
+static void
+thread_spawn_join_frame(benchmark::State& state)
+{
+  auto thread_count = static_cast<uint32_t>(state.range(0));
+  std::atomic<uint32_t> work_done(0);
+  for (auto _ : state) {
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < thread_count; ++i) {
+      threads.emplace_back(
+        [&work_done]() { work_done.fetch_add(1, std::memory_order_relaxed); });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(thread_spawn_join_frame)->RangeMultiplier(2)->Range(1, 16);
+
+// Same as above with the threads kept alive between frames
+static void
+thread_pool_frame(benchmark::State& state)
+{
+  ThreadPool pool(static_cast<uint32_t>(state.range(0)));
+  std::atomic<uint32_t> work_done(0);
+  ThreadPool::Task task = [&work_done](uint32_t) {
+    work_done.fetch_add(1, std::memory_order_relaxed);
+  };
+  for (auto _ : state) {
+    pool.run(task);
+  }
+  state.counters["frames_per_second"] = ::benchmark::Counter(
+    static_cast<double>(state.iterations()), benchmark::Counter::kIsRate);
+}
+BENCHMARK(thread_pool_frame)->RangeMultiplier(2)->Range(1, 16);
@@ -6,6 +6,9 @@
 #endif
 
 namespace Raytracer {
+namespace Math {
+struct mat3x4;
+} // namespace Math
 #if !__EMSCRIPTEN__
 using Raytracer::Math::bool_simd_t;
 using Raytracer::Math::float_simd_t;
@@ -25,6 +28,8 @@ struct Aabb
   vec3 min, max;
 
   static bool hit(const Aabb& box, const Ray& r, float t_min, float t_max);
+  /// Bounds of the box after an affine transform
+  static Aabb transform(const Aabb& box, const Math::mat3x4& matrix);
 #if !__EMSCRIPTEN__
   template<uint8_t D>
   static bool_simd_t<D> hit(const Aabb& box,
@@ -51,8 +56,14 @@ struct AabbSimd
 
 static_assert(sizeof(AabbSimd<4>) == 0x60,
               "quad axis-aligned bounding box is not minimal size");
+#if __AVX2__
 static_assert(sizeof(AabbSimd<8>) == 0xC0,
               "oct axis-aligned bounding box is not minimal size");
 #endif
+#if __AVX512F__
+static_assert(sizeof(AabbSimd<16>) == 0x180,
+              "hex axis-aligned bounding box is not minimal size");
+#endif
+#endif
 
 } // namespace Raytracer
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "aabb.h"
+
+#include <cfloat>
+#include <cmath>
+
+#include "ray.h"
+
+/// Definitions of the simd hit tests declared in aabb.h. They live in a header
+/// so every translation unit instantiates them for the instruction set it is
+/// compiled for.
+#if !__EMSCRIPTEN__
+namespace Raytracer {
+template<uint8_t D>
+bool_simd_t<D>
+Aabb::hit(const Aabb& box,
+          const RaySimd<D>& r,
+          float_simd_t<D> t_min,
+          float_simd_t<D> t_max)
+{
+  float_simd_t<D> reciprocal[3] = {
+    r.direction.e[0].reciprocal(),
+    r.direction.e[1].reciprocal(),
+    r.direction.e[2].reciprocal(),
+  };
+  bool_simd_t<D> swap_mask[3] = {
+    reciprocal[0] < float_simd_t<D>(0.f),
+    reciprocal[1] < float_simd_t<D>(0.f),
+    reciprocal[2] < float_simd_t<D>(0.f),
+  };
+
+  float_simd_t<D> ray_origin_axis_scaled[3] = {
+    r.origin.e[0] * reciprocal[0],
+    r.origin.e[1] * reciprocal[1],
+    r.origin.e[2] * reciprocal[2],
+  };
+
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    // FIXME: ignoring divide by zero since simd can continue on...
+    //        behaviour is uncertain so keep an eye out
+    // if (std::abs(r.direction.e[axis]) <
+    // std::numeric_limits<float>::epsilon()) {
+    //   continue;
+    // }
+    auto box_min = float_simd_t<D>(box.min.e[axis]);
+    auto box_max = float_simd_t<D>(box.max.e[axis]);
+
+    auto t0 =
+      box_min.multiply_sub(reciprocal[axis], ray_origin_axis_scaled[axis]);
+    auto t1 =
+      box_max.multiply_sub(reciprocal[axis], ray_origin_axis_scaled[axis]);
+
+    // If the ray enters from back to front (t0 is bigger than t1)
+    std::swap(t0, t1, swap_mask[axis]);
+
+    t_min = std::max(t0, t_min);
+    t_max = std::min(t1, t_max);
+  }
+  return t_max > t_min;
+}
+
+template<uint8_t D>
+bool_simd_t<D>
+AabbSimd<D>::hit(const AabbSimd& box,
+                 const Ray& r,
+                 float_simd_t<D> t_min,
+                 float_simd_t<D> t_max)
+{
+  bool_simd_t<D> result(true);
+  for (uint8_t axis = 0; axis < 3; axis++) {
+    // Neither std::abs nor numeric_limits, their copies built for the
+    // instruction set of the kernels could be linked in the rest of the library
+    float direction = r.direction.e[axis];
+    if ((direction < 0.f ? -direction : direction) < FLT_EPSILON) {
+      continue;
+    }
+
+    float reciprocal = 1.f / r.direction.e[axis];
+    float_simd_t<D> ray_origin_axis_scaled(r.origin.e[axis] * reciprocal);
+    float_simd_t<D> reciprocal_simd4(reciprocal);
+
+    float_simd_t<D> t0 =
+      box.min.e[axis].multiply_sub(reciprocal_simd4, ray_origin_axis_scaled);
+    float_simd_t<D> t1 =
+      box.max.e[axis].multiply_sub(reciprocal_simd4, ray_origin_axis_scaled);
+
+    // If the ray enters from back to front (t0 is bigger than t1)
+    if (reciprocal < 0.f) {
+      std::swap(t0, t1);
+    }
+
+    t_min = std::max(t0, t_min);
+    t_max = std::min(t1, t_max);
+
+    result = result && (t_max > t_min);
+    if (!result.any()) {
+      return result;
+    }
+  }
+  return result;
+}
+} // namespace Raytracer
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+/// Work counted by the cpu renderer for its statistics. Every thread only
+/// increments its own counters, which the renderer collects and resets once per
+/// frame, so counting does not need atomics or locks.
+namespace Raytracer::Counters {
+struct Frame
+{
+  uint64_t primary_rays;
+  /// Primary rays not traced since what they hit was known from a past frame
+  uint64_t reused_primary_hits;
+  uint64_t secondary_rays;
+  uint64_t shadow_rays;
+  /// Shadow rays blocked by the occluder of the last one towards their light
+  uint64_t shadow_cache_hits;
+  uint64_t light_nodes;
+  uint64_t bvh_nodes;
+  uint64_t aabb_tests;
+  uint64_t triangle_tests;
+  uint64_t sdf_steps;
+  uint64_t shading_calls;
+
+  Frame& operator+=(const Frame& other)
+  {
+    primary_rays += other.primary_rays;
+    reused_primary_hits += other.reused_primary_hits;
+    secondary_rays += other.secondary_rays;
+    shadow_rays += other.shadow_rays;
+    shadow_cache_hits += other.shadow_cache_hits;
+    light_nodes += other.light_nodes;
+    bvh_nodes += other.bvh_nodes;
+    aabb_tests += other.aabb_tests;
+    triangle_tests += other.triangle_tests;
+    sdf_steps += other.sdf_steps;
+    shading_calls += other.shading_calls;
+    return *this;
+  }
+};
+
+/// Counters of the calling thread
+inline Frame&
+local()
+{
+  static thread_local Frame counters = {};
+  return counters;
+}
+
+/// Counters of the calling thread since the last call, which are reset
+inline Frame
+take()
+{
+  auto result = local();
+  local() = {};
+  return result;
+}
+} // namespace Raytracer::Counters
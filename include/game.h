@@ -10,6 +10,7 @@ namespace Raytracer {
 class Window;
 class Input;
 class Scene;
+class SceneLoader;
 class Ui;
 
 namespace Graphics {
@@ -36,7 +37,9 @@ private:
   std::unique_ptr<Input> input;
   std::unique_ptr<Renderer> renderer;
   std::unique_ptr<Ui> ui;
+  /// Null until the first scene is loaded
   std::unique_ptr<Scene> scene;
+  std::unique_ptr<SceneLoader> scene_loader;
   std::chrono::high_resolution_clock::time_point frame_begin;
   std::chrono::high_resolution_clock::time_point frame_end;
   std::vector<std::pair<std::string, float> > renderer_metrics;
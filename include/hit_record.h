@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 
 #include "math/vec2.h"
 #include "math/vec3.h"
@@ -16,5 +17,8 @@ struct hit_record
   vec3 uv;
   uint16_t mat_id;
   uint32_t bvh_hits = 0;
+  /// Triangle hit in a mesh, whole_object for other objects
+  static constexpr uint32_t whole_object = std::numeric_limits<uint32_t>::max();
+  uint32_t primitive = whole_object;
 };
 } // namespace Raytracer
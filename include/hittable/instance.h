@@ -3,10 +3,15 @@
 #include "object.h"
 
 #include <cstdint>
+#include <limits>
 
+#include "aabb.h"
+#include "math/mat3x4.h"
 #include "math/vec3.h"
 
 namespace Raytracer::Hittable {
+using Raytracer::Aabb;
+using Raytracer::Math::mat3x4;
 using Raytracer::Math::vec3;
 
 class Translate : public Object
@@ -44,4 +49,37 @@ private:
   float sin_theta;
   float cos_theta;
 };
+
+/// Places shared geometry in the world with an affine transform. The
+/// geometry and its acceleration structure (the bottom level of the
+/// hierarchy) are built once in object space and referenced by every
+/// instance. The referenced object must not assume unit ray directions since
+/// scale carries over to the object space ray.
+struct Instance : Object
+{
+  Instance(std::shared_ptr<const Object> blas,
+           const Aabb& blas_bounds,
+           const mat3x4& object_to_world,
+           uint16_t m = std::numeric_limits<uint16_t>::max());
+  bool hit(const Ray& r,
+           bool early_out,
+           float t_min,
+           float t_max,
+           hit_record& rec) const override;
+  bool hit_primitive(const Ray& r,
+                     uint32_t primitive,
+                     float t_min,
+                     float t_max) const override;
+  uint16_t get_mat_id() const override;
+  std::unique_ptr<Object> copy() const override;
+  bool bounding_box(Aabb& box);
+
+  std::shared_ptr<const Object> blas;
+  Aabb blas_bounds;
+  mat3x4 object_to_world;
+  mat3x4 world_to_object;
+  /// Material override, max to use the material of the shared geometry
+  uint16_t mat_id;
+  Aabb aabb;
+};
 } // namespace Raytracer::Hittable
@@ -18,6 +18,13 @@ struct Object
                    float t_min,
                    float t_max,
                    hit_record& rec) const = 0;
+  /// Whether the ray hits the primitive named by an earlier hit_record of the
+  /// object, cheaper than hit for shadow rays likely blocked by it again.
+  /// Objects not made of primitives test all of themselves
+  virtual bool hit_primitive(const Ray& r,
+                             uint32_t primitive,
+                             float t_min,
+                             float t_max) const;
   virtual uint16_t get_mat_id() const = 0;
   virtual std::unique_ptr<Object> copy() const = 0;
 };
@@ -34,6 +34,10 @@ struct TriangleMesh : Object
            float t_min,
            float t_max,
            hit_record& rec) const override;
+  bool hit_primitive(const Ray& r,
+                     uint32_t primitive,
+                     float t_min,
+                     float t_max) const override;
   bool ray_triangles_intersect(const Ray& r,
                                const uint16_t* indices,
                                uint32_t index_count,
@@ -11,7 +11,8 @@ class Input
 public:
   Input();
   virtual ~Input();
-  void run(Ui& ui, Scene& scene, std::chrono::microseconds& dt);
+  /// The camera of scene, if any, moves with the events
+  void run(Ui& ui, Scene* scene, std::chrono::microseconds& dt);
   bool should_quit() const;
 
 private:
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Raytracer {
+class Camera;
+struct BvhNode;
+struct Ray;
+namespace Math {
+class vec3;
+}
+} // namespace Raytracer
+
+/// Intersection kernels compiled for several instruction sets. The library
+/// itself only assumes SSE4.2, the table for the best instruction set the cpu
+/// supports is picked at runtime.
+namespace Raytracer::Kernels {
+using Raytracer::Math::vec3;
+
+enum class Isa : uint8_t
+{
+  Scalar,
+  Sse42,
+  Avx2,
+  Avx512,
+};
+
+/// Closest of a list of triangles hit by a ray
+struct TriangleHit
+{
+  /// Position of the triangle in the index list
+  uint32_t triangle;
+  float t;
+  /// Barycentric coordinates of the second and third vertices
+  float u;
+  float v;
+};
+
+struct Table
+{
+  Isa isa;
+  const char* name;
+  /// Floats per vector register
+  uint8_t width;
+
+  /// Möller–Trumbore intersection against triangle_count triangles of three
+  /// indices each. Finds the closest hit in (epsilon, t_max) or the first one
+  /// found if early_out is set.
+  bool (*ray_triangles)(const Ray& r,
+                        const vec3* positions,
+                        const uint16_t* indices,
+                        uint32_t triangle_count,
+                        bool early_out,
+                        float t_max,
+                        TriangleHit& hit);
+  /// Test a ray against the bounds of up to 32 consecutive bvh nodes, bit i of
+  /// the result is set if node i is hit
+  uint32_t (*ray_nodes)(const Ray& r,
+                        const BvhNode* nodes,
+                        uint32_t node_count,
+                        float t_min,
+                        float t_max);
+  /// Camera rays through count consecutive pixels of row y of a frame,
+  /// starting at column x. jitter holds a sub-pixel offset in [0, 1) per
+  /// pixel and axis, interleaved x then y, or is null to go through the
+  /// pixels' corners.
+  void (*camera_rays)(const Camera& camera,
+                      uint16_t frame_width,
+                      uint16_t frame_height,
+                      uint16_t x,
+                      uint16_t y,
+                      uint32_t count,
+                      const float* jitter,
+                      Ray* rays);
+};
+
+/// Whether both the cpu and the operating system support an instruction set
+bool is_supported(Isa isa);
+/// Kernels in use. Unless select has been called, these are the best ones
+/// supported by the cpu or the ones named by the RAYTRACER_ISA environment
+/// variable: "scalar", "sse42", "avx2" or "avx512".
+const Table& get();
+/// Switch to the kernels of another instruction set, returns false if it is not
+/// supported
+bool select(Isa isa);
+} // namespace Raytracer::Kernels
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "aabb.h"
+#include "counters.h"
+#include "math/vec3.h"
+
+namespace Raytracer {
+class Scene;
+
+/// Hierarchy over the point lights of a scene. Each node bounds the positions
+/// of its lights and how bright they can be at a distance, so lights too far
+/// or too dim to matter at a point are skipped a whole subtree at a time and
+/// the cost of direct lighting grows with the log of the light count.
+class LightTree
+{
+public:
+  /// Rebuild over the point lights of the scene with their current materials
+  void build(const Scene& scene);
+
+  /// Call visit with the index in Scene::get_lights() of every light whose
+  /// emission at position, times weight, may reach threshold
+  template<typename Visitor>
+  void visit_lights(const vec3& position,
+                    float weight,
+                    float threshold,
+                    Visitor&& visit) const;
+
+private:
+  struct Node
+  {
+    Aabb bounds;
+    /// Largest emission of the lights under the node by falloff
+    float constant;
+    float linear;
+    float quadratic;
+    /// If a leaf, this is the offset into light_indices
+    /// If an internal node, this is the offset of the left child, the right
+    /// one follows it
+    uint32_t offset;
+    /// Lights of a leaf, 0 for internal nodes
+    uint32_t light_count;
+  };
+  /// Children are split at the median light on the longest axis, so the tree
+  /// is balanced and its depth stays below this
+  static constexpr uint32_t max_depth = 64;
+  static constexpr uint32_t max_leaf_size = 2;
+
+  void build_node(uint32_t node_index, uint32_t first, uint32_t count);
+
+  std::vector<Node> nodes;
+  std::vector<uint32_t> light_indices;
+  /// Leaf of each light alone, indexed like Scene::get_lights()
+  std::vector<Node> light_leaves;
+};
+
+template<typename Visitor>
+void
+LightTree::visit_lights(const vec3& position,
+                        float weight,
+                        float threshold,
+                        Visitor&& visit) const
+{
+  if (nodes.empty()) {
+    return;
+  }
+  auto& counters = Counters::local();
+  uint32_t nodes_to_visit[max_depth];
+  uint32_t next = 0;
+  nodes_to_visit[next++] = 0;
+  while (next > 0) {
+    auto& node = nodes[nodes_to_visit[--next]];
+    counters.light_nodes++;
+    // Closest distance to the bounds of the lights, inside them nothing can
+    // be ruled out
+    float distance_squared = 0.0f;
+    for (uint8_t i = 0; i < 3; ++i) {
+      auto outside = std::max({ node.bounds.min.e[i] - position.e[i],
+                                position.e[i] - node.bounds.max.e[i],
+                                0.0f });
+      distance_squared += outside * outside;
+    }
+    if (distance_squared > 0.0f) {
+      auto brightest = node.constant +
+                       node.linear / std::sqrt(distance_squared) +
+                       node.quadratic / distance_squared;
+      if (brightest * weight < threshold) {
+        continue;
+      }
+    }
+    if (node.light_count > 0) {
+      for (uint32_t i = 0; i < node.light_count; ++i) {
+        visit(light_indices[node.offset + i]);
+      }
+    } else {
+      nodes_to_visit[next++] = node.offset + 1;
+      nodes_to_visit[next++] = node.offset;
+    }
+  }
+}
+} // namespace Raytracer
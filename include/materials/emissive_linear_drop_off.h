@@ -11,6 +11,7 @@ struct EmissiveLinearDropOff : public Material
   void fill_type_data(const Scene& scene,
                       RayPayload& payload,
                       const vec3& texture_coordinates) const override;
+  EmissionFalloff get_emission_falloff() const override;
 
   vec3 albedo;
   float drop_off_factor;
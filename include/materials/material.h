@@ -1,5 +1,7 @@
 #pragma once
 
+#include <limits>
+
 namespace Raytracer {
 struct RayPayload;
 class Scene;
@@ -14,9 +16,23 @@ using Raytracer::Scene;
 using Raytracer::Math::vec3;
 struct Material
 {
+  /// Emission of the brightest channel at a distance d is at most
+  /// constant + linear / d + quadratic / (d * d)
+  struct EmissionFalloff
+  {
+    float constant;
+    float linear;
+    float quadratic;
+  };
+
   virtual ~Material() = default;
   virtual void fill_type_data(const Scene& scene,
                               RayPayload& payload,
                               const vec3& texture_coordinates) const = 0;
+  /// Materials which do not only emit are never bounded
+  virtual EmissionFalloff get_emission_falloff() const
+  {
+    return { std::numeric_limits<float>::infinity(), 0.0f, 0.0f };
+  }
 };
 } // namespace Raytracer::Materials
@@ -6,7 +6,10 @@
 
 #include <immintrin.h>
 
+#include "simd_isa.h"
+
 namespace Raytracer::Math {
+inline namespace RAYTRACER_SIMD_ISA {
 
 namespace _details_bool_simd_t {
 template<uint8_t D>
@@ -16,13 +19,27 @@ template<>
 struct raw_type<4>
 {
   typedef __m128 type;
+  static constexpr bool is_mask = false;
 };
 
+#if __AVX2__
 template<>
 struct raw_type<8>
 {
   typedef __m256 type;
+  static constexpr bool is_mask = false;
+};
+#endif
+
+#if __AVX512F__
+template<>
+struct raw_type<16>
+{
+  typedef __mmask16 type;
+  /// One bit per lane instead of one vector element
+  static constexpr bool is_mask = true;
 };
+#endif
 } // namespace _details_bool_simd_t
 
 template<uint8_t D>
@@ -39,12 +56,16 @@ struct bool_simd_t
   inline constexpr static bool get_scalar(const bool_simd_t& vector)
   {
     static_assert(index < D, "scalar index out of bounds");
-    union scalar_getter_t
-    {
-      bool scalar[D];
-      raw_type_t vector;
-    };
-    return ((scalar_getter_t*)(&vector._raw))->scalar[index];
+    if constexpr (_details_bool_simd_t::raw_type<D>::is_mask) {
+      return (vector._raw >> index) & 1u;
+    } else {
+      union scalar_getter_t
+      {
+        bool scalar[D];
+        raw_type_t vector;
+      };
+      return ((scalar_getter_t*)(&vector._raw))->scalar[index];
+    }
   }
   inline constexpr static std::array<bool, D> get_scalars(
     const bool_simd_t& vector);
@@ -54,6 +75,8 @@ struct bool_simd_t
   inline bool_simd_t and_not(bool_simd_t rhs) const;
   inline bool any() const;
   inline bool all() const;
+  /// One bit per lane, lane 0 in the least significant bit
+  inline uint32_t bitmask() const;
 
   raw_type_t _raw;
 };
@@ -62,27 +85,25 @@ struct bool_simd_t
 
 template<>
 inline bool_simd_t<4>::bool_simd_t(bool value)
-  : _raw(_mm_cmp_ps(_mm_set1_ps(value), _mm_set1_ps(0.0f), _CMP_NEQ_UQ))
+  : _raw(_mm_cmpneq_ps(_mm_set1_ps(value), _mm_set1_ps(0.0f)))
 {}
 
 template<>
 inline bool_simd_t<4>::bool_simd_t(
   typename _details_bool_simd_t::raw_type<4>::type value)
-  : _raw(_mm_cmp_ps(value, _mm_set1_ps(0.0f), _CMP_NEQ_UQ))
+  : _raw(_mm_cmpneq_ps(value, _mm_set1_ps(0.0f)))
 {}
 
 template<>
 inline bool_simd_t<4>::bool_simd_t(const bool (&values)[4])
-  : _raw(_mm_cmp_ps(_mm_set_ps(values[3], values[2], values[1], values[0]),
-                    _mm_set1_ps(0.0f),
-                    _CMP_NEQ_UQ))
+  : _raw(_mm_cmpneq_ps(_mm_set_ps(values[3], values[2], values[1], values[0]),
+                       _mm_set1_ps(0.0f)))
 {}
 
 template<>
 inline bool_simd_t<4>::bool_simd_t(const bool values[])
-  : _raw(_mm_cmp_ps(_mm_set_ps(values[3], values[2], values[1], values[0]),
-                    _mm_set1_ps(0.0f),
-                    _CMP_NEQ_UQ))
+  : _raw(_mm_cmpneq_ps(_mm_set_ps(values[3], values[2], values[1], values[0]),
+                       _mm_set1_ps(0.0f)))
 {}
 
 template<>
@@ -120,6 +141,13 @@ bool_simd_t<4>::all() const
   return _mm_movemask_ps(_raw) == 0xF;
 }
 
+template<>
+inline uint32_t
+bool_simd_t<4>::bitmask() const
+{
+  return static_cast<uint32_t>(_mm_movemask_ps(_raw));
+}
+
 template<>
 constexpr std::array<bool, 4>
 bool_simd_t<4>::get_scalars(const bool_simd_t<4>& vector)
@@ -133,6 +161,7 @@ bool_simd_t<4>::get_scalars(const bool_simd_t<4>& vector)
 }
 
 // Oct bool
+#if __AVX2__
 
 template<>
 inline bool_simd_t<8>::bool_simd_t(bool value)
@@ -209,6 +238,13 @@ bool_simd_t<8>::all() const
   return _mm256_movemask_ps(_raw) == 0xFF;
 }
 
+template<>
+inline uint32_t
+bool_simd_t<8>::bitmask() const
+{
+  return static_cast<uint32_t>(_mm256_movemask_ps(_raw));
+}
+
 template<>
 constexpr std::array<bool, 8>
 bool_simd_t<8>::get_scalars(const bool_simd_t<8>& vector)
@@ -219,5 +255,92 @@ bool_simd_t<8>::get_scalars(const bool_simd_t<8>& vector)
     get_scalar<6>(vector), get_scalar<7>(vector),
   };
 }
+#endif
+
+// Hex bool, one bit per lane in a mask register
+#if __AVX512F__
+
+template<>
+inline bool_simd_t<16>::bool_simd_t(bool value)
+  : _raw(static_cast<__mmask16>(value ? 0xFFFF : 0x0000))
+{}
+
+template<>
+inline bool_simd_t<16>::bool_simd_t(
+  typename _details_bool_simd_t::raw_type<16>::type value)
+  : _raw(value)
+{}
+
+template<>
+inline bool_simd_t<16>::bool_simd_t(const bool values[])
+  : _raw(0)
+{
+  for (uint8_t i = 0; i < 16; ++i) {
+    _raw = static_cast<__mmask16>(_raw | (values[i] ? 1u << i : 0u));
+  }
+}
+
+template<>
+inline bool_simd_t<16>::bool_simd_t(const bool (&values)[16])
+  : bool_simd_t(&values[0])
+{}
+
+template<>
+inline bool_simd_t<16>
+bool_simd_t<16>::operator&&(bool_simd_t rhs) const
+{
+  return bool_simd_t{ static_cast<__mmask16>(_raw & rhs._raw) };
+}
+
+template<>
+inline bool_simd_t<16>
+bool_simd_t<16>::operator||(bool_simd_t rhs) const
+{
+  return bool_simd_t{ static_cast<__mmask16>(_raw | rhs._raw) };
+}
+
+template<>
+inline bool_simd_t<16>
+bool_simd_t<16>::and_not(bool_simd_t rhs) const
+{
+  return bool_simd_t{ static_cast<__mmask16>(~_raw & rhs._raw) };
+}
+
+template<>
+inline bool
+bool_simd_t<16>::any() const
+{
+  return _raw != 0;
+}
+
+template<>
+inline bool
+bool_simd_t<16>::all() const
+{
+  return _raw == 0xFFFF;
+}
+
+template<>
+inline uint32_t
+bool_simd_t<16>::bitmask() const
+{
+  return _raw;
+}
+
+template<>
+constexpr std::array<bool, 16>
+bool_simd_t<16>::get_scalars(const bool_simd_t<16>& vector)
+{
+  return {
+    get_scalar<0>(vector),  get_scalar<1>(vector),  get_scalar<2>(vector),
+    get_scalar<3>(vector),  get_scalar<4>(vector),  get_scalar<5>(vector),
+    get_scalar<6>(vector),  get_scalar<7>(vector),  get_scalar<8>(vector),
+    get_scalar<9>(vector),  get_scalar<10>(vector), get_scalar<11>(vector),
+    get_scalar<12>(vector), get_scalar<13>(vector), get_scalar<14>(vector),
+    get_scalar<15>(vector),
+  };
+}
+#endif
 
+} // namespace RAYTRACER_SIMD_ISA
 } // namespace Raytracer::Math
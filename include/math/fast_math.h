@@ -0,0 +1,291 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if !__EMSCRIPTEN__
+#include "float_simd.h"
+#endif
+
+/// Approximations of transcendental functions for hot paths such as uv
+/// mapping and signed distance functions. Every function is written once for
+/// float, float_simd_t<4> and float_simd_t<8>. Inputs are expected to be
+/// finite, error bounds are for the float version and the simd versions
+/// agree with it to within a couple of ulps.
+namespace Raytracer::Math {
+
+enum class Accuracy : uint8_t
+{
+  /// Standard library
+  Exact,
+  /// Polynomial approximations from Raytracer::Math::fast
+  Fast,
+};
+
+/// Accuracy of the transcendental functions used by hittables
+inline std::atomic<Accuracy> transcendental_accuracy{ Accuracy::Fast };
+
+namespace fast {
+namespace _details_fast_math {
+constexpr float pi = 3.14159265358979f;
+constexpr float pi_2 = 1.57079632679490f;
+constexpr float inv_pi = 0.318309886183791f;
+/// pi split in three for Cody-Waite range reduction, the first two have few
+/// enough bits for their product with small integers to be exact
+constexpr float pi_a = 3.140625f;
+constexpr float pi_b = 9.67502593994140625e-4f;
+constexpr float pi_c = 1.509957990978376432e-7f;
+constexpr float ln2 = 0.693147180559945f;
+constexpr float ln2_a = 0.693359375f;
+constexpr float ln2_b = -2.12194440e-4f;
+constexpr float log2e = 1.44269504088896f;
+constexpr float sqrt2 = 1.41421356237310f;
+
+inline float
+select(bool mask, float if_true, float if_false)
+{
+  return mask ? if_true : if_false;
+}
+
+/// Adding and removing 1.5 * 2^23 leaves no room for the fraction bits, valid
+/// for |value| < 2^22
+inline float
+round(float value)
+{
+  constexpr float shift = 12582912.0f;
+  return (value + shift) - shift;
+}
+
+inline float
+frexp(float value, float& exponent)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  exponent = static_cast<float>(static_cast<int32_t>(bits >> 23) - 127);
+  bits = (bits & 0x007FFFFFU) | 0x3F800000U;
+  float mantissa;
+  std::memcpy(&mantissa, &bits, sizeof(mantissa));
+  return mantissa;
+}
+
+inline float
+ldexp(float value, float exponent)
+{
+  uint32_t bits = static_cast<uint32_t>(static_cast<int32_t>(exponent) + 127)
+                  << 23;
+  float scale;
+  std::memcpy(&scale, &bits, sizeof(scale));
+  return value * scale;
+}
+
+#if !__EMSCRIPTEN__
+template<uint8_t D>
+inline float_simd_t<D>
+select(bool_simd_t<D> mask,
+       float_simd_t<D> if_true,
+       float_simd_t<D> if_false)
+{
+  return float_simd_t<D>::select(mask, if_true, if_false);
+}
+
+template<uint8_t D>
+inline float_simd_t<D>
+round(float_simd_t<D> value)
+{
+  return value.round();
+}
+
+template<uint8_t D>
+inline float_simd_t<D>
+frexp(float_simd_t<D> value, float_simd_t<D>& exponent)
+{
+  return value.frexp(exponent);
+}
+
+template<uint8_t D>
+inline float_simd_t<D>
+ldexp(float_simd_t<D> value, float_simd_t<D> exponent)
+{
+  return value.ldexp(exponent);
+}
+#endif
+
+/// -1^k * value for an integral k
+template<typename T>
+inline T
+negate_if_odd(T k, T value)
+{
+  T half = k * T(0.5f);
+  return select(half != round(half), T(0.0f) - value, value);
+}
+
+/// sin on [-pi/2, pi/2], Taylor series up to x^9, absolute error < 4e-6
+template<typename T>
+inline T
+sin_reduced(T x)
+{
+  T x2 = x * x;
+  T p = T(2.7557319e-6f);
+  p = p * x2 + T(-1.9841270e-4f);
+  p = p * x2 + T(8.3333333e-3f);
+  p = p * x2 + T(-1.6666667e-1f);
+  return x + x * x2 * p;
+}
+
+/// atan on [0, 1], Abramowitz and Stegun 4.4.49, absolute error < 1e-5
+template<typename T>
+inline T
+atan_reduced(T x)
+{
+  T x2 = x * x;
+  T p = T(0.0208351f);
+  p = p * x2 + T(-0.0851330f);
+  p = p * x2 + T(0.1801410f);
+  p = p * x2 + T(-0.3302995f);
+  p = p * x2 + T(0.9998660f);
+  return p * x;
+}
+
+/// acos on [0, 1], Abramowitz and Stegun 4.4.45, absolute error < 7e-5
+template<typename T>
+inline T
+acos_reduced(T x)
+{
+  using std::sqrt;
+  T p = T(-0.0187293f);
+  p = p * x + T(0.0742610f);
+  p = p * x + T(-0.2121144f);
+  p = p * x + T(1.5707288f);
+  return sqrt(T(1.0f) - x) * p;
+}
+} // namespace _details_fast_math
+
+/// Absolute error < 1.2e-5 rad, atan2(0, 0) is 0
+template<typename T>
+inline T
+atan2(T y, T x)
+{
+  using namespace _details_fast_math;
+  using std::abs;
+  using std::max;
+  using std::min;
+  T abs_x = abs(x);
+  T abs_y = abs(y);
+  T numerator = min(abs_x, abs_y);
+  T denominator = max(abs_x, abs_y);
+  T ratio =
+    select(denominator > T(0.0f), numerator / denominator, T(0.0f));
+  T result = atan_reduced(ratio);
+  result = select(abs_y > abs_x, T(pi_2) - result, result);
+  result = select(x < T(0.0f), T(pi) - result, result);
+  return select(y < T(0.0f), T(0.0f) - result, result);
+}
+
+/// Absolute error < 7e-5 rad on [-1, 1]
+template<typename T>
+inline T
+acos(T x)
+{
+  using namespace _details_fast_math;
+  using std::abs;
+  T result = acos_reduced(abs(x));
+  return select(x < T(0.0f), T(pi) - result, result);
+}
+
+/// Absolute error < 7e-5 rad on [-1, 1]
+template<typename T>
+inline T
+asin(T x)
+{
+  using namespace _details_fast_math;
+  using std::abs;
+  T result = T(pi_2) - acos_reduced(abs(x));
+  return select(x < T(0.0f), T(0.0f) - result, result);
+}
+
+/// Absolute error < 4e-6 for |x| < 1e4, the error grows past that with the
+/// rounding of x
+template<typename T>
+inline T
+sin(T x)
+{
+  using namespace _details_fast_math;
+  // x = k * pi + r with r in [-pi/2, pi/2], sin(x) = -1^k * sin(r)
+  T k = round(x * T(inv_pi));
+  T r = ((x - k * T(pi_a)) - k * T(pi_b)) - k * T(pi_c);
+  return negate_if_odd(k, sin_reduced(r));
+}
+
+/// Absolute error < 4e-6 for |x| < 1e4, the error grows past that with the
+/// rounding of x
+template<typename T>
+inline T
+cos(T x)
+{
+  using namespace _details_fast_math;
+  // x = (k + 1/2) * pi + r with r in [-pi/2, pi/2], cos(x) = -1^(k+1) sin(r)
+  T k = round(x * T(inv_pi) - T(0.5f));
+  T k_half = k + T(0.5f);
+  T r = ((x - k_half * T(pi_a)) - k_half * T(pi_b)) - k_half * T(pi_c);
+  return negate_if_odd(k + T(1.0f), sin_reduced(r));
+}
+
+/// Relative error < 3e-7, x is clamped to [-87, 88] to stay in normal range
+template<typename T>
+inline T
+exp(T x)
+{
+  using namespace _details_fast_math;
+  using std::max;
+  using std::min;
+  x = max(min(x, T(88.0f)), T(-87.0f));
+  // x = n * ln2 + r with |r| <= ln2 / 2, exp(x) = 2^n * exp(r)
+  T n = round(x * T(log2e));
+  T r = (x - n * T(ln2_a)) - n * T(ln2_b);
+  // Taylor series up to r^6
+  T p = T(1.3888889e-3f);
+  p = p * r + T(8.3333333e-3f);
+  p = p * r + T(4.1666667e-2f);
+  p = p * r + T(1.6666667e-1f);
+  p = p * r + T(0.5f);
+  p = p * r + T(1.0f);
+  p = p * r + T(1.0f);
+  return ldexp(p, n);
+}
+
+/// Absolute error < 1e-7 on [0.5, 2] and relative error < 2e-7 elsewhere for
+/// positive normal numbers. Zero, negative and denormal inputs are not
+/// handled.
+template<typename T>
+inline T
+log(T x)
+{
+  using namespace _details_fast_math;
+  // x = m * 2^e with m in [sqrt(2)/2, sqrt(2)]
+  T e(0.0f);
+  T m = frexp(x, e);
+  auto is_large = m > T(sqrt2);
+  m = select(is_large, m * T(0.5f), m);
+  e = select(is_large, e + T(1.0f), e);
+  // log(m) = 2 atanh(s) with s = (m - 1) / (m + 1), |s| < 0.172
+  T s = (m - T(1.0f)) / (m + T(1.0f));
+  T s2 = s * s;
+  T p = T(2.0f / 7.0f);
+  p = p * s2 + T(2.0f / 5.0f);
+  p = p * s2 + T(2.0f / 3.0f);
+  p = p * s2 + T(2.0f);
+  return p * s + e * T(ln2);
+}
+
+/// exp(y * log(x)) for positive x, the relative error grows with
+/// |y * log(x)| as 2e-7 * |y * log(x)| + 3e-7
+template<typename T>
+inline T
+pow(T x, T y)
+{
+  return exp(y * log(x));
+}
+} // namespace fast
+} // namespace Raytracer::Math
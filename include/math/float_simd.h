@@ -7,8 +7,10 @@
 #include <immintrin.h>
 
 #include "bool_simd.h"
+#include "simd_isa.h"
 
 namespace Raytracer::Math {
+inline namespace RAYTRACER_SIMD_ISA {
 
 namespace _details_float_simd_t {
 template<uint8_t D>
@@ -20,11 +22,21 @@ struct raw_type<4>
   typedef __m128 type;
 };
 
+#if __AVX2__
 template<>
 struct raw_type<8>
 {
   typedef __m256 type;
 };
+#endif
+
+#if __AVX512F__
+template<>
+struct raw_type<16>
+{
+  typedef __m512 type;
+};
+#endif
 } // namespace _details_float_simd_t
 
 template<uint8_t D>
@@ -50,10 +62,13 @@ struct float_simd_t
   }
   inline constexpr static std::array<float, D> get_scalars(
     const float_simd_t& vector);
+  /// Write all lanes to memory
+  inline void store(float (&values)[D]) const;
 
   inline float_simd_t operator+(float_simd_t rhs) const;
   inline float_simd_t operator-(float_simd_t rhs) const;
   inline float_simd_t operator*(float_simd_t rhs) const;
+  inline float_simd_t operator/(float_simd_t rhs) const;
   inline bool_simd_t<D> operator>(float_simd_t rhs) const;
   inline bool_simd_t<D> operator<(float_simd_t rhs) const;
   inline bool_simd_t<D> operator>=(float_simd_t rhs) const;
@@ -71,6 +86,17 @@ struct float_simd_t
   inline float_simd_t reciprocal() const;
   /// sqrt(1 / this)
   inline float_simd_t reciprocal_sqrt() const;
+  /// Round to the nearest integer
+  inline float_simd_t round() const;
+  /// Split a positive normal number as mantissa * 2^exponent with the mantissa
+  /// in [1, 2) and return the mantissa
+  inline float_simd_t frexp(float_simd_t& exponent) const;
+  /// this * 2^exponent for an integral exponent in [-126, 127]
+  inline float_simd_t ldexp(float_simd_t exponent) const;
+  /// Per lane: mask ? if_true : if_false
+  inline static float_simd_t select(bool_simd_t<D> mask,
+                                    float_simd_t if_true,
+                                    float_simd_t if_false);
 
   raw_type_t _raw;
 };
@@ -117,6 +143,13 @@ inline float_simd_t<4> float_simd_t<4>::operator*(float_simd_t rhs) const
   return float_simd_t{ _mm_mul_ps(_raw, rhs._raw) };
 }
 
+template<>
+inline float_simd_t<4>
+float_simd_t<4>::operator/(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm_div_ps(_raw, rhs._raw) };
+}
+
 template<>
 inline bool_simd_t<4>
 float_simd_t<4>::operator>(float_simd_t rhs) const
@@ -164,7 +197,12 @@ inline float_simd_t<4>
 float_simd_t<4>::multiply_add(float_simd_t multiplier,
                               float_simd_t addition) const
 {
+#if defined(__FMA__) || defined(__AVX2__)
   return float_simd_t{ _mm_fmadd_ps(_raw, multiplier._raw, addition._raw) };
+#else
+  return float_simd_t{ _mm_add_ps(_mm_mul_ps(_raw, multiplier._raw),
+                                  addition._raw) };
+#endif
 }
 
 template<>
@@ -172,7 +210,12 @@ inline float_simd_t<4>
 float_simd_t<4>::multiply_sub(float_simd_t multiplier,
                               float_simd_t subtraction) const
 {
+#if defined(__FMA__) || defined(__AVX2__)
   return float_simd_t{ _mm_fmsub_ps(_raw, multiplier._raw, subtraction._raw) };
+#else
+  return float_simd_t{ _mm_sub_ps(_mm_mul_ps(_raw, multiplier._raw),
+                                  subtraction._raw) };
+#endif
 }
 
 template<>
@@ -189,6 +232,44 @@ float_simd_t<4>::reciprocal_sqrt() const
   return float_simd_t{ _mm_rsqrt_ps(_raw) };
 }
 
+template<>
+inline float_simd_t<4>
+float_simd_t<4>::round() const
+{
+  return float_simd_t{ _mm_round_ps(
+    _raw, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) };
+}
+
+template<>
+inline float_simd_t<4>
+float_simd_t<4>::frexp(float_simd_t& exponent) const
+{
+  __m128i bits = _mm_castps_si128(_raw);
+  exponent._raw = _mm_cvtepi32_ps(
+    _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127)));
+  return float_simd_t{ _mm_castsi128_ps(
+    _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)),
+                 _mm_set1_epi32(0x3F800000))) };
+}
+
+template<>
+inline float_simd_t<4>
+float_simd_t<4>::ldexp(float_simd_t exponent) const
+{
+  __m128i bits = _mm_slli_epi32(
+    _mm_add_epi32(_mm_cvtps_epi32(exponent._raw), _mm_set1_epi32(127)), 23);
+  return float_simd_t{ _mm_mul_ps(_raw, _mm_castsi128_ps(bits)) };
+}
+
+template<>
+inline float_simd_t<4>
+float_simd_t<4>::select(bool_simd_t<4> mask,
+                        float_simd_t if_true,
+                        float_simd_t if_false)
+{
+  return float_simd_t{ _mm_blendv_ps(if_false._raw, if_true._raw, mask._raw) };
+}
+
 template<>
 constexpr std::array<float, 4>
 float_simd_t<4>::get_scalars(const float_simd_t<4>& vector)
@@ -201,7 +282,15 @@ float_simd_t<4>::get_scalars(const float_simd_t<4>& vector)
   };
 }
 
+template<>
+inline void
+float_simd_t<4>::store(float (&values)[4]) const
+{
+  _mm_storeu_ps(values, _raw);
+}
+
 // Oct float
+#if __AVX2__
 
 template<>
 inline float_simd_t<8>::float_simd_t(float value)
@@ -257,6 +346,13 @@ inline float_simd_t<8> float_simd_t<8>::operator*(float_simd_t rhs) const
   return float_simd_t{ _mm256_mul_ps(_raw, rhs._raw) };
 }
 
+template<>
+inline float_simd_t<8>
+float_simd_t<8>::operator/(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm256_div_ps(_raw, rhs._raw) };
+}
+
 template<>
 inline bool_simd_t<8>
 float_simd_t<8>::operator>(float_simd_t rhs) const
@@ -330,6 +426,47 @@ float_simd_t<8>::reciprocal_sqrt() const
   return float_simd_t{ _mm256_rsqrt_ps(_raw) };
 }
 
+template<>
+inline float_simd_t<8>
+float_simd_t<8>::round() const
+{
+  return float_simd_t{ _mm256_round_ps(
+    _raw, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) };
+}
+
+template<>
+inline float_simd_t<8>
+float_simd_t<8>::frexp(float_simd_t& exponent) const
+{
+  __m256i bits = _mm256_castps_si256(_raw);
+  exponent._raw = _mm256_cvtepi32_ps(
+    _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+  return float_simd_t{ _mm256_castsi256_ps(
+    _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)),
+                    _mm256_set1_epi32(0x3F800000))) };
+}
+
+template<>
+inline float_simd_t<8>
+float_simd_t<8>::ldexp(float_simd_t exponent) const
+{
+  __m256i bits = _mm256_slli_epi32(
+    _mm256_add_epi32(_mm256_cvtps_epi32(exponent._raw),
+                     _mm256_set1_epi32(127)),
+    23);
+  return float_simd_t{ _mm256_mul_ps(_raw, _mm256_castsi256_ps(bits)) };
+}
+
+template<>
+inline float_simd_t<8>
+float_simd_t<8>::select(bool_simd_t<8> mask,
+                        float_simd_t if_true,
+                        float_simd_t if_false)
+{
+  return float_simd_t{ _mm256_blendv_ps(
+    if_false._raw, if_true._raw, mask._raw) };
+}
+
 template<>
 constexpr std::array<float, 8>
 float_simd_t<8>::get_scalars(const float_simd_t<8>& vector)
@@ -341,6 +478,201 @@ float_simd_t<8>::get_scalars(const float_simd_t<8>& vector)
   };
 }
 
+template<>
+inline void
+float_simd_t<8>::store(float (&values)[8]) const
+{
+  _mm256_storeu_ps(values, _raw);
+}
+#endif
+
+// Hex float
+#if __AVX512F__
+
+template<>
+inline float_simd_t<16>::float_simd_t(float value)
+  : _raw(_mm512_set1_ps(value))
+{}
+
+template<>
+inline float_simd_t<16>::float_simd_t(__m512 value)
+  : _raw(value)
+{}
+
+template<>
+inline float_simd_t<16>::float_simd_t(const float (&values)[16])
+  : _raw(_mm512_loadu_ps(values))
+{}
+
+template<>
+inline float_simd_t<16>::float_simd_t(const float values[])
+  : _raw(_mm512_loadu_ps(values))
+{}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::operator+(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm512_add_ps(_raw, rhs._raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::operator-(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm512_sub_ps(_raw, rhs._raw) };
+}
+
+template<>
+inline float_simd_t<16> float_simd_t<16>::operator*(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm512_mul_ps(_raw, rhs._raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::operator/(float_simd_t rhs) const
+{
+  return float_simd_t{ _mm512_div_ps(_raw, rhs._raw) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator>(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_GT_OQ) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator<(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_LT_OQ) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator>=(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_GE_OQ) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator<=(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_LE_OQ) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator==(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_EQ_OQ) };
+}
+
+template<>
+inline bool_simd_t<16>
+float_simd_t<16>::operator!=(float_simd_t rhs) const
+{
+  return bool_simd_t<16>{ _mm512_cmp_ps_mask(_raw, rhs._raw, _CMP_NEQ_OQ) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::multiply_add(float_simd_t multiplier,
+                               float_simd_t addition) const
+{
+  return float_simd_t{ _mm512_fmadd_ps(_raw, multiplier._raw, addition._raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::multiply_sub(float_simd_t multiplier,
+                               float_simd_t subtraction) const
+{
+  return float_simd_t{ _mm512_fmsub_ps(
+    _raw, multiplier._raw, subtraction._raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::reciprocal() const
+{
+  return float_simd_t{ _mm512_rcp14_ps(_raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::reciprocal_sqrt() const
+{
+  return float_simd_t{ _mm512_rsqrt14_ps(_raw) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::round() const
+{
+  return float_simd_t{ _mm512_roundscale_ps(
+    _raw, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::frexp(float_simd_t& exponent) const
+{
+  __m512i bits = _mm512_castps_si512(_raw);
+  exponent._raw = _mm512_cvtepi32_ps(
+    _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(127)));
+  return float_simd_t{ _mm512_castsi512_ps(
+    _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x007FFFFF)),
+                    _mm512_set1_epi32(0x3F800000))) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::ldexp(float_simd_t exponent) const
+{
+  __m512i bits = _mm512_slli_epi32(
+    _mm512_add_epi32(_mm512_cvtps_epi32(exponent._raw),
+                     _mm512_set1_epi32(127)),
+    23);
+  return float_simd_t{ _mm512_mul_ps(_raw, _mm512_castsi512_ps(bits)) };
+}
+
+template<>
+inline float_simd_t<16>
+float_simd_t<16>::select(bool_simd_t<16> mask,
+                         float_simd_t if_true,
+                         float_simd_t if_false)
+{
+  return float_simd_t{ _mm512_mask_blend_ps(
+    mask._raw, if_false._raw, if_true._raw) };
+}
+
+template<>
+constexpr std::array<float, 16>
+float_simd_t<16>::get_scalars(const float_simd_t<16>& vector)
+{
+  return {
+    get_scalar<0>(vector),  get_scalar<1>(vector),  get_scalar<2>(vector),
+    get_scalar<3>(vector),  get_scalar<4>(vector),  get_scalar<5>(vector),
+    get_scalar<6>(vector),  get_scalar<7>(vector),  get_scalar<8>(vector),
+    get_scalar<9>(vector),  get_scalar<10>(vector), get_scalar<11>(vector),
+    get_scalar<12>(vector), get_scalar<13>(vector), get_scalar<14>(vector),
+    get_scalar<15>(vector),
+  };
+}
+
+template<>
+inline void
+float_simd_t<16>::store(float (&values)[16]) const
+{
+  _mm512_storeu_ps(values, _raw);
+}
+#endif
+
+} // namespace RAYTRACER_SIMD_ISA
 } // namespace Raytracer::Math
 
 namespace std {
@@ -351,9 +683,12 @@ using Raytracer::Math::float_simd_t;
 inline float_simd_t<4>
 abs(float_simd_t<4> value)
 {
-  thread_local __m128i sign_mask_epi32 = _mm_set1_epi32(0x7FFFFFFFU);
-  thread_local __m128 sign_mask = *reinterpret_cast<__m128*>(&sign_mask_epi32);
-  return float_simd_t<4>{ _mm_and_ps(value._raw, sign_mask) };
+  return float_simd_t<4>{ _mm_andnot_ps(_mm_set1_ps(-0.0f), value._raw) };
+}
+inline float_simd_t<4>
+sqrt(float_simd_t<4> value)
+{
+  return float_simd_t<4>{ _mm_sqrt_ps(value._raw) };
 }
 inline float_simd_t<4>
 min(float_simd_t<4> lhs, float_simd_t<4> rhs)
@@ -376,11 +711,12 @@ swap(float_simd_t<4>& lhs, float_simd_t<4>& rhs, bool_simd_t<4> mask)
 
   float_simd_t<4> temp = lhs;
   lhs._raw = _mm_or_ps(_mm_and_ps(rhs._raw, mask._raw),
-                       _mm_andnot_ps(lhs._raw, mask._raw));
+                       _mm_andnot_ps(mask._raw, lhs._raw));
   rhs._raw = _mm_or_ps(_mm_and_ps(temp._raw, mask._raw),
-                       _mm_andnot_ps(rhs._raw, mask._raw));
+                       _mm_andnot_ps(mask._raw, rhs._raw));
 }
 
+#if __AVX2__
 inline void
 swap(float_simd_t<8>& lhs, float_simd_t<8>& rhs, bool_simd_t<8> mask)
 {
@@ -391,13 +727,23 @@ swap(float_simd_t<8>& lhs, float_simd_t<8>& rhs, bool_simd_t<8> mask)
 
   float_simd_t<8> temp = lhs;
   lhs._raw = _mm256_or_ps(_mm256_and_ps(rhs._raw, mask._raw),
-                          _mm256_andnot_ps(lhs._raw, mask._raw));
+                          _mm256_andnot_ps(mask._raw, lhs._raw));
   rhs._raw = _mm256_or_ps(_mm256_and_ps(temp._raw, mask._raw),
-                          _mm256_andnot_ps(rhs._raw, mask._raw));
+                          _mm256_andnot_ps(mask._raw, rhs._raw));
 }
 
 // Oct floats
 inline float_simd_t<8>
+abs(float_simd_t<8> value)
+{
+  return float_simd_t<8>{ _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value._raw) };
+}
+inline float_simd_t<8>
+sqrt(float_simd_t<8> value)
+{
+  return float_simd_t<8>{ _mm256_sqrt_ps(value._raw) };
+}
+inline float_simd_t<8>
 min(float_simd_t<8> lhs, float_simd_t<8> rhs)
 {
   return float_simd_t<8>{ _mm256_min_ps(lhs._raw, rhs._raw) };
@@ -407,4 +753,38 @@ max(float_simd_t<8> lhs, float_simd_t<8> rhs)
 {
   return float_simd_t<8>{ _mm256_max_ps(lhs._raw, rhs._raw) };
 }
+#endif
+
+// Hex floats
+#if __AVX512F__
+inline float_simd_t<16>
+abs(float_simd_t<16> value)
+{
+  return float_simd_t<16>{ _mm512_abs_ps(value._raw) };
+}
+inline float_simd_t<16>
+sqrt(float_simd_t<16> value)
+{
+  return float_simd_t<16>{ _mm512_sqrt_ps(value._raw) };
+}
+inline float_simd_t<16>
+min(float_simd_t<16> lhs, float_simd_t<16> rhs)
+{
+  return float_simd_t<16>{ _mm512_min_ps(lhs._raw, rhs._raw) };
+}
+inline float_simd_t<16>
+max(float_simd_t<16> lhs, float_simd_t<16> rhs)
+{
+  return float_simd_t<16>{ _mm512_max_ps(lhs._raw, rhs._raw) };
+}
+
+inline void
+swap(float_simd_t<16>& lhs, float_simd_t<16>& rhs, bool_simd_t<16> mask)
+{
+  // Lanes set in the mask take the other vector's value
+  float_simd_t<16> temp = lhs;
+  lhs._raw = _mm512_mask_blend_ps(mask._raw, lhs._raw, rhs._raw);
+  rhs._raw = _mm512_mask_blend_ps(mask._raw, rhs._raw, temp._raw);
+}
+#endif
 } // namespace std
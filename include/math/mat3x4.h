@@ -0,0 +1,141 @@
+#pragma once
+
+#include "quat.h"
+#include "vec3.h"
+
+namespace Raytracer::Math {
+/// Affine transform stored as the top three rows of a row-major 4x4 matrix,
+/// the bottom row is implicitly (0, 0, 0, 1)
+struct mat3x4
+{
+  constexpr mat3x4() noexcept
+    : m{ { 1.0f, 0.0f, 0.0f, 0.0f },
+         { 0.0f, 1.0f, 0.0f, 0.0f },
+         { 0.0f, 0.0f, 1.0f, 0.0f } }
+  {}
+  constexpr mat3x4(float e00,
+                   float e01,
+                   float e02,
+                   float e03,
+                   float e10,
+                   float e11,
+                   float e12,
+                   float e13,
+                   float e20,
+                   float e21,
+                   float e22,
+                   float e23) noexcept
+    : m{ { e00, e01, e02, e03 },
+         { e10, e11, e12, e13 },
+         { e20, e21, e22, e23 } }
+  {}
+
+  /// Translation * Rotation * Scale, scale may be non-uniform
+  static mat3x4 from_trs(const vec3& t, const quat& r, const vec3& s)
+  {
+    auto x = r.x, y = r.y, z = r.z, w = r.w;
+    return { (1.0f - 2.0f * y * y - 2.0f * z * z) * s.e[0],
+             (2.0f * x * y - 2.0f * z * w) * s.e[1],
+             (2.0f * x * z + 2.0f * y * w) * s.e[2],
+             t.e[0],
+
+             (2.0f * x * y + 2.0f * z * w) * s.e[0],
+             (1.0f - 2.0f * x * x - 2.0f * z * z) * s.e[1],
+             (2.0f * y * z - 2.0f * x * w) * s.e[2],
+             t.e[1],
+
+             (2.0f * x * z - 2.0f * y * w) * s.e[0],
+             (2.0f * y * z + 2.0f * x * w) * s.e[1],
+             (1.0f - 2.0f * x * x - 2.0f * y * y) * s.e[2],
+             t.e[2] };
+  }
+
+  /// From a column-major 4x4 matrix such as glTF's node matrix
+  template<typename T>
+  static mat3x4 from_column_major(const T* v)
+  {
+    return { static_cast<float>(v[0]), static_cast<float>(v[4]),
+             static_cast<float>(v[8]), static_cast<float>(v[12]),
+             static_cast<float>(v[1]), static_cast<float>(v[5]),
+             static_cast<float>(v[9]), static_cast<float>(v[13]),
+             static_cast<float>(v[2]), static_cast<float>(v[6]),
+             static_cast<float>(v[10]), static_cast<float>(v[14]) };
+  }
+
+  float determinant() const
+  {
+    return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+           m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+           m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+  }
+
+  /// Inverse of an invertible affine transform
+  mat3x4 inverse() const
+  {
+    auto inv_det = 1.0f / determinant();
+    mat3x4 result;
+    result.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+    result.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+    result.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+    result.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+    result.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+    result.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+    result.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+    result.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+    result.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+    for (uint8_t i = 0; i < 3; ++i) {
+      result.m[i][3] = -(result.m[i][0] * m[0][3] + result.m[i][1] * m[1][3] +
+                         result.m[i][2] * m[2][3]);
+    }
+    return result;
+  }
+
+  float m[3][4];
+};
+
+/// Composition, the result applies r first and then l
+inline mat3x4
+dot(const mat3x4& l, const mat3x4& r)
+{
+  mat3x4 result;
+  for (uint8_t i = 0; i < 3; ++i) {
+    for (uint8_t j = 0; j < 4; ++j) {
+      result.m[i][j] = l.m[i][0] * r.m[0][j] + l.m[i][1] * r.m[1][j] +
+                       l.m[i][2] * r.m[2][j];
+    }
+    result.m[i][3] += l.m[i][3];
+  }
+  return result;
+}
+
+inline vec3
+transform_point(const mat3x4& m, const vec3& p)
+{
+  return vec3(
+    m.m[0][0] * p.e[0] + m.m[0][1] * p.e[1] + m.m[0][2] * p.e[2] + m.m[0][3],
+    m.m[1][0] * p.e[0] + m.m[1][1] * p.e[1] + m.m[1][2] * p.e[2] + m.m[1][3],
+    m.m[2][0] * p.e[0] + m.m[2][1] * p.e[1] + m.m[2][2] * p.e[2] + m.m[2][3]);
+}
+
+inline vec3
+transform_vector(const mat3x4& m, const vec3& v)
+{
+  return vec3(m.m[0][0] * v.e[0] + m.m[0][1] * v.e[1] + m.m[0][2] * v.e[2],
+              m.m[1][0] * v.e[0] + m.m[1][1] * v.e[1] + m.m[1][2] * v.e[2],
+              m.m[2][0] * v.e[0] + m.m[2][1] * v.e[1] + m.m[2][2] * v.e[2]);
+}
+
+/// Normals transform by the inverse transpose, pass in the inverse of the
+/// transform applied to the points. The result is not normalized.
+inline vec3
+transform_normal(const mat3x4& inverse, const vec3& n)
+{
+  return vec3(
+    inverse.m[0][0] * n.e[0] + inverse.m[1][0] * n.e[1] +
+      inverse.m[2][0] * n.e[2],
+    inverse.m[0][1] * n.e[0] + inverse.m[1][1] * n.e[1] +
+      inverse.m[2][1] * n.e[2],
+    inverse.m[0][2] * n.e[0] + inverse.m[1][2] * n.e[1] +
+      inverse.m[2][2] * n.e[2]);
+}
+} // namespace Raytracer::Math
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#if !__EMSCRIPTEN__
+#include <immintrin.h>
+
+#include "float_simd.h"
+#endif
+
+#include "vec2.h"
+#include "vec3.h"
+
+/// Random numbers for sampling without any state. Each number is a hash of
+/// the pixel, sample and bounce it is drawn for and of its dimension, so it is
+/// the same whichever thread draws it and in whatever order, and drawing one
+/// never waits on another thread. The hash is pcg4d from Jarzynski and Olano,
+/// Hash Functions for GPU Rendering, which mixes four words into four.
+namespace Raytracer::Math {
+namespace _details_random {
+template<typename T>
+inline void
+pcg4d(T& x, T& y, T& z, T& w)
+{
+  x = x * T(1664525u) + T(1013904223u);
+  y = y * T(1664525u) + T(1013904223u);
+  z = z * T(1664525u) + T(1013904223u);
+  w = w * T(1664525u) + T(1013904223u);
+  x = x + y * w;
+  y = y + z * x;
+  z = z + x * y;
+  w = w + y * z;
+  x = x ^ (x >> 16);
+  y = y ^ (y >> 16);
+  z = z ^ (z >> 16);
+  w = w ^ (w >> 16);
+  x = x + y * w;
+  y = y + z * x;
+  z = z + x * y;
+  w = w + y * z;
+}
+
+/// Each group of four dimensions is hashed together
+template<typename T>
+inline T
+random_bits(T pixel, uint32_t sample, uint32_t bounce, uint32_t dimension)
+{
+  T x = pixel;
+  T y = T(sample);
+  T z = T(bounce);
+  T w = T(dimension / 4);
+  pcg4d(x, y, z, w);
+  switch (dimension % 4) {
+    case 0:
+      return x;
+    case 1:
+      return y;
+    case 2:
+      return z;
+    default:
+      return w;
+  }
+}
+
+/// Index of the next number of random_double on the calling thread
+inline uint32_t
+next_index()
+{
+  thread_local uint32_t index = 0;
+  return index++;
+}
+} // namespace _details_random
+
+/// Value in [0, 1) from the top 24 bits of a word, exact in a float
+inline float
+unit_float(uint32_t bits)
+{
+  return static_cast<float>(bits >> 8) / static_cast<float>(1u << 24);
+}
+
+inline uint32_t
+reverse_bits(uint32_t value)
+{
+  value = ((value >> 1) & 0x55555555u) | ((value & 0x55555555u) << 1);
+  value = ((value >> 2) & 0x33333333u) | ((value & 0x33333333u) << 2);
+  value = ((value >> 4) & 0x0F0F0F0Fu) | ((value & 0x0F0F0F0Fu) << 4);
+  value = ((value >> 8) & 0x00FF00FFu) | ((value & 0x00FF00FFu) << 8);
+  return (value >> 16) | (value << 16);
+}
+
+inline uint32_t
+random_bits(uint32_t pixel,
+            uint32_t sample,
+            uint32_t bounce,
+            uint32_t dimension)
+{
+  return _details_random::random_bits(pixel, sample, bounce, dimension);
+}
+
+/// In [0, 1)
+inline float
+random_unit_float(uint32_t pixel,
+                  uint32_t sample,
+                  uint32_t bounce,
+                  uint32_t dimension)
+{
+  return unit_float(random_bits(pixel, sample, bounce, dimension));
+}
+
+#if !__EMSCRIPTEN__
+inline namespace RAYTRACER_SIMD_ISA {
+namespace _details_uint_simd_t {
+template<uint8_t D>
+struct uint_simd_t;
+
+template<>
+struct uint_simd_t<4>
+{
+  explicit uint_simd_t(uint32_t scalar)
+    : value(_mm_set1_epi32(static_cast<int32_t>(scalar)))
+  {}
+  explicit uint_simd_t(__m128i _value)
+    : value(_value)
+  {}
+  /// first, first + 1, ...
+  static uint_simd_t sequence(uint32_t first)
+  {
+    return uint_simd_t(first) + uint_simd_t(_mm_setr_epi32(0, 1, 2, 3));
+  }
+  uint_simd_t operator+(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm_add_epi32(value, rhs.value));
+  }
+  uint_simd_t operator*(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm_mullo_epi32(value, rhs.value));
+  }
+  uint_simd_t operator^(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm_xor_si128(value, rhs.value));
+  }
+  uint_simd_t operator>>(int bits) const
+  {
+    return uint_simd_t(_mm_srli_epi32(value, bits));
+  }
+  float_simd_t<4> to_unit_float() const
+  {
+    auto top = _mm_cvtepi32_ps(_mm_srli_epi32(value, 8));
+    return float_simd_t<4>(
+      _mm_mul_ps(top, _mm_set1_ps(1.0f / static_cast<float>(1u << 24))));
+  }
+
+  __m128i value;
+};
+
+#if __AVX2__
+template<>
+struct uint_simd_t<8>
+{
+  explicit uint_simd_t(uint32_t scalar)
+    : value(_mm256_set1_epi32(static_cast<int32_t>(scalar)))
+  {}
+  explicit uint_simd_t(__m256i _value)
+    : value(_value)
+  {}
+  /// first, first + 1, ...
+  static uint_simd_t sequence(uint32_t first)
+  {
+    return uint_simd_t(first) +
+           uint_simd_t(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+  }
+  uint_simd_t operator+(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm256_add_epi32(value, rhs.value));
+  }
+  uint_simd_t operator*(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm256_mullo_epi32(value, rhs.value));
+  }
+  uint_simd_t operator^(uint_simd_t rhs) const
+  {
+    return uint_simd_t(_mm256_xor_si256(value, rhs.value));
+  }
+  uint_simd_t operator>>(int bits) const
+  {
+    return uint_simd_t(_mm256_srli_epi32(value, bits));
+  }
+  float_simd_t<8> to_unit_float() const
+  {
+    auto top = _mm256_cvtepi32_ps(_mm256_srli_epi32(value, 8));
+    auto scale = _mm256_set1_ps(1.0f / static_cast<float>(1u << 24));
+    return float_simd_t<8>(_mm256_mul_ps(top, scale));
+  }
+
+  __m256i value;
+};
+#endif
+} // namespace _details_uint_simd_t
+
+/// random_unit_float of each of the D pixels from first_pixel, lane by lane
+template<uint8_t D>
+inline float_simd_t<D>
+random_unit_floats(uint32_t first_pixel,
+                   uint32_t sample,
+                   uint32_t bounce,
+                   uint32_t dimension)
+{
+  using uint_simd_t = _details_uint_simd_t::uint_simd_t<D>;
+  return _details_random::random_bits(
+           uint_simd_t::sequence(first_pixel), sample, bounce, dimension)
+    .to_unit_float();
+}
+} // namespace RAYTRACER_SIMD_ISA
+#endif
+
+/// Sample in [0, 1)^2 of a grid of at least sample_count cells, one per
+/// sample, placed within its cell by u and v in [0, 1)
+inline vec2
+stratified_sample(uint32_t sample, uint32_t sample_count, float u, float v)
+{
+  auto columns = static_cast<uint32_t>(
+    std::ceil(std::sqrt(static_cast<float>(sample_count))));
+  auto rows = (sample_count + columns - 1) / columns;
+  return vec2((static_cast<float>(sample % columns) + u) / columns,
+              (static_cast<float>(sample / columns) + v) / rows);
+}
+
+/// Point of the (0, 2) sequence of Kollig and Keller, the van der Corput
+/// sequence against the first dimension of Sobol'. Any 2^k points starting at
+/// a multiple of 2^k have one point in each of the 2^k cells of every grid of
+/// 2^k cells, which scrambling the bits of each dimension by xor keeps
+inline vec2
+sample_02(uint32_t index, uint32_t scramble_x, uint32_t scramble_y)
+{
+  uint32_t x = reverse_bits(index) ^ scramble_x;
+  uint32_t y = scramble_y;
+  for (uint32_t bit = 1u << 31; index != 0; index >>= 1, bit ^= bit >> 1) {
+    if (index & 1u) {
+      y ^= bit;
+    }
+  }
+  return vec2(unit_float(x), unit_float(y));
+}
+
+/// Point of the (0, 2) sequence scrambled for a pixel and bounce, the samples
+/// of the pixel are its first points. dimension and dimension + 1 key the
+/// scrambling
+inline vec2
+low_discrepancy_sample(uint32_t pixel,
+                       uint32_t sample,
+                       uint32_t bounce,
+                       uint32_t dimension)
+{
+  return sample_02(sample,
+                   random_bits(pixel, 0, bounce, dimension),
+                   random_bits(pixel, 0, bounce, dimension + 1));
+}
+
+/// Next number of a sequence of the calling thread, the same on every run,
+/// for setting up scenes and benchmarks. Samples should be drawn with the
+/// functions above instead
+inline double
+random_double()
+{
+  return random_bits(_details_random::next_index(), 0, 0, 0) / 4294967296.0;
+}
+
+/// In [0, 1)
+inline float
+random_float()
+{
+  return random_unit_float(_details_random::next_index(), 0, 0, 0);
+}
+
+inline vec3
+random_in_unit_sphere()
+{
+  vec3 p;
+  do {
+    p = 2.0f * vec3(random_float(), random_float(), random_float()) -
+        vec3(1, 1, 1);
+  } while (p.squared_length() >= 1.0);
+  return p;
+}
+} // namespace Raytracer::Math
@@ -0,0 +1,17 @@
+#pragma once
+
+/// The simd types are compiled once per instruction set: at the library's
+/// baseline and again in each of the kernel translation units. Naming the
+/// instruction set in an inline namespace gives every copy of their inline
+/// functions a different symbol, so the linker can never substitute a copy
+/// built for a newer instruction set into code that runs on an older cpu.
+#if __AVX512F__
+#define RAYTRACER_SIMD_ISA avx512
+#define RAYTRACER_SIMD_ISA_NAME "avx512"
+#elif __AVX2__
+#define RAYTRACER_SIMD_ISA avx2
+#define RAYTRACER_SIMD_ISA_NAME "avx2"
+#else
+#define RAYTRACER_SIMD_ISA sse42
+#define RAYTRACER_SIMD_ISA_NAME "sse42"
+#endif
@@ -209,36 +209,13 @@ normalize(const vec3& v)
   return v / v.length();
 }
 
-inline double
-random_double()
-{
-  return rand() / (RAND_MAX + 1.0);
-}
-
-inline float
-random_float()
-{
-  return static_cast<float>(random_double());
-}
-
-inline vec3
-random_in_unit_sphere()
-{
-  vec3 p;
-  do {
-    p = 2.0f * vec3(random_float(), random_float(), random_float()) -
-        vec3(1, 1, 1);
-  } while (p.squared_length() >= 1.0);
-  return p;
-}
-
 inline vec3
 reflect(const vec3& v, const vec3& n)
 {
   return v - 2 * dot(v, n) * n;
 }
 
-static vec3
+inline vec3
 lerp(const vec3& from, const vec3& to, float t)
 {
   return from * t + to * (1.0f - t);
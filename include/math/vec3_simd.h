@@ -3,9 +3,11 @@
 #include <array>
 
 #include "float_simd.h"
+#include "simd_isa.h"
 #include "vec3.h"
 
 namespace Raytracer::Math {
+inline namespace RAYTRACER_SIMD_ISA {
 
 template<uint8_t D>
 struct vec3_simd
@@ -63,79 +65,106 @@ struct vec3_simd
 template<>
 inline vec3_simd<4>::vec3_simd(const vec3 (&scalars)[4])
   : e{ float_simd_t<4>(
-         { scalars[3].x(), scalars[2].x(), scalars[1].x(), scalars[0].x() }),
+         { scalars[0].x(), scalars[1].x(), scalars[2].x(), scalars[3].x() }),
        float_simd_t<4>(
-         { scalars[3].y(), scalars[2].y(), scalars[1].y(), scalars[0].y() }),
+         { scalars[0].y(), scalars[1].y(), scalars[2].y(), scalars[3].y() }),
        float_simd_t<4>(
-         { scalars[3].z(), scalars[2].z(), scalars[1].z(), scalars[0].z() }) }
+         { scalars[0].z(), scalars[1].z(), scalars[2].z(), scalars[3].z() }) }
 {}
 
 template<>
 inline vec3_simd<4>::vec3_simd(const vec3 scalars[])
   : e{ float_simd_t<4>(
-         { scalars[3].x(), scalars[2].x(), scalars[1].x(), scalars[0].x() }),
+         { scalars[0].x(), scalars[1].x(), scalars[2].x(), scalars[3].x() }),
        float_simd_t<4>(
-         { scalars[3].y(), scalars[2].y(), scalars[1].y(), scalars[0].y() }),
+         { scalars[0].y(), scalars[1].y(), scalars[2].y(), scalars[3].y() }),
        float_simd_t<4>(
-         { scalars[3].z(), scalars[2].z(), scalars[1].z(), scalars[0].z() }) }
+         { scalars[0].z(), scalars[1].z(), scalars[2].z(), scalars[3].z() }) }
 {}
 
 // Oct vec3
+#if __AVX2__
 
 template<>
 inline vec3_simd<8>::vec3_simd(const vec3 (&scalars)[8])
-  : e{ float_simd_t<8>({ scalars[7].x(),
-                         scalars[6].x(),
-                         scalars[5].x(),
-                         scalars[4].x(),
-                         scalars[3].x(),
-                         scalars[2].x(),
+  : e{ float_simd_t<8>({ scalars[0].x(),
                          scalars[1].x(),
-                         scalars[0].x() }),
-       float_simd_t<8>({ scalars[7].y(),
-                         scalars[6].y(),
-                         scalars[5].y(),
-                         scalars[4].y(),
-                         scalars[3].y(),
-                         scalars[2].y(),
+                         scalars[2].x(),
+                         scalars[3].x(),
+                         scalars[4].x(),
+                         scalars[5].x(),
+                         scalars[6].x(),
+                         scalars[7].x() }),
+       float_simd_t<8>({ scalars[0].y(),
                          scalars[1].y(),
-                         scalars[0].y() }),
-       float_simd_t<8>({ scalars[7].z(),
-                         scalars[6].z(),
-                         scalars[5].z(),
-                         scalars[4].z(),
-                         scalars[3].z(),
-                         scalars[2].z(),
+                         scalars[2].y(),
+                         scalars[3].y(),
+                         scalars[4].y(),
+                         scalars[5].y(),
+                         scalars[6].y(),
+                         scalars[7].y() }),
+       float_simd_t<8>({ scalars[0].z(),
                          scalars[1].z(),
-                         scalars[0].z() }) }
+                         scalars[2].z(),
+                         scalars[3].z(),
+                         scalars[4].z(),
+                         scalars[5].z(),
+                         scalars[6].z(),
+                         scalars[7].z() }) }
 {}
 
 template<>
 inline vec3_simd<8>::vec3_simd(const vec3 scalars[])
-  : e{ float_simd_t<8>({ scalars[7].x(),
-                         scalars[6].x(),
-                         scalars[5].x(),
-                         scalars[4].x(),
-                         scalars[3].x(),
-                         scalars[2].x(),
+  : e{ float_simd_t<8>({ scalars[0].x(),
                          scalars[1].x(),
-                         scalars[0].x() }),
-       float_simd_t<8>({ scalars[7].y(),
-                         scalars[6].y(),
-                         scalars[5].y(),
-                         scalars[4].y(),
-                         scalars[3].y(),
-                         scalars[2].y(),
+                         scalars[2].x(),
+                         scalars[3].x(),
+                         scalars[4].x(),
+                         scalars[5].x(),
+                         scalars[6].x(),
+                         scalars[7].x() }),
+       float_simd_t<8>({ scalars[0].y(),
                          scalars[1].y(),
-                         scalars[0].y() }),
-       float_simd_t<8>({ scalars[7].z(),
-                         scalars[6].z(),
-                         scalars[5].z(),
-                         scalars[4].z(),
-                         scalars[3].z(),
-                         scalars[2].z(),
+                         scalars[2].y(),
+                         scalars[3].y(),
+                         scalars[4].y(),
+                         scalars[5].y(),
+                         scalars[6].y(),
+                         scalars[7].y() }),
+       float_simd_t<8>({ scalars[0].z(),
                          scalars[1].z(),
-                         scalars[0].z() }) }
+                         scalars[2].z(),
+                         scalars[3].z(),
+                         scalars[4].z(),
+                         scalars[5].z(),
+                         scalars[6].z(),
+                         scalars[7].z() }) }
+{}
+#endif
+
+// Hex vec3
+#if __AVX512F__
+
+template<>
+inline vec3_simd<16>::vec3_simd(const vec3 scalars[])
+  : e{ float_simd_t<16>(0.0f), float_simd_t<16>(0.0f), float_simd_t<16>(0.0f) }
+{
+  float axes[3][16];
+  for (uint8_t i = 0; i < 16; ++i) {
+    axes[0][i] = scalars[i].x();
+    axes[1][i] = scalars[i].y();
+    axes[2][i] = scalars[i].z();
+  }
+  for (uint8_t axis = 0; axis < 3; ++axis) {
+    e[axis] = float_simd_t<16>(axes[axis]);
+  }
+}
+
+template<>
+inline vec3_simd<16>::vec3_simd(const vec3 (&scalars)[16])
+  : vec3_simd(static_cast<const vec3*>(scalars))
 {}
+#endif
 
+} // namespace RAYTRACER_SIMD_ISA
 } // namespace Raytracer::Math
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+#include <string>
+
+/// Timeline of named zones recorded per thread and exported as Chrome trace
+/// json, which chrome://tracing and Perfetto open. Recording is off unless the
+/// RAYTRACER_PROFILE environment variable is set, which also names the file
+/// dump() writes, or set_enabled is called. Each thread keeps its most recent
+/// zones in a ring buffer of its own, so recording takes no locks.
+namespace Raytracer::Profiler {
+bool is_enabled();
+void set_enabled(bool value);
+/// Name of the calling thread in traces
+void set_thread_name(const std::string& name);
+/// Write the recorded zones of every thread, returns false if the file could
+/// not be written
+bool dump(const std::string& file_name);
+/// Same to the file named by RAYTRACER_PROFILE, or trace.json
+bool dump();
+
+/// Time between construction and destruction recorded under name, which must
+/// outlive the profiler such as a string literal
+class ScopedZone
+{
+public:
+  explicit ScopedZone(const char* name) noexcept;
+  ~ScopedZone();
+  ScopedZone(const ScopedZone&) = delete;
+  ScopedZone& operator=(const ScopedZone&) = delete;
+
+private:
+  const char* name;
+  /// Nanoseconds since the profiler started, only if recording
+  uint64_t start;
+  bool recording;
+};
+} // namespace Raytracer::Profiler
@@ -68,13 +68,19 @@ struct RaySimd
 };
 
 static_assert(sizeof(RaySimd<4>) == 0x60, "quad ray is not minimal size");
+#if __AVX2__
 static_assert(sizeof(RaySimd<8>) == 0xC0, "oct ray is not minimal size");
 #endif
+#if __AVX512F__
+static_assert(sizeof(RaySimd<16>) == 0x180, "hex ray is not minimal size");
+#endif
+#endif
 
 struct RayPayload
 {
   RayPayload()
     : type(Type::NoHit)
+    , mat_id(0)
   {}
   enum class Type
   {
@@ -101,5 +107,6 @@ struct RayPayload
   vec3 tangent;
   Type type;
   uint32_t bvh_hits;
+  uint16_t mat_id;
 };
 } // namespace Raytracer
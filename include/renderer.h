@@ -33,6 +33,7 @@ public:
   {
     Whitted,
     Gpu,
+    Path,
   };
   virtual ~Renderer() = default;
   virtual void run(const Scene& world) = 0;
@@ -48,6 +49,20 @@ public:
   virtual uint8_t get_recursion_depth() const = 0;
   virtual void set_recursion_depth(uint8_t value) = 0;
 
+  /// Cpu threads rendering a frame, 0 for renderers which do not use any
+  virtual uint32_t get_thread_count() const = 0;
+  /// A value of 0 uses one thread per hardware thread
+  virtual void set_thread_count(uint32_t value) = 0;
+
+  /// Whether frames are traced on a thread of the renderer's own, run then
+  /// only presents the last frame finished and never waits for tracing. The
+  /// thread traces a snapshot of the scene, which can be edited meanwhile
+  virtual bool get_asynchronous() const = 0;
+  virtual void set_asynchronous(bool value) = 0;
+
+  /// Printf formats of one float each. Formats starting with "[STAT] " are
+  /// listed in the stats window, "[GRAPH:i] name" ones are plotted together as
+  /// the histogram name, the others are shown in the menu bar.
   virtual std::vector<std::pair<std::string, float>> evaluate_metrics() = 0;
   virtual std::vector<std::pair<std::string, uintptr_t>> debug_textures() = 0;
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "scene_node.h"
@@ -20,32 +23,81 @@ struct Object;
 using namespace Materials;
 using namespace Hittable;
 
+/// Objects, lights, materials and textures of a scene are shared with its
+/// snapshots and never change once added. Edits replace them with edited
+/// copies instead, so a renderer can trace a snapshot while the scene is edited
 class Scene
 {
 public:
   virtual ~Scene();
 
+  /// Written by a loader as it goes, to be read from any thread
+  struct LoadProgress
+  {
+    LoadProgress()
+      : stage("")
+      , fraction(0.0f)
+    {}
+    /// Name of the stage of the loader running
+    std::atomic<const char*> stage;
+    /// Of the stage running, from 0 to 1
+    std::atomic<float> fraction;
+  };
+
   static std::unique_ptr<Scene> load_whitted_scene();
-  static std::unique_ptr<Scene> load_cornell_box();
-  static std::unique_ptr<Scene> load_from_gltf(const std::string& file_name);
+  static std::unique_ptr<Scene> load_cornell_box(
+    LoadProgress* progress = nullptr);
+  /// Decodes textures and builds bvhs on every hardware thread
+  static std::unique_ptr<Scene> load_from_gltf(
+    const std::string& file_name,
+    LoadProgress* progress = nullptr);
   static std::unique_ptr<Scene> load_mandrelbulb();
 
   void run(float width, float height);
 
+  /// Immutable copy of the scene as it is, sharing everything but its camera
+  std::shared_ptr<const Scene> snapshot() const;
+
+  /// Copies made by replicate, kept from one call to the next
+  struct Replicas
+  {
+    /// Copy of each object, texture or mesh by the one it copies, which it
+    /// keeps alive since objects may point to others
+    std::unordered_map<
+      const void*,
+      std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>>>
+      copies;
+  };
+  /// Snapshot with its own copies of the geometry, bvhs and textures, written
+  /// by the calling thread so they stay local to its NUMA node. Only what
+  /// replicas does not hold yet is copied, the rest is dropped from it.
+  /// Materials are small enough to stay shared
+  std::shared_ptr<const Scene> replicate(Replicas& replicas) const;
+
   Camera& get_camera();
   const Camera& get_camera() const;
-  const std::vector<std::unique_ptr<Object>>& get_world() const;
-  std::vector<std::unique_ptr<Object>>& get_world();
-  const std::vector<std::unique_ptr<Object>>& get_lights() const;
-  std::vector<std::unique_ptr<Object>>& get_lights();
+  const std::vector<std::shared_ptr<const Object>>& get_world() const;
+  std::vector<std::shared_ptr<const Object>>& get_world();
+  const std::vector<std::shared_ptr<const Object>>& get_lights() const;
+  std::vector<std::shared_ptr<const Object>>& get_lights();
   const Material& get_material(uint16_t id) const;
   const Texture& get_texture(uint16_t id) const;
-  const std::vector<std::unique_ptr<Material>>& get_material_list() const;
-  std::vector<std::unique_ptr<Material>>& get_material_list();
+  /// Whether materials may sample textures, which need the uv and tangent of
+  /// their hits
+  bool has_textures() const;
+  const std::vector<std::shared_ptr<const Material>>& get_material_list()
+    const;
+  std::vector<std::shared_ptr<const Material>>& get_material_list();
+  /// Changes whenever objects of the world are added, removed or moved, so
+  /// renderers can tell whether what they cached of the last hits still holds
+  uint32_t get_geometry_version() const;
+  /// To call after editing the objects of get_world()
+  void mark_geometry_changed();
   const float min_attenuation_magnitude;
   const uint8_t max_secondary_rays;
 
 private:
+  Scene(const Scene& other);
   Scene(std::vector<SceneNode>&& nodes,
         uint32_t camera_index,
         std::vector<std::unique_ptr<Texture>>&& textures,
@@ -57,9 +109,10 @@ private:
 
   std::vector<SceneNode> nodes;
   uint32_t camera_index;
-  std::vector<std::unique_ptr<Texture>> textures;
-  std::vector<std::unique_ptr<Material>> materials;
-  std::vector<std::unique_ptr<Object>> world_objects;
-  std::vector<std::unique_ptr<Object>> lights;
+  std::vector<std::shared_ptr<const Texture>> textures;
+  std::vector<std::shared_ptr<const Material>> materials;
+  std::vector<std::shared_ptr<const Object>> world_objects;
+  std::vector<std::shared_ptr<const Object>> lights;
+  uint32_t geometry_version;
 };
 } // namespace Raytracer
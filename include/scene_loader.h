@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "scene.h"
+
+namespace Raytracer {
+/// Loads one scene at a time on a thread of its own, so the scene shown keeps
+/// rendering and the interface stays responsive until the new one is taken
+class SceneLoader
+{
+public:
+  SceneLoader();
+  ~SceneLoader();
+  SceneLoader(const SceneLoader&) = delete;
+  SceneLoader& operator=(const SceneLoader&) = delete;
+
+  /// Start loading cornell, whitted, mandelbulb or a glTF file by name,
+  /// returns false if a scene is still loading
+  bool load(const std::string& scene_name);
+  bool is_loading() const;
+  /// Of the scene loading or last loaded
+  const std::string& get_name() const;
+  const char* get_stage() const;
+  /// Of the current stage, from 0 to 1
+  float get_progress() const;
+  /// The scene once loaded, only returned once. Null while loading or if the
+  /// load failed
+  std::unique_ptr<Scene> take();
+
+private:
+  std::thread thread;
+  std::string name;
+  Scene::LoadProgress progress;
+  std::atomic<bool> loading;
+  /// Written by the thread before loading is cleared
+  std::unique_ptr<Scene> loaded_scene;
+};
+} // namespace Raytracer
@@ -11,6 +11,7 @@ union SDL_Event;
 
 namespace Raytracer {
 class Scene;
+class SceneLoader;
 namespace Graphics {
 class Renderer;
 }
@@ -20,7 +21,9 @@ class Ui
 public:
   explicit Ui(SDL_Window* window);
 
+  /// Without a scene, only what does not edit it is shown
   void run(std::unique_ptr<Scene>& scene,
+           SceneLoader& scene_loader,
            Graphics::Renderer& renderer,
            const std::vector<std::pair<std::string, float>>& renderer_metrics,
            std::chrono::microseconds& dt);
@@ -1,11 +1,15 @@
 #include "game.h"
 
 #include "input.h"
+#include "profiler.h"
 #include "renderer.h"
 #include "scene.h"
+#include "scene_loader.h"
 #include "ui.h"
 #include "window.h"
 
+#include <cstdlib>
+
 #if __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
 #endif
@@ -16,11 +20,20 @@ using namespace Raytracer::Graphics;
 Game::Game() {
   constexpr uint16_t width = 800;
   constexpr uint16_t height = 600;
+  Profiler::set_thread_name("main");
   window = std::make_unique<Window>("Raytracer", width, height);
   input = std::make_unique<Input>();
-  renderer = Renderer::create(Renderer::Type::Gpu, window->get_native_handle());
+  auto renderer_type = Renderer::Type::Gpu;
+  auto renderer_name = std::getenv("RAYTRACER_RENDERER");
+  if (renderer_name != nullptr && std::string(renderer_name) == "whitted") {
+    renderer_type = Renderer::Type::Whitted;
+  } else if (renderer_name != nullptr && std::string(renderer_name) == "path") {
+    renderer_type = Renderer::Type::Path;
+  }
+  renderer = Renderer::create(renderer_type, window->get_native_handle());
   ui = std::make_unique<Ui>(window->get_native_handle());
-  scene = Scene::load_cornell_box();
+  scene_loader = std::make_unique<SceneLoader>();
+  scene_loader->load("cornell");
 }
 
 Game::~Game() = default;
@@ -28,7 +41,14 @@ Game::~Game() = default;
 void
 Game::clean_up()
 {
+  // A trace requested from the environment is written on exit
+  if (std::getenv("RAYTRACER_PROFILE") != nullptr && Profiler::is_enabled()) {
+    Profiler::dump();
+  }
   renderer_metrics.clear();
+  // Nothing may be tracing the scene once it is gone
+  renderer->set_asynchronous(false);
+  scene_loader.reset();
   scene.reset();
   ui.reset();
   renderer.reset();
@@ -39,17 +59,40 @@ Game::clean_up()
 bool
 Game::main_loop()
 {
+  auto zone = Profiler::ScopedZone("Game::main_loop");
   take_timestamp();
   auto delta_time = get_delta_time();
   uint16_t width, height;
   window->get_dimensions(width, height);
   renderer->set_backbuffer_size(width, height);
-  input->run(*ui, *scene, delta_time);
-  ui->run(scene, *renderer, renderer_metrics, delta_time);
-  renderer->run(*scene);
-  ui->draw();
-  scene->run(width, height);
-  window->swap();
+  // Frames traced asynchronously hold a snapshot of the scene they started
+  // with, so it can be replaced whenever
+  if (auto loaded = scene_loader->take()) {
+    scene = std::move(loaded);
+  }
+  {
+    auto input_zone = Profiler::ScopedZone("input");
+    input->run(*ui, scene.get(), delta_time);
+  }
+  {
+    auto ui_zone = Profiler::ScopedZone("ui");
+    ui->run(scene, *scene_loader, *renderer, renderer_metrics, delta_time);
+  }
+  if (scene) {
+    renderer->run(*scene);
+  }
+  {
+    auto ui_draw_zone = Profiler::ScopedZone("ui draw");
+    ui->draw();
+  }
+  if (scene) {
+    auto scene_zone = Profiler::ScopedZone("scene");
+    scene->run(width, height);
+  }
+  {
+    auto swap_zone = Profiler::ScopedZone("swap");
+    window->swap();
+  }
   renderer_metrics = renderer->evaluate_metrics();
 
   return !input->should_quit();
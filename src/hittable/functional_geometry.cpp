@@ -3,7 +3,9 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include "counters.h"
 #include "hit_record.h"
+#include "math/fast_math.h"
 #include "ray.h"
 #include "sdf.h"
 
@@ -12,7 +14,10 @@ using Raytracer::hit_record;
 using Raytracer::Ray;
 using Raytracer::Hittable::FunctionalGeometry;
 using Raytracer::Hittable::Object;
+using Raytracer::Math::Accuracy;
+using Raytracer::Math::transcendental_accuracy;
 using Raytracer::Math::vec3;
+namespace fast = Raytracer::Math::fast;
 
 FunctionalGeometry::FunctionalGeometry(const vec3& center,
                                        uint8_t max_steps,
@@ -27,8 +32,66 @@ FunctionalGeometry::FunctionalGeometry(const vec3& center,
   bounding_box(aabb);
 }
 
+namespace {
+struct ExactMath
+{
+  static float acos(float x) { return std::acos(x); }
+  static float atan2(float y, float x) { return std::atan2(y, x); }
+  static float pow(float x, float y) { return std::pow(x, y); }
+  static float sin(float x) { return std::sin(x); }
+  static float cos(float x) { return std::cos(x); }
+  static float log(float x) { return std::log(x); }
+};
+
+struct FastMath
+{
+  static float acos(float x) { return fast::acos(x); }
+  static float atan2(float y, float x) { return fast::atan2(y, x); }
+  static float pow(float x, float y) { return fast::pow(x, y); }
+  static float sin(float x) { return fast::sin(x); }
+  static float cos(float x) { return fast::cos(x); }
+  static float log(float x) { return fast::log(x); }
+};
+
 // From
 // http://blog.hvidtfeldts.net/index.php/2011/09/distance-estimated-3d-fractals-v-the-mandelbulb-different-de-approximations/
+template<typename M>
+float
+mandelbulb_distance(const vec3& position,
+                    const vec3& center,
+                    uint8_t max_iterations,
+                    float max_radius,
+                    float power)
+{
+  vec3 z = position - center;
+  float dr = 1.0;
+  float radius = 0.0;
+  for (uint8_t i = 0; i < max_iterations; i++) {
+    radius = z.length();
+    if (radius > max_radius)
+      break;
+
+    // convert to polar coordinates
+    float theta = M::acos(z.y() / radius);
+    float phi = M::atan2(z.z(), z.x());
+    float zr = M::pow(radius, power);
+    // radius^(power - 1) from the one above
+    dr = zr / radius * power * dr + 1.0f;
+
+    // scale and rotate the point
+    theta = theta * power;
+    phi = phi * power;
+
+    // convert back to cartesian coordinates
+    z = zr * vec3(M::sin(theta) * M::cos(phi),
+                  M::sin(phi) * M::sin(theta),
+                  M::cos(theta));
+    z += position;
+  }
+  return 0.5f * M::log(radius) * radius / dr;
+}
+} // namespace
+
 std::unique_ptr<FunctionalGeometry>
 FunctionalGeometry::mandrelbulb(const vec3& center,
                                 uint8_t max_iterations,
@@ -38,31 +101,13 @@ FunctionalGeometry::mandrelbulb(const vec3& center,
 {
   auto signed_distance_function =
     [center, max_iterations, max_radius, power](const vec3& position) {
-      vec3 z = position - center;
-      float dr = 1.0;
-      float radius = 0.0;
-      for (uint8_t i = 0; i < max_iterations; i++) {
-        radius = z.length();
-        if (radius > max_radius)
-          break;
-
-        // convert to polar coordinates
-        float theta = std::acos(z.y() / radius);
-        float phi = std::atan2(z.z(), z.x());
-        dr = std::pow(radius, power - 1.0f) * power * dr + 1.0f;
-
-        // scale and rotate the point
-        float zr = pow(radius, power);
-        theta = theta * power;
-        phi = phi * power;
-
-        // convert back to cartesian coordinates
-        z = zr * vec3(std::sin(theta) * std::cos(phi),
-                      std::sin(phi) * std::sin(theta),
-                      std::cos(theta));
-        z += position;
+      if (transcendental_accuracy.load(std::memory_order_relaxed) ==
+          Accuracy::Fast) {
+        return mandelbulb_distance<FastMath>(
+          position, center, max_iterations, max_radius, power);
       }
-      return 0.5f * std::log(radius) * radius / dr;
+      return mandelbulb_distance<ExactMath>(
+        position, center, max_iterations, max_radius, power);
     };
   return std::make_unique<FunctionalGeometry>(
     center, static_cast<uint8_t>(100), signed_distance_function, m);
@@ -75,6 +120,8 @@ FunctionalGeometry::hit(const Ray& r,
                         float t_max,
                         hit_record& rec) const
 {
+  auto& counters = Counters::local();
+  counters.aabb_tests++;
   if (!Aabb::hit(aabb, r, t_min, t_max)) {
     return false;
   }
@@ -89,6 +136,7 @@ FunctionalGeometry::hit(const Ray& r,
   float dt = 0.0f;
   // Ray march
   for (uint8_t steps = 0; steps < max_steps; steps++) {
+    counters.sdf_steps++;
     auto p = ray.point_at_parameter(t);
     distance = sdf(p);
     if (distance < 0.001f) {
@@ -128,8 +176,16 @@ FunctionalGeometry::hit(const Ray& r,
   rec.normal.make_unit_vector();
   rec.tangent = cross(rec.normal, vec3(0, 1, 0));
   rec.tangent.make_unit_vector();
-  rec.uv.e[0] = 0.5f + std::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
-  rec.uv.e[1] = 0.5f - std::asin(-rec.normal.y()) * f32_1_PI;
+  if (transcendental_accuracy.load(std::memory_order_relaxed) ==
+      Accuracy::Fast) {
+    rec.uv.e[0] =
+      0.5f + fast::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
+    rec.uv.e[1] = 0.5f - fast::asin(-rec.normal.y()) * f32_1_PI;
+  } else {
+    rec.uv.e[0] =
+      0.5f + std::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
+    rec.uv.e[1] = 0.5f - std::asin(-rec.normal.y()) * f32_1_PI;
+  }
   rec.mat_id = mat_id;
   return true;
 }
@@ -137,9 +193,12 @@ FunctionalGeometry::hit(const Ray& r,
 bool
 FunctionalGeometry::bounding_box(Aabb& box)
 {
-  vec3 min(0.f, 0.f, 0.f), max(1.f, 1.f, 1.f);
+  // The distance functions are expected to fit within this radius of the
+  // center
+  constexpr float extent = 1.5f;
 
-  box = Aabb{ min, max };
+  box = Aabb{ center - vec3(extent, extent, extent),
+              center + vec3(extent, extent, extent) };
   return true;
 }
 
@@ -3,14 +3,18 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include "counters.h"
 #include "hit_record.h"
 #include "ray.h"
 
+using Raytracer::Aabb;
 using Raytracer::hit_record;
 using Raytracer::Ray;
+using Raytracer::Hittable::Instance;
 using Raytracer::Hittable::Object;
 using Raytracer::Hittable::Rotate_y;
 using Raytracer::Hittable::Translate;
+using Raytracer::Math::mat3x4;
 using Raytracer::Math::vec3;
 
 Translate::Translate(const Object* _p, vec3 _offset)
@@ -106,3 +110,80 @@ Rotate_y::copy() const
 {
   return std::make_unique<Rotate_y>(p, angle);
 }
+
+Instance::Instance(std::shared_ptr<const Object> _blas,
+                   const Aabb& _blas_bounds,
+                   const mat3x4& _object_to_world,
+                   uint16_t m)
+  : blas(std::move(_blas))
+  , blas_bounds(_blas_bounds)
+  , object_to_world(_object_to_world)
+  , world_to_object(_object_to_world.inverse())
+  , mat_id(m)
+  , aabb()
+{
+  bounding_box(aabb);
+}
+
+bool
+Instance::hit(const Ray& r,
+              bool early_out,
+              float t_min,
+              float t_max,
+              hit_record& rec) const
+{
+  Counters::local().aabb_tests++;
+  if (!Aabb::hit(aabb, r, t_min, t_max)) {
+    return false;
+  }
+
+  // The direction is left unnormalized so that t is the same in both spaces
+  Ray object_r(transform_point(world_to_object, r.origin),
+               transform_vector(world_to_object, r.direction));
+
+  if (!blas->hit(object_r, early_out, t_min, t_max, rec)) {
+    return false;
+  }
+
+  rec.p = r.point_at_parameter(rec.t);
+  rec.normal = normalize(transform_normal(world_to_object, rec.normal));
+  rec.tangent = normalize(transform_vector(object_to_world, rec.tangent));
+  if (mat_id != std::numeric_limits<uint16_t>::max()) {
+    rec.mat_id = mat_id;
+  }
+
+  return true;
+}
+
+bool
+Instance::hit_primitive(const Ray& r,
+                        uint32_t primitive,
+                        float t_min,
+                        float t_max) const
+{
+  Ray object_r(transform_point(world_to_object, r.origin),
+               transform_vector(world_to_object, r.direction));
+  return blas->hit_primitive(object_r, primitive, t_min, t_max);
+}
+
+uint16_t
+Instance::get_mat_id() const
+{
+  if (mat_id != std::numeric_limits<uint16_t>::max()) {
+    return mat_id;
+  }
+  return blas->get_mat_id();
+}
+
+std::unique_ptr<Object>
+Instance::copy() const
+{
+  return std::make_unique<Instance>(blas, blas_bounds, object_to_world, mat_id);
+}
+
+bool
+Instance::bounding_box(Aabb& box)
+{
+  box = Aabb::transform(blas_bounds, object_to_world);
+  return true;
+}
@@ -0,0 +1,17 @@
+#include "hittable/object.h"
+
+#include "hit_record.h"
+
+using Raytracer::hit_record;
+using Raytracer::Ray;
+using Raytracer::Hittable::Object;
+
+bool
+Object::hit_primitive(const Ray& r,
+                      [[maybe_unused]] uint32_t primitive,
+                      float t_min,
+                      float t_max) const
+{
+  hit_record rec;
+  return hit(r, true, t_min, t_max, rec);
+}
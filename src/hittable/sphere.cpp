@@ -3,7 +3,9 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#include "counters.h"
 #include "hit_record.h"
+#include "math/fast_math.h"
 #include "ray.h"
 
 using Raytracer::Aabb;
@@ -11,7 +13,10 @@ using Raytracer::hit_record;
 using Raytracer::Ray;
 using Raytracer::Hittable::Object;
 using Raytracer::Hittable::Sphere;
+using Raytracer::Math::Accuracy;
+using Raytracer::Math::transcendental_accuracy;
 using Raytracer::Math::vec3;
+namespace fast = Raytracer::Math::fast;
 
 Sphere::Sphere(vec3 cen, float r, uint16_t m)
   : center(cen)
@@ -31,7 +36,7 @@ Sphere::hit(const Ray& r,
             float t_max,
             hit_record& rec) const
 {
-
+  Counters::local().aabb_tests++;
   if (!Aabb::hit(aabb, r, t_min, t_max)) {
     return false;
   }
@@ -57,9 +62,16 @@ Sphere::hit(const Ray& r,
     rec.normal = (rec.p - center) / radius;
     rec.tangent = cross(rec.normal, vec3(0, 1, 0));
     rec.tangent.make_unit_vector();
-    rec.uv.e[0] =
-      0.5f + std::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
-    rec.uv.e[1] = 0.5f - std::asin(-rec.normal.y()) * f32_1_PI;
+    if (transcendental_accuracy.load(std::memory_order_relaxed) ==
+        Accuracy::Fast) {
+      rec.uv.e[0] =
+        0.5f + fast::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
+      rec.uv.e[1] = 0.5f - fast::asin(-rec.normal.y()) * f32_1_PI;
+    } else {
+      rec.uv.e[0] =
+        0.5f + std::atan2(-rec.normal.z(), rec.normal.x()) * f32_1_2PI;
+      rec.uv.e[1] = 0.5f - std::asin(-rec.normal.y()) * f32_1_PI;
+    }
     rec.mat_id = mat_id;
     return true;
   }
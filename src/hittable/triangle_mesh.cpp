@@ -3,7 +3,10 @@
 #include <array>
 #include <queue>
 
+#include "counters.h"
 #include "hit_record.h"
+#include "kernels.h"
+#include "profiler.h"
 #include "ray.h"
 
 using Raytracer::Aabb;
@@ -29,7 +32,6 @@ TriangleMesh::TriangleMesh(std::vector<vec3>&& positions,
 
 TriangleMesh::~TriangleMesh() = default;
 
-/// Möller–Trumbore intersection algorithm
 bool
 TriangleMesh::hit(const Ray& r,
                   bool early_out,
@@ -37,6 +39,8 @@ TriangleMesh::hit(const Ray& r,
                   float t_max,
                   hit_record& rec) const
 {
+  auto& counters = Counters::local();
+  counters.aabb_tests++;
   if (bvh.empty()) {
     // No bvh, bruteforce all triangles
     if (!Aabb::hit(aabb, r, t_min, t_max)) {
@@ -50,89 +54,74 @@ TriangleMesh::hit(const Ray& r,
                                    t_max,
                                    rec);
   } else {
-    // Traverse bvh and find indices
-    std::queue<uint32_t> nodes_to_visit;
-    nodes_to_visit.emplace(0);
+    // Traverse bvh depth first and find indices, both children of a node are
+    // tested at once
+    if (!Aabb::hit(bvh[0].bounds, r, t_min, t_max)) {
+      return false;
+    }
+    auto& kernels = Kernels::get();
+    thread_local std::vector<uint32_t> nodes_to_visit;
+    nodes_to_visit.clear();
+    nodes_to_visit.emplace_back(0);
     float closest_so_far = t_max;
     bool hit_anything = false;
     while (!nodes_to_visit.empty()) {
-      auto& node = bvh[nodes_to_visit.front()];
-      if (Aabb::hit(node.bounds, r, t_min, closest_so_far)) {
-        rec.bvh_hits++;
-        if (node.is_leaf()) {
-          hit_record temp_rec;
-          if (ray_triangles_intersect(r,
-                                      &bvh_optimized_indices[node.index_offset],
-                                      node.index_count,
-                                      early_out,
-                                      t_min,
-                                      closest_so_far,
-                                      temp_rec)) {
-            hit_anything = true;
-            // TODO: This might always be true
-            if (closest_so_far > temp_rec.t) {
-              closest_so_far = temp_rec.t;
-              rec = temp_rec;
-              if (early_out) {
-                break;
-              }
+      auto& node = bvh[nodes_to_visit.back()];
+      nodes_to_visit.pop_back();
+      rec.bvh_hits++;
+      counters.bvh_nodes++;
+      if (node.is_leaf()) {
+        hit_record temp_rec;
+        if (ray_triangles_intersect(r,
+                                    &bvh_optimized_indices[node.index_offset],
+                                    node.index_count,
+                                    early_out,
+                                    t_min,
+                                    closest_so_far,
+                                    temp_rec)) {
+          hit_anything = true;
+          // TODO: This might always be true
+          if (closest_so_far > temp_rec.t) {
+            closest_so_far = temp_rec.t;
+            rec = temp_rec;
+            if (early_out) {
+              break;
             }
           }
-
-        } else {
-          // Add children
-          assert(node.left_bvh_offset < bvh.size());
-          assert(node.right_bvh_offset() < bvh.size());
-          nodes_to_visit.emplace(node.left_bvh_offset);
-          nodes_to_visit.emplace(node.right_bvh_offset());
+        }
+      } else {
+        // Add children, the left one is visited first
+        assert(node.right_bvh_offset() < bvh.size());
+        auto children_hit = kernels.ray_nodes(
+          r, &bvh[node.left_bvh_offset], 2, t_min, closest_so_far);
+        counters.aabb_tests += 2;
+        if (children_hit & 2u) {
+          nodes_to_visit.emplace_back(node.right_bvh_offset());
+        }
+        if (children_hit & 1u) {
+          nodes_to_visit.emplace_back(node.left_bvh_offset);
         }
       }
-
-      nodes_to_visit.pop();
     }
     return hit_anything;
   }
 }
 
-inline bool
-ray_triangle_intersect(const Ray& r,
-                       const vec3& v0,
-                       const vec3& v1,
-                       const vec3& v2,
-                       float& t,
-                       vec3& barycentric_coordinates)
+bool
+TriangleMesh::hit_primitive(const Ray& r,
+                            uint32_t primitive,
+                            [[maybe_unused]] float t_min,
+                            float t_max) const
 {
-  vec3 v0v1 = v1 - v0;
-  vec3 v0v2 = v2 - v0;
-  vec3 ray_edge_cross = cross(r.direction, v0v2);
-  auto det = dot(v0v1, ray_edge_cross);
-  if (std::abs(det) < std::numeric_limits<float>::epsilon()) {
-    // This ray is parallel to this triangle.
-    return false;
-  }
-  auto det_inv = 1.0f / det;
-  auto v0ro = r.origin - v0;
-  auto u = det_inv * dot(v0ro, ray_edge_cross);
-  if (u < 0.0f || u > 1.0f) {
+  // Primitives index the triangles in the order hit traverses them
+  auto& index_buffer = bvh.empty() ? indices : bvh_optimized_indices;
+  if (primitive >= index_buffer.size() / 3) {
     return false;
   }
-  auto q = cross(v0ro, v0v1);
-  auto v = det_inv * dot(r.direction, q);
-  if (v < 0.0f || u + v > 1.0f) {
-    return false;
-  }
-  // At this stage we can compute t to find out where the intersection point
-  // is on the line.
-  t = det_inv * dot(v0v2, q);
-
-  if (t > std::numeric_limits<float>::epsilon() &&
-      t < std::numeric_limits<float>::infinity()) {
-    barycentric_coordinates.e[0] = u;
-    barycentric_coordinates.e[1] = v;
-    barycentric_coordinates.e[2] = 1 - u - v;
-    return true;
-  }
-  return false;
+  Kernels::TriangleHit hit;
+  Counters::local().triangle_tests++;
+  return Kernels::get().ray_triangles(
+    r, positions.data(), &index_buffer[primitive * 3], 1, true, t_max, hit);
 }
 
 bool
@@ -144,59 +133,59 @@ TriangleMesh::ray_triangles_intersect(const Ray& r,
                                       float t_max,
                                       hit_record& rec) const
 {
-  bool hit_anything = false;
-  double closest_so_far = t_max;
-  for (uint32_t i = 0; i < index_count / 3; ++i) {
-    auto& i0 = index_buffer[i * 3];
-    auto& i1 = index_buffer[i * 3 + 1];
-    auto& i2 = index_buffer[i * 3 + 2];
-    const auto& v0 = positions[i0];
-    const auto& v1 = positions[i1];
-    const auto& v2 = positions[i2];
-
-    float t;
-    vec3 barycentric_coordinates;
-    if (!ray_triangle_intersect(r, v0, v1, v2, t, barycentric_coordinates)) {
-      continue;
-    }
-
-    auto& uv0 = vertex_data[i0].uv;
-    auto& uv1 = vertex_data[i1].uv;
-    auto& uv2 = vertex_data[i2].uv;
-
-    auto& normal0 = vertex_data[i0].normal;
-    auto& normal1 = vertex_data[i1].normal;
-    auto& normal2 = vertex_data[i2].normal;
-
-    vec2 uv0uv1 = uv1 - uv0;
-    vec2 uv0uv2 = uv2 - uv0;
-
-    if (closest_so_far > t) {
-      rec.t = t;
-      rec.p = r.origin + r.direction * t;
-      rec.normal = normal0 * barycentric_coordinates.e[2] +
-                   normal1 * barycentric_coordinates.e[0] +
-                   normal2 * barycentric_coordinates.e[1];
-      rec.normal.make_unit_vector();
-      auto denom_inv =
-        1.0f / (uv0uv1.e[0] * uv0uv2.e[1] - uv0uv1.e[1] * uv0uv2.e[0]);
-      vec3 v0v1 = v1 - v0;
-      vec3 v0v2 = v2 - v0;
-      rec.tangent = (v0v1 * uv0uv2.e[1] - v0v2 * uv0uv1.e[1]) * denom_inv;
-      rec.tangent.make_unit_vector();
-      vec2 uv = uv0 * barycentric_coordinates.e[2] +
-                uv1 * barycentric_coordinates.e[0] +
-                uv2 * barycentric_coordinates.e[1];
-      rec.uv = vec3(uv.e[0], uv.e[1], 0.0f);
-      rec.mat_id = mat_id;
-      hit_anything = true;
-      closest_so_far = t;
-      if (early_out) {
-        break;
-      }
-    }
+  Kernels::TriangleHit hit;
+  Counters::local().triangle_tests += index_count / 3;
+  if (!Kernels::get().ray_triangles(r,
+                                    positions.data(),
+                                    index_buffer,
+                                    index_count / 3,
+                                    early_out,
+                                    t_max,
+                                    hit)) {
+    return false;
   }
-  return hit_anything;
+
+  auto& i0 = index_buffer[hit.triangle * 3];
+  auto& i1 = index_buffer[hit.triangle * 3 + 1];
+  auto& i2 = index_buffer[hit.triangle * 3 + 2];
+  const auto& v0 = positions[i0];
+  const auto& v1 = positions[i1];
+  const auto& v2 = positions[i2];
+  vec3 barycentric_coordinates(hit.u, hit.v, 1 - hit.u - hit.v);
+
+  auto& uv0 = vertex_data[i0].uv;
+  auto& uv1 = vertex_data[i1].uv;
+  auto& uv2 = vertex_data[i2].uv;
+
+  auto& normal0 = vertex_data[i0].normal;
+  auto& normal1 = vertex_data[i1].normal;
+  auto& normal2 = vertex_data[i2].normal;
+
+  vec2 uv0uv1 = uv1 - uv0;
+  vec2 uv0uv2 = uv2 - uv0;
+
+  rec.t = hit.t;
+  rec.p = r.origin + r.direction * hit.t;
+  rec.normal = normal0 * barycentric_coordinates.e[2] +
+               normal1 * barycentric_coordinates.e[0] +
+               normal2 * barycentric_coordinates.e[1];
+  rec.normal.make_unit_vector();
+  auto denom_inv =
+    1.0f / (uv0uv1.e[0] * uv0uv2.e[1] - uv0uv1.e[1] * uv0uv2.e[0]);
+  vec3 v0v1 = v1 - v0;
+  vec3 v0v2 = v2 - v0;
+  rec.tangent = (v0v1 * uv0uv2.e[1] - v0v2 * uv0uv1.e[1]) * denom_inv;
+  rec.tangent.make_unit_vector();
+  vec2 uv = uv0 * barycentric_coordinates.e[2] +
+            uv1 * barycentric_coordinates.e[0] +
+            uv2 * barycentric_coordinates.e[1];
+  rec.uv = vec3(uv.e[0], uv.e[1], 0.0f);
+  rec.mat_id = mat_id;
+  auto& triangle_indices = bvh.empty() ? indices : bvh_optimized_indices;
+  rec.primitive =
+    static_cast<uint32_t>(index_buffer - triangle_indices.data()) / 3 +
+    hit.triangle;
+  return true;
 }
 
 bool
@@ -344,6 +333,7 @@ split_binned_sah(const std::vector<uint16_t>& indices,
 void
 Raytracer::Hittable::TriangleMesh::build_bvh()
 {
+  auto zone = Profiler::ScopedZone("TriangleMesh::build_bvh");
   bvh_optimized_indices.clear();
   bvh_optimized_indices.reserve(indices.size());
   // TODO: reserve estimated amount of nodes
@@ -459,11 +449,6 @@ TriangleMesh::get_mat_id() const
 std::unique_ptr<Object>
 TriangleMesh::copy() const
 {
-  std::vector<vec3> positions_copy = positions;
-  std::vector<MeshVertexData> vertex_data_copy = vertex_data;
-  std::vector<uint16_t> indices_copy = indices;
-  return std::make_unique<TriangleMesh>(std::move(positions_copy),
-                                        std::move(vertex_data_copy),
-                                        std::move(indices_copy),
-                                        mat_id);
+  // The bvh is copied along, copies can be traced without building it again
+  return std::make_unique<TriangleMesh>(*this);
 }
@@ -32,7 +32,7 @@ Input::~Input()
 }
 
 void
-Input::run(Ui& ui, Scene& scene, std::chrono::microseconds& dt)
+Input::run(Ui& ui, Scene* scene, std::chrono::microseconds& dt)
 {
   SDL_Event event;
 
@@ -115,7 +115,9 @@ Input::run(Ui& ui, Scene& scene, std::chrono::microseconds& dt)
 
   while (SDL_PollEvent(&event)) {
     ui.process_event(event);
-    scene.get_camera().process_event(event, dt);
+    if (scene != nullptr) {
+      scene->get_camera().process_event(event, dt);
+    }
     switch (event.type) {
       case SDL_QUIT:
         quit = true;
@@ -0,0 +1,318 @@
+#include "kernels.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#if !__EMSCRIPTEN__
+#if _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include "aabb.h"
+#include "bvh.h"
+#include "camera.h"
+#include "ray.h"
+
+using Raytracer::Aabb;
+using Raytracer::BvhNode;
+using Raytracer::Camera;
+using Raytracer::Ray;
+using Raytracer::Kernels::Isa;
+using Raytracer::Kernels::Table;
+using Raytracer::Kernels::TriangleHit;
+using Raytracer::Math::vec3;
+
+#if !__EMSCRIPTEN__
+// Defined in src/kernels/simd_kernels.cpp, which is built once per instruction
+// set
+namespace Raytracer::Kernels::sse42 {
+const Table&
+get_table();
+}
+namespace Raytracer::Kernels::avx2 {
+const Table&
+get_table();
+}
+namespace Raytracer::Kernels::avx512 {
+const Table&
+get_table();
+}
+#endif
+
+namespace {
+/// Möller–Trumbore intersection algorithm
+inline bool
+ray_triangle_intersect(const Ray& r,
+                       const vec3& v0,
+                       const vec3& v1,
+                       const vec3& v2,
+                       float& t,
+                       float& u,
+                       float& v)
+{
+  vec3 v0v1 = v1 - v0;
+  vec3 v0v2 = v2 - v0;
+  vec3 ray_edge_cross = cross(r.direction, v0v2);
+  auto det = dot(v0v1, ray_edge_cross);
+  if (std::abs(det) < std::numeric_limits<float>::epsilon()) {
+    // This ray is parallel to this triangle.
+    return false;
+  }
+  auto det_inv = 1.0f / det;
+  auto v0ro = r.origin - v0;
+  u = det_inv * dot(v0ro, ray_edge_cross);
+  if (u < 0.0f || u > 1.0f) {
+    return false;
+  }
+  auto q = cross(v0ro, v0v1);
+  v = det_inv * dot(r.direction, q);
+  if (v < 0.0f || u + v > 1.0f) {
+    return false;
+  }
+  // At this stage we can compute t to find out where the intersection point
+  // is on the line.
+  t = det_inv * dot(v0v2, q);
+
+  return t > std::numeric_limits<float>::epsilon() &&
+         t < std::numeric_limits<float>::infinity();
+}
+
+bool
+ray_triangles(const Ray& r,
+              const vec3* positions,
+              const uint16_t* indices,
+              uint32_t triangle_count,
+              bool early_out,
+              float t_max,
+              TriangleHit& hit)
+{
+  bool hit_anything = false;
+  float closest_so_far = t_max;
+  for (uint32_t i = 0; i < triangle_count; ++i) {
+    float t, u, v;
+    if (!ray_triangle_intersect(r,
+                                positions[indices[i * 3]],
+                                positions[indices[i * 3 + 1]],
+                                positions[indices[i * 3 + 2]],
+                                t,
+                                u,
+                                v) ||
+        t >= closest_so_far) {
+      continue;
+    }
+    hit = TriangleHit{ i, t, u, v };
+    hit_anything = true;
+    closest_so_far = t;
+    if (early_out) {
+      break;
+    }
+  }
+  return hit_anything;
+}
+
+uint32_t
+ray_nodes(const Ray& r,
+          const BvhNode* nodes,
+          uint32_t node_count,
+          float t_min,
+          float t_max)
+{
+  uint32_t result = 0;
+  for (uint32_t i = 0; i < node_count; ++i) {
+    if (Aabb::hit(nodes[i].bounds, r, t_min, t_max)) {
+      result |= 1u << i;
+    }
+  }
+  return result;
+}
+
+void
+camera_rays(const Camera& camera,
+            uint16_t frame_width,
+            uint16_t frame_height,
+            uint16_t x,
+            uint16_t y,
+            uint32_t count,
+            const float* jitter,
+            Ray* rays)
+{
+  for (uint32_t i = 0; i < count; ++i) {
+    float jitter_x = jitter ? jitter[i * 2] : 0.0f;
+    float jitter_y = jitter ? jitter[i * 2 + 1] : 0.0f;
+    rays[i] = camera.get_ray((x + i + jitter_x) / frame_width,
+                             (y + jitter_y) / frame_height);
+  }
+}
+
+const Table scalar_table = {
+  Isa::Scalar, "scalar", 1, &ray_triangles, &ray_nodes, &camera_rays,
+};
+
+#if !__EMSCRIPTEN__
+void
+cpuid(uint32_t leaf, uint32_t sub_leaf, uint32_t (&registers)[4])
+{
+#if _MSC_VER
+  int info[4];
+  __cpuidex(info, static_cast<int>(leaf), static_cast<int>(sub_leaf));
+  for (uint8_t i = 0; i < 4; ++i) {
+    registers[i] = static_cast<uint32_t>(info[i]);
+  }
+#else
+  __cpuid_count(
+    leaf, sub_leaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+/// Register state the operating system saves on context switches
+uint64_t
+xgetbv()
+{
+#if _MSC_VER
+  return _xgetbv(0);
+#else
+  uint32_t eax, edx;
+  __asm__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+#endif
+
+/// Bit field of the supported instruction sets indexed by Isa
+uint32_t
+detect_supported_isas()
+{
+  uint32_t result = 1u << static_cast<uint8_t>(Isa::Scalar);
+#if !__EMSCRIPTEN__
+  uint32_t registers[4];
+  cpuid(0, 0, registers);
+  auto max_leaf = registers[0];
+
+  cpuid(1, 0, registers);
+  auto features_ecx = registers[2];
+  bool sse42 = features_ecx & (1u << 20);
+  bool fma = features_ecx & (1u << 12);
+  bool os_xsave = features_ecx & (1u << 27);
+  bool avx = features_ecx & (1u << 28);
+
+  uint32_t extended_features_ebx = 0;
+  if (max_leaf >= 7) {
+    cpuid(7, 0, registers);
+    extended_features_ebx = registers[1];
+  }
+  bool avx2 = extended_features_ebx & (1u << 5);
+  bool avx512 = (extended_features_ebx & (1u << 16)) && // F
+                (extended_features_ebx & (1u << 17)) && // DQ
+                (extended_features_ebx & (1u << 28)) && // CD
+                (extended_features_ebx & (1u << 30)) && // BW
+                (extended_features_ebx & (1u << 31));   // VL
+
+  // The cpu supporting an extension is not enough, the operating system must
+  // also save the wider registers
+  uint64_t register_state = os_xsave ? xgetbv() : 0;
+  bool ymm_state = (register_state & 0x06) == 0x06;
+  bool zmm_state = (register_state & 0xE6) == 0xE6;
+
+  if (sse42) {
+    result |= 1u << static_cast<uint8_t>(Isa::Sse42);
+  }
+  if (sse42 && avx && avx2 && fma && ymm_state) {
+    result |= 1u << static_cast<uint8_t>(Isa::Avx2);
+    if (avx512 && zmm_state) {
+      result |= 1u << static_cast<uint8_t>(Isa::Avx512);
+    }
+  }
+#endif
+  return result;
+}
+
+const Table&
+get_table(Isa isa)
+{
+#if !__EMSCRIPTEN__
+  if (isa == Isa::Avx512) {
+    return Raytracer::Kernels::avx512::get_table();
+  }
+  if (isa == Isa::Avx2) {
+    return Raytracer::Kernels::avx2::get_table();
+  }
+  if (isa == Isa::Sse42) {
+    return Raytracer::Kernels::sse42::get_table();
+  }
+#endif
+  return scalar_table;
+}
+
+const Table&
+get_default_table()
+{
+  constexpr Isa isas[] = { Isa::Avx512, Isa::Avx2, Isa::Sse42, Isa::Scalar };
+  Isa best = Isa::Scalar;
+  for (auto isa : isas) {
+    if (Raytracer::Kernels::is_supported(isa)) {
+      best = isa;
+      break;
+    }
+  }
+
+  auto requested = std::getenv("RAYTRACER_ISA");
+  if (requested == nullptr) {
+    return get_table(best);
+  }
+  for (auto isa : isas) {
+    auto& table = get_table(isa);
+    if (table.isa != isa || std::strcmp(requested, table.name) != 0) {
+      continue;
+    }
+    if (!Raytracer::Kernels::is_supported(isa)) {
+      std::cerr << "Warn: RAYTRACER_ISA=" << requested
+                << " is not supported by this cpu, using "
+                << get_table(best).name << "." << std::endl;
+      return get_table(best);
+    }
+    return get_table(isa);
+  }
+  std::cerr << "Warn: Unknown RAYTRACER_ISA=" << requested << ", using "
+            << get_table(best).name << "." << std::endl;
+  return get_table(best);
+}
+
+std::atomic<const Table*> current_table{ nullptr };
+} // namespace
+
+bool
+Raytracer::Kernels::is_supported(Isa isa)
+{
+  static const uint32_t supported_isas = detect_supported_isas();
+  return supported_isas & (1u << static_cast<uint8_t>(isa));
+}
+
+const Table&
+Raytracer::Kernels::get()
+{
+  auto table = current_table.load(std::memory_order_acquire);
+  if (table == nullptr) {
+    static const Table& default_table = get_default_table();
+    // Keep the table of a concurrent select
+    if (current_table.compare_exchange_strong(table, &default_table)) {
+      table = &default_table;
+    }
+  }
+  return *table;
+}
+
+bool
+Raytracer::Kernels::select(Isa isa)
+{
+  if (!is_supported(isa)) {
+    return false;
+  }
+  current_table.store(&get_table(isa), std::memory_order_release);
+  return true;
+}
@@ -0,0 +1,318 @@
+#include "kernels.h"
+
+#include <cassert>
+#include <cfloat>
+
+#include "aabb_simd.h"
+#include "bvh.h"
+#include "camera.h"
+#include "ray.h"
+
+// This file is compiled once per instruction set, see CMakeLists.txt. Apart
+// from the simd types, which are kept apart by their inline namespace, it must
+// not call inline functions shared with the rest of the library: their copy
+// built here could be picked by the linker and run on a cpu without the
+// instructions they were built with.
+
+using Raytracer::AabbSimd;
+using Raytracer::BvhNode;
+using Raytracer::Camera;
+using Raytracer::Ray;
+using Raytracer::Kernels::Isa;
+using Raytracer::Kernels::Table;
+using Raytracer::Kernels::TriangleHit;
+using Raytracer::Math::float_simd_t;
+using Raytracer::Math::vec3;
+using Raytracer::Math::vec3_simd;
+
+namespace {
+#if __AVX512F__
+constexpr Isa isa = Isa::Avx512;
+constexpr uint8_t width = 16;
+#elif __AVX2__
+constexpr Isa isa = Isa::Avx2;
+constexpr uint8_t width = 8;
+#else
+constexpr Isa isa = Isa::Sse42;
+constexpr uint8_t width = 4;
+#endif
+constexpr const char* isa_name = RAYTRACER_SIMD_ISA_NAME;
+
+template<uint8_t D>
+inline vec3_simd<D>
+broadcast(const vec3& value)
+{
+  return { float_simd_t<D>(value.e[0]),
+           float_simd_t<D>(value.e[1]),
+           float_simd_t<D>(value.e[2]) };
+}
+
+template<uint8_t D>
+inline vec3_simd<D>
+subtract(const vec3_simd<D>& lhs, const vec3_simd<D>& rhs)
+{
+  return { lhs.e[0] - rhs.e[0], lhs.e[1] - rhs.e[1], lhs.e[2] - rhs.e[2] };
+}
+
+template<uint8_t D>
+inline float_simd_t<D>
+dot(const vec3_simd<D>& lhs, const vec3_simd<D>& rhs)
+{
+  auto result = lhs.e[0] * rhs.e[0];
+  result = lhs.e[1].multiply_add(rhs.e[1], result);
+  return lhs.e[2].multiply_add(rhs.e[2], result);
+}
+
+template<uint8_t D>
+inline vec3_simd<D>
+cross(const vec3_simd<D>& lhs, const vec3_simd<D>& rhs)
+{
+  return { lhs.e[1].multiply_sub(rhs.e[2], lhs.e[2] * rhs.e[1]),
+           lhs.e[2].multiply_sub(rhs.e[0], lhs.e[0] * rhs.e[2]),
+           lhs.e[0].multiply_sub(rhs.e[1], lhs.e[1] * rhs.e[0]) };
+}
+
+/// Bits of the lanes holding one of the remaining items of a list
+template<uint8_t D>
+inline uint32_t
+lane_mask(uint32_t remaining)
+{
+  return remaining < D ? (1u << remaining) - 1u : (1u << D) - 1u;
+}
+
+/// Möller–Trumbore intersection algorithm, D triangles at a time
+template<uint8_t D>
+bool
+ray_triangles(const Ray& r,
+              const vec3* positions,
+              const uint16_t* indices,
+              uint32_t triangle_count,
+              bool early_out,
+              float t_max,
+              TriangleHit& hit)
+{
+  const auto origin = broadcast<D>(r.origin);
+  const auto direction = broadcast<D>(r.direction);
+  const float_simd_t<D> epsilon(FLT_EPSILON);
+  const float_simd_t<D> zero(0.0f);
+  const float_simd_t<D> one(1.0f);
+
+  bool hit_anything = false;
+  float closest_so_far = t_max;
+  for (uint32_t first = 0; first < triangle_count; first += D) {
+    // Transpose the vertices of D triangles into lanes, past the end of the
+    // list the first triangle is repeated and masked out afterwards
+    float vertices[3][3][D];
+    for (uint8_t lane = 0; lane < D; ++lane) {
+      uint32_t triangle = first + lane < triangle_count ? first + lane : first;
+      for (uint8_t vertex = 0; vertex < 3; ++vertex) {
+        const float* position = positions[indices[triangle * 3 + vertex]].e;
+        for (uint8_t axis = 0; axis < 3; ++axis) {
+          vertices[vertex][axis][lane] = position[axis];
+        }
+      }
+    }
+    vec3_simd<D> v0{ float_simd_t<D>(vertices[0][0]),
+                     float_simd_t<D>(vertices[0][1]),
+                     float_simd_t<D>(vertices[0][2]) };
+    vec3_simd<D> v1{ float_simd_t<D>(vertices[1][0]),
+                     float_simd_t<D>(vertices[1][1]),
+                     float_simd_t<D>(vertices[1][2]) };
+    vec3_simd<D> v2{ float_simd_t<D>(vertices[2][0]),
+                     float_simd_t<D>(vertices[2][1]),
+                     float_simd_t<D>(vertices[2][2]) };
+
+    auto v0v1 = subtract(v1, v0);
+    auto v0v2 = subtract(v2, v0);
+    auto ray_edge_cross = cross(direction, v0v2);
+    auto det = dot(v0v1, ray_edge_cross);
+    // Rays parallel to a triangle get an infinite or nan inverse and are
+    // rejected by the comparisons below
+    auto det_inv = one / det;
+    auto v0ro = subtract(origin, v0);
+    auto u = det_inv * dot(v0ro, ray_edge_cross);
+    auto q = cross(v0ro, v0v1);
+    auto v = det_inv * dot(direction, q);
+    auto t = det_inv * dot(v0v2, q);
+
+    auto is_hit = (std::abs(det) >= epsilon) && (u >= zero) && (u <= one) &&
+                  (v >= zero) && (u + v <= one) && (t > epsilon) &&
+                  (t < float_simd_t<D>(closest_so_far));
+    uint32_t lanes = is_hit.bitmask() & lane_mask<D>(triangle_count - first);
+    if (lanes == 0) {
+      continue;
+    }
+
+    float t_lanes[D];
+    float u_lanes[D];
+    float v_lanes[D];
+    t.store(t_lanes);
+    u.store(u_lanes);
+    v.store(v_lanes);
+    for (uint8_t lane = 0; lane < D; ++lane) {
+      if ((lanes & (1u << lane)) && t_lanes[lane] < closest_so_far) {
+        closest_so_far = t_lanes[lane];
+        hit.triangle = first + lane;
+        hit.t = t_lanes[lane];
+        hit.u = u_lanes[lane];
+        hit.v = v_lanes[lane];
+      }
+    }
+    hit_anything = true;
+    if (early_out) {
+      break;
+    }
+  }
+  return hit_anything;
+}
+
+template<uint8_t D>
+uint32_t
+ray_nodes(const Ray& r,
+          const BvhNode* nodes,
+          uint32_t node_count,
+          float t_min,
+          float t_max)
+{
+  assert(node_count <= 32);
+  uint32_t result = 0;
+  for (uint32_t first = 0; first < node_count; first += D) {
+    // Transpose the bounds of D nodes into lanes, past the end of the list the
+    // first node is repeated and masked out afterwards
+    float bounds[2][3][D];
+    for (uint8_t lane = 0; lane < D; ++lane) {
+      uint32_t node = first + lane < node_count ? first + lane : first;
+      for (uint8_t axis = 0; axis < 3; ++axis) {
+        bounds[0][axis][lane] = nodes[node].bounds.min.e[axis];
+        bounds[1][axis][lane] = nodes[node].bounds.max.e[axis];
+      }
+    }
+    AabbSimd<D> box{ vec3_simd<D>(float_simd_t<D>(bounds[0][0]),
+                                  float_simd_t<D>(bounds[0][1]),
+                                  float_simd_t<D>(bounds[0][2])),
+                     vec3_simd<D>(float_simd_t<D>(bounds[1][0]),
+                                  float_simd_t<D>(bounds[1][1]),
+                                  float_simd_t<D>(bounds[1][2])) };
+    auto is_hit = AabbSimd<D>::hit(
+      box, r, float_simd_t<D>(t_min), float_simd_t<D>(t_max));
+    result |= (is_hit.bitmask() & lane_mask<D>(node_count - first)) << first;
+  }
+  return result;
+}
+
+template<uint8_t D>
+void
+camera_rays(const Camera& camera,
+            uint16_t frame_width,
+            uint16_t frame_height,
+            uint16_t x,
+            uint16_t y,
+            uint32_t count,
+            const float* jitter,
+            Ray* rays)
+{
+  const auto corner = subtract(broadcast<D>(camera.lower_left_corner),
+                               broadcast<D>(camera.origin));
+  const auto horizontal = broadcast<D>(camera.horizontal);
+  const auto vertical = broadcast<D>(camera.vertical);
+  const float_simd_t<D> columns_per_frame(static_cast<float>(frame_width));
+  const float_simd_t<D> rows_per_frame(static_cast<float>(frame_height));
+  const float_simd_t<D> one(1.0f);
+
+  for (uint32_t first = 0; first < count; first += D) {
+    // Past the end of the row the first pixel is repeated and not stored
+    float columns[D];
+    float rows[D];
+    for (uint8_t lane = 0; lane < D; ++lane) {
+      uint32_t pixel = first + lane < count ? first + lane : first;
+      columns[lane] = static_cast<float>(x + pixel);
+      rows[lane] = static_cast<float>(y);
+      if (jitter) {
+        columns[lane] += jitter[pixel * 2];
+        rows[lane] += jitter[pixel * 2 + 1];
+      }
+    }
+    auto s = float_simd_t<D>(columns) / columns_per_frame;
+    auto t = float_simd_t<D>(rows) / rows_per_frame;
+
+    vec3_simd<D> direction;
+    for (uint8_t axis = 0; axis < 3; ++axis) {
+      direction.e[axis] = vertical.e[axis].multiply_add(
+        t, horizontal.e[axis].multiply_add(s, corner.e[axis]));
+    }
+    auto k = one / std::sqrt(dot(direction, direction));
+
+    float directions[3][D];
+    for (uint8_t axis = 0; axis < 3; ++axis) {
+      (direction.e[axis] * k).store(directions[axis]);
+    }
+    for (uint32_t lane = 0; lane < D && first + lane < count; ++lane) {
+      auto& ray = rays[first + lane];
+      for (uint8_t axis = 0; axis < 3; ++axis) {
+        ray.origin.e[axis] = camera.origin.e[axis];
+        ray.direction.e[axis] = directions[axis][lane];
+      }
+    }
+  }
+}
+
+/// Short lists such as bvh leaves and node pairs would leave most lanes of a
+/// wide register empty, narrower vectors are cheaper to fill for those
+bool
+ray_triangles_any_count(const Ray& r,
+                        const vec3* positions,
+                        const uint16_t* indices,
+                        uint32_t triangle_count,
+                        bool early_out,
+                        float t_max,
+                        TriangleHit& hit)
+{
+  if (width > 4 && triangle_count <= 4) {
+    return ray_triangles<4>(
+      r, positions, indices, triangle_count, early_out, t_max, hit);
+  }
+  if constexpr (width > 8) {
+    if (triangle_count <= 8) {
+      return ray_triangles<8>(
+        r, positions, indices, triangle_count, early_out, t_max, hit);
+    }
+  }
+  return ray_triangles<width>(
+    r, positions, indices, triangle_count, early_out, t_max, hit);
+}
+
+uint32_t
+ray_nodes_any_count(const Ray& r,
+                    const BvhNode* nodes,
+                    uint32_t node_count,
+                    float t_min,
+                    float t_max)
+{
+  if (width > 4 && node_count <= 4) {
+    return ray_nodes<4>(r, nodes, node_count, t_min, t_max);
+  }
+  if constexpr (width > 8) {
+    if (node_count <= 8) {
+      return ray_nodes<8>(r, nodes, node_count, t_min, t_max);
+    }
+  }
+  return ray_nodes<width>(r, nodes, node_count, t_min, t_max);
+}
+
+const Table table = {
+  isa,
+  isa_name,
+  width,
+  &ray_triangles_any_count,
+  &ray_nodes_any_count,
+  &camera_rays<width>,
+};
+} // namespace
+
+namespace Raytracer::Kernels::RAYTRACER_SIMD_ISA {
+const Table&
+get_table()
+{
+  return table;
+}
+} // namespace Raytracer::Kernels::RAYTRACER_SIMD_ISA
@@ -0,0 +1,86 @@
+#include "light_tree.h"
+
+#include "hittable/point.h"
+#include "materials/material.h"
+#include "profiler.h"
+#include "scene.h"
+
+using Raytracer::LightTree;
+using Raytracer::Hittable::Point;
+
+void
+LightTree::build(const Scene& scene)
+{
+  auto zone = Profiler::ScopedZone("LightTree::build");
+
+  auto& lights = scene.get_lights();
+  auto& materials = scene.get_material_list();
+  nodes.clear();
+  light_indices.clear();
+  light_leaves.resize(lights.size());
+  for (uint32_t i = 0; i < lights.size(); ++i) {
+    // Only point lights are shaded
+    auto point_light = dynamic_cast<const Point*>(lights[i].get());
+    if (point_light == nullptr) {
+      continue;
+    }
+    // Lights with a material out of range are never bounded
+    Material::EmissionFalloff falloff = {
+      std::numeric_limits<float>::infinity(), 0.0f, 0.0f
+    };
+    if (point_light->mat_id < materials.size()) {
+      falloff = materials[point_light->mat_id]->get_emission_falloff();
+    }
+    auto& position = point_light->position;
+    light_leaves[i] = Node{ Aabb{ position, position },
+                            falloff.constant,
+                            falloff.linear,
+                            falloff.quadratic,
+                            0,
+                            1 };
+    light_indices.push_back(i);
+  }
+  if (light_indices.empty()) {
+    return;
+  }
+  nodes.emplace_back();
+  build_node(0, 0, static_cast<uint32_t>(light_indices.size()));
+}
+
+void
+LightTree::build_node(uint32_t node_index, uint32_t first, uint32_t count)
+{
+  Node node = light_leaves[light_indices[first]];
+  for (uint32_t i = first + 1; i < first + count; ++i) {
+    auto& light = light_leaves[light_indices[i]];
+    node.bounds.min = std::min(node.bounds.min, light.bounds.min);
+    node.bounds.max = std::max(node.bounds.max, light.bounds.max);
+    node.constant = std::max(node.constant, light.constant);
+    node.linear = std::max(node.linear, light.linear);
+    node.quadratic = std::max(node.quadratic, light.quadratic);
+  }
+
+  if (count <= max_leaf_size) {
+    node.offset = first;
+    node.light_count = count;
+    nodes[node_index] = node;
+    return;
+  }
+
+  // Split at the median light along the longest axis
+  auto axis = (node.bounds.max - node.bounds.min).major_axis();
+  auto half = count / 2;
+  std::nth_element(light_indices.begin() + first,
+                   light_indices.begin() + first + half,
+                   light_indices.begin() + first + count,
+                   [this, axis](uint32_t a, uint32_t b) {
+                     return light_leaves[a].bounds.min.e[axis] <
+                            light_leaves[b].bounds.min.e[axis];
+                   });
+  node.offset = static_cast<uint32_t>(nodes.size());
+  node.light_count = 0;
+  nodes[node_index] = node;
+  nodes.resize(nodes.size() + 2);
+  build_node(node.offset, first, half);
+  build_node(node.offset + 1, first + half, count - half);
+}
@@ -1,5 +1,7 @@
 #include "materials/emissive.h"
 
+#include <algorithm>
+
 #include "ray.h"
 
 using Raytracer::Ray;
@@ -20,3 +22,11 @@ Emissive::fill_type_data([[maybe_unused]] const Scene& scene,
   payload.type = RayPayload::Type::Emissive;
   payload.emission = albedo;
 }
+
+Emissive::EmissionFalloff
+Emissive::get_emission_falloff() const
+{
+  auto magnitude = std::abs(albedo);
+  auto brightest = std::max({ magnitude.e[0], magnitude.e[1], magnitude.e[2] });
+  return { brightest, 0.0f, 0.0f };
+}
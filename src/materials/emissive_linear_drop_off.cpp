@@ -1,5 +1,7 @@
 #include "materials/emissive_linear_drop_off.h"
 
+#include <algorithm>
+
 #include "ray.h"
 
 using Raytracer::Ray;
@@ -22,3 +24,11 @@ EmissiveLinearDropOff::fill_type_data(
   payload.type = RayPayload::Type::Emissive;
   payload.emission = albedo / payload.distance * drop_off_factor;
 }
+
+EmissiveLinearDropOff::EmissionFalloff
+EmissiveLinearDropOff::get_emission_falloff() const
+{
+  auto magnitude = std::abs(albedo);
+  auto brightest = std::max({ magnitude.e[0], magnitude.e[1], magnitude.e[2] });
+  return { 0.0f, brightest * std::abs(drop_off_factor), 0.0f };
+}
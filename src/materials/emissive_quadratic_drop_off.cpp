@@ -1,4 +1,6 @@
 #include "materials/emissive_quadratic_drop_off.h"
+
+#include <algorithm>
 #include <ray.h>
 
 #include "ray.h"
@@ -24,3 +26,13 @@ EmissiveQuadraticDropOff::fill_type_data(
   payload.emission =
     albedo * 100000000000.f / (payload.distance * payload.distance * drop_off_factor);
 }
+
+EmissiveQuadraticDropOff::EmissionFalloff
+EmissiveQuadraticDropOff::get_emission_falloff() const
+{
+  auto magnitude = std::abs(albedo);
+  auto brightest = std::max({ magnitude.e[0], magnitude.e[1], magnitude.e[2] });
+  return {
+    0.0f, 0.0f, brightest * 100000000000.f / std::abs(drop_off_factor)
+  };
+}
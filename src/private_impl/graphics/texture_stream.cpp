@@ -0,0 +1,110 @@
+#include "texture_stream.h"
+
+#include <cassert>
+#include <cstring>
+
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "texture.h"
+
+using Raytracer::Graphics::Texture;
+using Raytracer::Graphics::TextureStream;
+
+namespace {
+/// Longest wait for the gpu to release a buffer before it is overwritten
+/// regardless, in nanoseconds
+constexpr uint64_t fence_timeout = 1000000000;
+} // namespace
+
+std::unique_ptr<TextureStream>
+TextureStream::create(const Texture& texture, uint32_t size)
+{
+  std::array<uint32_t, buffer_count> buffers = {};
+  glGenBuffers(buffer_count, buffers.data());
+  for (auto buffer : buffers) {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  return std::unique_ptr<TextureStream>(
+    new TextureStream(texture, buffers, size));
+}
+
+TextureStream::TextureStream(
+  const Texture& _texture,
+  const std::array<uint32_t, buffer_count>& _native_buffers,
+  uint32_t _size)
+  : texture(_texture)
+  , native_buffers(_native_buffers)
+  , size(_size)
+  , fences()
+  , next_buffer(0)
+{}
+
+TextureStream::~TextureStream()
+{
+  for (auto fence : fences) {
+    if (fence) {
+      glDeleteSync(fence);
+    }
+  }
+  glDeleteBuffers(buffer_count, native_buffers.data());
+}
+
+void
+TextureStream::set_debug_name([[maybe_unused]] const std::string& name) const
+{
+#if !__EMSCRIPTEN__
+  for (uint8_t i = 0; i < buffer_count; ++i) {
+    glObjectLabel(GL_BUFFER,
+                  native_buffers[i],
+                  -1,
+                  (name + " pixel buffer " + std::to_string(i)).c_str());
+  }
+#endif
+}
+
+void
+TextureStream::upload(const void* data, [[maybe_unused]] uint32_t _size)
+{
+  assert(size == _size);
+  auto& fence = fences[next_buffer];
+  if (fence) {
+    auto status =
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, fence_timeout);
+    if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED) {
+      std::cerr << "Warn: Pixel buffer still in use by the gpu" << std::endl;
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, native_buffers[next_buffer]);
+#if __EMSCRIPTEN__
+  // WebGL can not map buffers
+  glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, data);
+#else
+  // Unsynchronized since the fence already told the gpu is done with it
+  auto mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER,
+                                 0,
+                                 size,
+                                 GL_MAP_WRITE_BIT |
+                                   GL_MAP_INVALIDATE_BUFFER_BIT |
+                                   GL_MAP_UNSYNCHRONIZED_BIT);
+  if (mapped) {
+    std::memcpy(mapped, data, size);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  } else {
+    glBufferSubData(GL_PIXEL_UNPACK_BUFFER, 0, size, data);
+  }
+#endif
+  // With an unpack buffer bound, the data of the texture update is an offset
+  // in it
+  texture.upload(nullptr, size);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  next_buffer = (next_buffer + 1) % buffer_count;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <memory>
+#include <string>
+
+typedef struct __GLsync* GLsync;
+
+namespace Raytracer::Graphics {
+struct Texture;
+
+/// Updates a texture every frame through a ring of pixel unpack buffers. The
+/// texture is updated from a buffer the gpu copies on its own time, and a
+/// fence tells when the buffer can be written again, so uploads neither wait
+/// for the copy nor stall the pipeline.
+struct TextureStream
+{
+  static constexpr uint8_t buffer_count = 2;
+
+  /// Stream of frames of size bytes to texture, which must outlive it
+  static std::unique_ptr<TextureStream> create(const Texture& texture,
+                                               uint32_t size);
+  virtual ~TextureStream();
+
+  void set_debug_name(const std::string& name) const;
+  /// Only waits if the gpu has not copied the frame uploaded buffer_count
+  /// frames ago yet
+  void upload(const void* data, uint32_t size);
+
+private:
+  TextureStream(const Texture& texture,
+                const std::array<uint32_t, buffer_count>& native_buffers,
+                uint32_t size);
+
+  const Texture& texture;
+  const std::array<uint32_t, buffer_count> native_buffers;
+  const uint32_t size;
+  /// Signaled once the gpu has copied each buffer to the texture
+  std::array<GLsync, buffer_count> fences;
+  uint8_t next_buffer;
+};
+} // namespace Raytracer::Graphics
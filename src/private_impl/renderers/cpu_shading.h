@@ -0,0 +1,33 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "math/vec3.h"
+
+/// Shading shared by the cpu renderers
+namespace Raytracer::Graphics {
+/// Gamma corrected color in RGBA8, red in the lowest byte
+inline uint32_t
+pack_rgba8(const Math::vec3& color)
+{
+  uint32_t result = 0xFF000000u;
+  for (uint8_t i = 0; i < 3; ++i) {
+    // Written so NaN becomes black
+    float value = color.e[i] > 0.0f ? std::min(color.e[i], 1.0f) : 0.0f;
+    result |= static_cast<uint32_t>(value * 255.0f + 0.5f) << (i * 8);
+  }
+  return result;
+}
+
+/// Light coming from the sky in a direction, for rays that hit nothing
+inline Math::vec3
+sky(const Math::vec3& direction)
+{
+  Math::vec3 unit_direction = normalize(direction);
+  float t = 0.5f * (unit_direction.y() + 1.0f);
+  static constexpr Math::vec3 top = Math::vec3(0.5f, 0.7f, 1.0f);
+  static constexpr Math::vec3 bot = Math::vec3(1.0f, 1.0f, 1.0f);
+  return lerp(top, bot, t);
+}
+} // namespace Raytracer::Graphics
@@ -0,0 +1,41 @@
+#include "frame_arena.h"
+
+using Raytracer::Graphics::FrameArena;
+
+FrameArena::FrameArena()
+  : storage()
+  , capacity(0)
+  , offset(0)
+{}
+
+FrameArena&
+FrameArena::local()
+{
+  static thread_local FrameArena arena;
+  return arena;
+}
+
+void
+FrameArena::reset()
+{
+  offset = 0;
+}
+
+void
+FrameArena::reserve(size_t size)
+{
+  assert(offset == 0);
+  if (size <= capacity) {
+    return;
+  }
+  constexpr size_t block = sizeof(std::max_align_t);
+  auto blocks = (size + block - 1) / block;
+  storage = std::make_unique<std::max_align_t[]>(blocks);
+  capacity = blocks * block;
+}
+
+size_t
+FrameArena::get_capacity() const
+{
+  return capacity;
+}
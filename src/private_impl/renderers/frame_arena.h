@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <type_traits>
+
+namespace Raytracer::Graphics {
+/// Bump allocator for what a worker thread only needs while tracing, such as
+/// the ray queues of a pixel. Its capacity is reserved from the bounds of the
+/// frame before tracing, allocating only moves an offset and everything is
+/// freed at once, so tracing never touches the heap once the capacity fits.
+class FrameArena
+{
+public:
+  FrameArena();
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  /// Arena of the calling thread
+  static FrameArena& local();
+
+  /// Free everything allocated, called at the start of each frame
+  void reset();
+  /// Make room for at least size bytes of allocations. Nothing may be
+  /// allocated, and only a capacity too small allocates
+  void reserve(size_t size);
+  size_t get_capacity() const;
+
+  /// Storage for count objects of T, which the caller constructs. Bounded by
+  /// the reserved capacity
+  template<typename T>
+  T* allocate(size_t count);
+  /// Bytes allocate may use for count objects of T, padding included
+  template<typename T>
+  static constexpr size_t size_of(size_t count)
+  {
+    return count * sizeof(T) + alignof(T) - 1;
+  }
+
+  /// Frees what was allocated during its lifetime once it ends
+  class Scope
+  {
+  public:
+    explicit Scope(FrameArena& _arena)
+      : arena(_arena)
+      , offset(_arena.offset)
+    {}
+    ~Scope() { arena.offset = offset; }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+  private:
+    FrameArena& arena;
+    size_t offset;
+  };
+
+private:
+  std::unique_ptr<std::max_align_t[]> storage;
+  size_t capacity;
+  size_t offset;
+};
+
+template<typename T>
+T*
+FrameArena::allocate(size_t count)
+{
+  // Nothing is destroyed when the arena is reset
+  static_assert(std::is_trivially_destructible_v<T>);
+  static_assert(alignof(T) <= alignof(std::max_align_t));
+  auto aligned = (offset + alignof(T) - 1) & ~(alignof(T) - 1);
+  assert(aligned + count * sizeof(T) <= capacity);
+  offset = aligned + count * sizeof(T);
+  return reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(storage.get()) +
+                              aligned);
+}
+} // namespace Raytracer::Graphics
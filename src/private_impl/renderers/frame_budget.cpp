@@ -0,0 +1,98 @@
+#include "frame_budget.h"
+
+#include <algorithm>
+#include <cmath>
+
+using Raytracer::Graphics::FrameBudget;
+
+namespace {
+/// Only move part of the way to the estimate each frame, so a single slow
+/// frame does not halve the resolution
+constexpr float smoothing = 0.5f;
+/// Quality below which secondary rays start being cut, in the same units
+constexpr float min_resolution_quality =
+  FrameBudget::min_resolution_scale * FrameBudget::min_resolution_scale;
+} // namespace
+
+FrameBudget::FrameBudget()
+  : policy(Policy::Resolution)
+  , target(std::chrono::microseconds(33333))
+  , quality(1.0f)
+{}
+
+FrameBudget::Policy
+FrameBudget::get_policy() const
+{
+  return policy;
+}
+
+void
+FrameBudget::set_policy(Policy value)
+{
+  policy = value;
+  quality = 1.0f;
+}
+
+std::chrono::microseconds
+FrameBudget::get_target() const
+{
+  return target;
+}
+
+void
+FrameBudget::set_target(std::chrono::microseconds value)
+{
+  target = value;
+}
+
+void
+FrameBudget::update(std::chrono::nanoseconds frame_time, bool camera_moving)
+{
+  if (policy == Policy::Fixed || !camera_moving ||
+      frame_time.count() <= 0) {
+    return;
+  }
+  // Frame time is roughly proportional to the number of rays traced
+  float estimate = quality * std::chrono::duration<float>(target).count() /
+                   std::chrono::duration<float>(frame_time).count();
+  float min_quality = policy == Policy::ResolutionAndSecondaryRays
+                        ? min_resolution_quality * 0.25f
+                        : min_resolution_quality;
+  quality += (estimate - quality) * smoothing;
+  quality = std::clamp(quality, min_quality, 1.0f);
+}
+
+float
+FrameBudget::get_resolution_scale(bool camera_moving) const
+{
+  if (policy == Policy::Fixed || !camera_moving) {
+    return 1.0f;
+  }
+  return std::max(std::sqrt(quality), min_resolution_scale);
+}
+
+uint8_t
+FrameBudget::get_max_secondary_rays(bool camera_moving,
+                                    uint8_t scene_max_secondary_rays) const
+{
+  if (policy != Policy::ResolutionAndSecondaryRays || !camera_moving ||
+      quality >= min_resolution_quality) {
+    return scene_max_secondary_rays;
+  }
+  // The primary ray is always traced
+  auto fraction = quality / min_resolution_quality;
+  auto rays = static_cast<uint8_t>(scene_max_secondary_rays * fraction);
+  return std::max<uint8_t>(rays, 1);
+}
+
+const char*
+FrameBudget::get_policy_name(Policy value)
+{
+  if (value == Policy::Resolution) {
+    return "resolution";
+  }
+  if (value == Policy::ResolutionAndSecondaryRays) {
+    return "resolution and secondary rays";
+  }
+  return "fixed";
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <chrono>
+
+namespace Raytracer::Graphics {
+/// Scales the work of a frame so it takes about a target time while the
+/// camera moves. The controller tracks the fraction of a full quality frame
+/// that fits in the target and spends it on resolution first, then, if the
+/// policy allows, on secondary rays. Still frames always get full quality.
+class FrameBudget
+{
+public:
+  enum class Policy : uint8_t
+  {
+    /// Always render at full quality
+    Fixed,
+    /// Lower the render resolution
+    Resolution,
+    /// Lower the render resolution, then the number of secondary rays
+    ResolutionAndSecondaryRays,
+  };
+
+  /// Lowest scale of the render resolution on each axis
+  static constexpr float min_resolution_scale = 0.25f;
+
+  FrameBudget();
+
+  Policy get_policy() const;
+  void set_policy(Policy value);
+  std::chrono::microseconds get_target() const;
+  void set_target(std::chrono::microseconds value);
+
+  /// Feed the time taken by a frame rendered with the current settings
+  void update(std::chrono::nanoseconds frame_time, bool camera_moving);
+
+  /// Fraction of the display resolution to render at on each axis
+  float get_resolution_scale(bool camera_moving) const;
+  /// Secondary rays allowed per pixel out of the scene's maximum
+  uint8_t get_max_secondary_rays(bool camera_moving,
+                                 uint8_t scene_max_secondary_rays) const;
+
+  static const char* get_policy_name(Policy value);
+
+private:
+  Policy policy;
+  std::chrono::microseconds target;
+  /// Fraction of the cost of a full quality frame while moving
+  float quality;
+};
+} // namespace Raytracer::Graphics
@@ -0,0 +1,163 @@
+#include "frame_presenter.h"
+
+#include <cstdio>
+
+#include <SDL_video.h>
+
+#include <glad/glad.h>
+
+#if __EMSCRIPTEN__
+#include <emscripten/emscripten.h>
+#include <emscripten/html5.h>
+#endif
+
+#include "math/vec4.h"
+#include "pipeline.h"
+#include "profiler.h"
+
+#include "shaders/fullscreen_fs.h"
+#include "shaders/passthrough_flip_y_vs.h"
+
+#include "../graphics/framebuffer.h"
+#include "../graphics/indexed_mesh.h"
+#include "../graphics/texture.h"
+#include "../graphics/texture_stream.h"
+
+using Raytracer::Graphics::FramePresenter;
+using Raytracer::Graphics::Framebuffer;
+using Raytracer::Graphics::IndexedMesh;
+using Raytracer::Graphics::Pipeline;
+using Raytracer::Graphics::PipelineCreateInfo;
+using Raytracer::Graphics::Texture;
+using Raytracer::Graphics::TextureStream;
+using Raytracer::Math::vec4;
+using namespace Raytracer;
+
+namespace {
+void GLAPIENTRY
+MessageCallback([[maybe_unused]] GLenum source,
+                GLenum type,
+                [[maybe_unused]] GLuint id,
+                GLenum severity,
+                [[maybe_unused]] GLsizei length,
+                const GLchar* message,
+                [[maybe_unused]] const void* userParam)
+{
+  fprintf(stderr,
+          "GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
+          (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""),
+          type,
+          severity,
+          message);
+}
+} // namespace
+
+FramePresenter::FramePresenter(SDL_Window* window)
+  : context(nullptr)
+  , width(0)
+  , height(0)
+  , backbuffer()
+  , gpu_buffer()
+  , gpu_buffer_stream()
+  , screen_space_pipeline()
+  , fullscreen_quad()
+{
+  if (window == nullptr) {
+    return;
+  }
+
+  // Request opengl 3.2 context.
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+#if __EMSCRIPTEN__
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+#else
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+#endif
+
+  // Turn on double buffering with a 24bit Z buffer.
+  SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+  SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+
+  context = SDL_GL_CreateContext(window);
+  if (context) {
+    gladLoadGLES2Loader(SDL_GL_GetProcAddress);
+
+#if !__EMSCRIPTEN__
+    glEnable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback(MessageCallback, this);
+#endif
+    backbuffer = Framebuffer::default_framebuffer();
+    fullscreen_quad = IndexedMesh::create_fullscreen_quad();
+
+    PipelineCreateInfo info;
+    info.vertex_shader_binary = passthrough_flip_y_vs;
+    info.vertex_shader_size =
+      sizeof(passthrough_flip_y_vs) / sizeof(passthrough_flip_y_vs[0]);
+    info.vertex_shader_entry_point = "main";
+    info.fragment_shader_binary = fullscreen_fs;
+    info.fragment_shader_size =
+      sizeof(fullscreen_fs) / sizeof(fullscreen_fs[0]);
+    info.fragment_shader_entry_point = "main";
+    screen_space_pipeline =
+      Pipeline::create(Pipeline::Type::RasterOpenGL, info);
+  }
+}
+
+FramePresenter::~FramePresenter()
+{
+  // GL objects go before their context
+  fullscreen_quad.reset();
+  screen_space_pipeline.reset();
+  gpu_buffer_stream.reset();
+  gpu_buffer.reset();
+  backbuffer.reset();
+  if (context) {
+    SDL_GL_DeleteContext(context);
+  }
+}
+
+void
+FramePresenter::resize(uint16_t w, uint16_t h)
+{
+  width = w;
+  height = h;
+  if (context) {
+    // The stream refers to the texture
+    gpu_buffer_stream.reset();
+    gpu_buffer = Texture::create(
+      width, height, Texture::MipMapFilter::linear, Texture::Format::rgba8f);
+    gpu_buffer->set_debug_name("CPU-GPU buffer");
+    gpu_buffer_stream = TextureStream::create(
+      *gpu_buffer, static_cast<uint32_t>(width * height * sizeof(uint32_t)));
+    gpu_buffer_stream->set_debug_name("CPU-GPU buffer");
+
+    glViewport(0, 0, width, height);
+  }
+}
+
+void
+FramePresenter::present(const std::vector<uint32_t>& pixels, bool upload)
+{
+  static const vec4 clear_color = { 1.0f, 1.0f, 0.0f, 1.0f };
+
+  if (!context) {
+    return;
+  }
+  auto upload_zone = Profiler::ScopedZone("upload");
+  // A frame finished before the backbuffer was resized is dropped
+  if (upload && gpu_buffer_stream && !pixels.empty() &&
+      pixels.size() == static_cast<size_t>(width) * height) {
+    gpu_buffer_stream->upload(
+      pixels.data(), static_cast<uint32_t>(pixels.size() * sizeof(pixels[0])));
+  }
+
+  // clearing screen
+  backbuffer->clear({ clear_color });
+
+  // Actually putting it to the screen?
+  screen_space_pipeline->bind();
+  if (gpu_buffer) {
+    gpu_buffer->bind(0);
+  }
+  fullscreen_quad->draw();
+}
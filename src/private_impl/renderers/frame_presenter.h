@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <memory>
+#include <vector>
+
+struct SDL_Window;
+typedef void* SDL_GLContext;
+
+namespace Raytracer::Graphics {
+class Pipeline;
+struct IndexedMesh;
+struct Texture;
+struct TextureStream;
+struct Framebuffer;
+
+/// Shows the frames of the cpu renderers in their window. It owns the GL
+/// context of the window, streams each frame to a texture and draws it over
+/// the whole backbuffer. Frames are gamma corrected RGBA8 with red in the
+/// lowest byte, bottom row first.
+class FramePresenter
+{
+public:
+  /// Without a window there is no GL context and nothing is shown
+  explicit FramePresenter(SDL_Window* window);
+  ~FramePresenter();
+
+  /// Recreate the texture frames are streamed to, at the backbuffer size
+  void resize(uint16_t width, uint16_t height);
+  /// Draw the last frame streamed, after streaming pixels if upload is set. A
+  /// frame of another size than the backbuffer's is dropped
+  void present(const std::vector<uint32_t>& pixels, bool upload);
+
+private:
+  SDL_GLContext context;
+  uint16_t width;
+  uint16_t height;
+  std::unique_ptr<Framebuffer> backbuffer;
+  std::unique_ptr<Texture> gpu_buffer;
+  std::unique_ptr<TextureStream> gpu_buffer_stream;
+  std::unique_ptr<Pipeline> screen_space_pipeline;
+  std::unique_ptr<IndexedMesh> fullscreen_quad;
+};
+} // namespace Raytracer::Graphics
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <glad/glad.h>
 
+#include "math/mat3x4.h"
 #include "math/vec2.h"
 #include "math/vec3.h"
 #include "math/vec4.h"
@@ -14,6 +15,7 @@
 #include "../graphics/scoped_debug_group.h"
 #include "../graphics/texture.h"
 #include "camera.h"
+#include "hittable/instance.h"
 #include "hittable/plane.h"
 #include "hittable/point.h"
 #include "hittable/sphere.h"
@@ -23,6 +25,7 @@
 #include "materials/lambert.h"
 #include "materials/metal.h"
 #include "pipeline.h"
+#include "profiler.h"
 #include "scene.h"
 
 #include "../../shaders/bridging_header.h"
@@ -136,6 +139,7 @@ RendererGpu::encode_raygen()
 {
   constexpr vec4 clear_color = { 0.0f, 0.0f, 0.0f, 0.0f };
   auto debug_group = ScopedDebugGroup("raygen");
+  auto zone = Profiler::ScopedZone("raygen");
   for (auto& framebuffer : raygen_framebuffer) {
     framebuffer->clear({ clear_color,
                          clear_color,
@@ -158,6 +162,7 @@ RendererGpu::encode_scene_traversal(Texture& ray_direction, bool shadow_ray)
 {
   constexpr vec4 clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
   auto debug_group = ScopedDebugGroup("scene traversal");
+  auto zone = Profiler::ScopedZone("scene traversal");
   // set t_max to float max
   static const vec4 previous_hit_record_clear = {
     std::numeric_limits<float>::max(), 0.0f, 0.0f, 1.0f
@@ -202,6 +207,7 @@ RendererGpu::encode_scene_traversal(Texture& ray_direction, bool shadow_ray)
 
   for (uint8_t i = 0; i < primitives_t::count; ++i) {
     auto primitive_debug_group = ScopedDebugGroup(debug_strs[i]);
+    auto primitive_zone = Profiler::ScopedZone(debug_strs[i].data());
     pipelines[i]->bind();
     {
       GLint st_ray_direction = glGetUniformLocation(
@@ -319,6 +325,7 @@ RendererGpu::encode_any_hit([[maybe_unused]] uint8_t recursion_count)
   };
   for (uint8_t i = 0; i < 2; ++i) {
     auto debug_group = ScopedDebugGroup(debug_strs[i]);
+    auto zone = Profiler::ScopedZone(debug_strs[i].data());
     pipelines[i]->bind();
     {
       GLint ah_hit_record_0 = glGetUniformLocation(
@@ -417,6 +424,7 @@ void
 RendererGpu::encode_shadow_ray_light_hit()
 {
   auto debug_group = ScopedDebugGroup("shadow ray light hit");
+  auto zone = Profiler::ScopedZone("shadow ray light hit");
   shadow_ray_light_hit_pipeline->bind();
   {
     GLint sr_hit_record_5 = glGetUniformLocation(
@@ -474,6 +482,7 @@ RendererGpu::encode_accumulation()
 {
   constexpr vec4 clear_color = { 0.0f, 0.0f, 0.0f, 1.0f };
   auto debug_group = ScopedDebugGroup("accumulation");
+  auto zone = Profiler::ScopedZone("accumulation");
   accumulation_framebuffer[accumulation_framebuffer_active]->clear(
     { clear_color });
   accumulation_pipeline->bind();
@@ -499,6 +508,7 @@ RendererGpu::encode_final_blit()
 {
   constexpr vec4 clear_color = { 1.0f, 1.0f, 0.0f, 1.0f };
   auto debug_group = ScopedDebugGroup("final blit");
+  auto zone = Profiler::ScopedZone("final blit");
   backbuffer->clear({ clear_color });
   final_blit_pipeline->bind();
   accumulation_texture[raygen_framebuffer_active]->bind(
@@ -531,7 +541,8 @@ RendererGpu::upload_raygen_uniforms(const Camera& camera)
 }
 
 void
-RendererGpu::upload_scene(const std::vector<std::unique_ptr<Object>>& objects)
+RendererGpu::upload_scene(
+  const std::vector<std::shared_ptr<const Object>>& objects)
 {
   scene_traversal_sphere_uniform_t spheres;
   spheres.count = 0;
@@ -550,6 +561,17 @@ RendererGpu::upload_scene(const std::vector<std::unique_ptr<Object>>& objects)
     auto sphere = dynamic_cast<const Sphere*>(obj.get());
     auto plane = dynamic_cast<const Plane*>(obj.get());
     auto triangle_mesh = dynamic_cast<const TriangleMesh*>(obj.get());
+    // The shaders have no instancing, transforms are baked in on upload
+    auto instance = dynamic_cast<const Instance*>(obj.get());
+    mat3x4 object_to_world;
+    mat3x4 world_to_object;
+    uint16_t mesh_mat_id = std::numeric_limits<uint16_t>::max();
+    if (instance != nullptr) {
+      triangle_mesh = dynamic_cast<const TriangleMesh*>(instance->blas.get());
+      object_to_world = instance->object_to_world;
+      world_to_object = instance->world_to_object;
+      mesh_mat_id = instance->mat_id;
+    }
     if (sphere != nullptr) {
       assert(spheres.count < MAX_NUM_SPHERES);
       sphere_t shader_sphere;
@@ -582,14 +604,16 @@ RendererGpu::upload_scene(const std::vector<std::unique_ptr<Object>>& objects)
              MAX_NUM_VERTICES);
       assert(bvh_count + triangle_mesh->bvh.size() <= MAX_NUM_BVH_NODES);
       for (uint32_t i = 0; i < triangle_mesh->bvh.size(); ++i) {
+        auto bounds =
+          Aabb::transform(triangle_mesh->bvh[i].bounds, object_to_world);
         // aabb min
-        bvh.p0[bvh_count + i].e[0] = triangle_mesh->bvh[i].bounds.min.e[0];
-        bvh.p0[bvh_count + i].e[1] = triangle_mesh->bvh[i].bounds.min.e[1];
-        bvh.p0[bvh_count + i].e[2] = triangle_mesh->bvh[i].bounds.min.e[2];
+        bvh.p0[bvh_count + i].e[0] = bounds.min.e[0];
+        bvh.p0[bvh_count + i].e[1] = bounds.min.e[1];
+        bvh.p0[bvh_count + i].e[2] = bounds.min.e[2];
         // aabb max
-        bvh.p1[bvh_count + i].e[0] = triangle_mesh->bvh[i].bounds.max.e[0];
-        bvh.p1[bvh_count + i].e[1] = triangle_mesh->bvh[i].bounds.max.e[1];
-        bvh.p1[bvh_count + i].e[2] = triangle_mesh->bvh[i].bounds.max.e[2];
+        bvh.p1[bvh_count + i].e[0] = bounds.max.e[0];
+        bvh.p1[bvh_count + i].e[1] = bounds.max.e[1];
+        bvh.p1[bvh_count + i].e[2] = bounds.max.e[2];
         // offset
         bvh.p0[bvh_count + i].e[3] = triangle_mesh->bvh[i].index_offset;
         // count
@@ -607,32 +631,31 @@ RendererGpu::upload_scene(const std::vector<std::unique_ptr<Object>>& objects)
       }
       index_count += (uint32_t)triangle_mesh->bvh_optimized_indices.size();
       for (uint32_t i = 0; i < triangle_mesh->positions.size(); ++i) {
-        vertices.position[vertex_count + i].e[0] =
-          triangle_mesh->positions[i].e[0];
-        vertices.position[vertex_count + i].e[1] =
-          triangle_mesh->positions[i].e[1];
-        vertices.position[vertex_count + i].e[2] =
-          triangle_mesh->positions[i].e[2];
-        vertices.normal[vertex_count + i][0] =
-          triangle_mesh->vertex_data[i].normal.e[0] * 127;
-        vertices.normal[vertex_count + i][1] =
-          triangle_mesh->vertex_data[i].normal.e[1] * 127;
-        vertices.normal[vertex_count + i][2] =
-          triangle_mesh->vertex_data[i].normal.e[2] * 127;
-        vertices.tangent[vertex_count + i][0] =
-          triangle_mesh->vertex_data[i].tangent.e[0] * 127;
-        vertices.tangent[vertex_count + i][1] =
-          triangle_mesh->vertex_data[i].tangent.e[1] * 127;
-        vertices.tangent[vertex_count + i][2] =
-          triangle_mesh->vertex_data[i].tangent.e[2] * 127;
+        auto position =
+          transform_point(object_to_world, triangle_mesh->positions[i]);
+        auto normal = normalize(transform_normal(
+          world_to_object, triangle_mesh->vertex_data[i].normal));
+        auto tangent = normalize(transform_vector(
+          object_to_world, triangle_mesh->vertex_data[i].tangent));
+        vertices.position[vertex_count + i].e[0] = position.e[0];
+        vertices.position[vertex_count + i].e[1] = position.e[1];
+        vertices.position[vertex_count + i].e[2] = position.e[2];
+        vertices.normal[vertex_count + i][0] = normal.e[0] * 127;
+        vertices.normal[vertex_count + i][1] = normal.e[1] * 127;
+        vertices.normal[vertex_count + i][2] = normal.e[2] * 127;
+        vertices.tangent[vertex_count + i][0] = tangent.e[0] * 127;
+        vertices.tangent[vertex_count + i][1] = tangent.e[1] * 127;
+        vertices.tangent[vertex_count + i][2] = tangent.e[2] * 127;
         vertices.uv[(vertex_count + i) / 2][2 * ((vertex_count + i) % 2)] =
           triangle_mesh->vertex_data[i].uv.e[0] * 127;
         vertices.uv[(vertex_count + i) / 2][2 * ((vertex_count + i) % 2) + 1] =
           triangle_mesh->vertex_data[i].uv.e[1] * 127;
       }
       vertex_count += (uint32_t)triangle_mesh->positions.size();
-      triangles.mat_id =
-        triangle_mesh->mat_id; // TODO: Support material per primitive
+      // TODO: Support material per primitive
+      triangles.mat_id = mesh_mat_id != std::numeric_limits<uint16_t>::max()
+                           ? mesh_mat_id
+                           : triangle_mesh->mat_id;
     }
   }
   scene_traversal_spheres->upload(&spheres, sizeof(spheres));
@@ -800,6 +823,7 @@ RendererGpu::upload_uniforms(const Scene& world)
 void
 RendererGpu::run(const Scene& world)
 {
+  auto zone = Profiler::ScopedZone("RendererGpu::run");
   if (world.get_camera().is_dirty()) {
     frame_count = 0;
   }
@@ -836,9 +860,11 @@ RendererGpu::run(const Scene& world)
 
     {
       auto intersections_debug_group = ScopedDebugGroup("intersections");
+      auto intersections_zone = Profiler::ScopedZone("intersections");
       for (uint8_t j = 0; j < max_recursion_depth; ++j) {
         auto debug_str = (std::string("pass #") + std::to_string(j));
         auto pass_debug_group = ScopedDebugGroup(debug_str.c_str());
+        auto pass_zone = Profiler::ScopedZone("pass");
 
         constexpr vec4 clear_color = { 0.0f, 0.0f, 0.0f, 0.0f };
         raygen_framebuffer[1 - raygen_framebuffer_active]->clear(
@@ -64,13 +64,18 @@ public:
 
   uint8_t get_recursion_depth() const override;
   void set_recursion_depth(uint8_t value) override;
+  uint32_t get_thread_count() const override { return 0; }
+  void set_thread_count(uint32_t) override {}
+  bool get_asynchronous() const override { return false; }
+  void set_asynchronous(bool) override {}
 
   std::vector<std::pair<std::string, float>> evaluate_metrics() override;
   std::vector<std::pair<std::string, uintptr_t>> debug_textures() override;
 
 private:
   void upload_raygen_uniforms(const Camera& camera);
-  void upload_scene(const std::vector<std::unique_ptr<Object>>& objects);
+  void upload_scene(
+    const std::vector<std::shared_ptr<const Object>>& objects);
   void upload_anyhit_uniforms(const Scene& world);
   void upload_uniforms(const Scene& world);
 
@@ -0,0 +1,578 @@
+#include "renderer_path.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "camera.h"
+#include "cpu_shading.h"
+#include "hit_record.h"
+#include "hittable/plane.h"
+#include "hittable/point.h"
+#include "hittable/sphere.h"
+#include "kernels.h"
+#include "materials/material.h"
+#include "math/random.h"
+#include "profiler.h"
+#include "scene.h"
+
+#include "../threading/thread_pool.h"
+#include "../threading/tile_scheduler.h"
+
+using Raytracer::Graphics::FramePresenter;
+using Raytracer::Graphics::RendererPath;
+using Raytracer::Hittable::Plane;
+using Raytracer::Hittable::Point;
+using Raytracer::Hittable::Sphere;
+using Raytracer::Threading::ThreadPool;
+using Raytracer::Threading::Tile;
+using Raytracer::Threading::TileScheduler;
+using namespace Raytracer::Math;
+using namespace Raytracer;
+
+namespace {
+constexpr float t_min = 0.001f;
+constexpr float t_max = std::numeric_limits<float>::max();
+/// Paths are only ended by russian roulette after this many bounces
+constexpr uint8_t roulette_bounces = 3;
+/// Chance of a path going on is capped so bright paths end as well
+constexpr float max_survival = 0.95f;
+
+/// Random numbers drawn at each hit of a path, with the hit's bounce. The
+/// camera ray is jittered by bounce 0
+enum RandomDimension : uint32_t
+{
+  light_choice,
+  light_u,
+  light_v,
+  direction_u,
+  direction_v,
+  fresnel,
+  roulette,
+};
+
+/// Direction around a unit normal, as likely as its cosine with it. The basis
+/// around the normal is the one of Duff et al., Building an Orthonormal Basis,
+/// Revisited
+vec3
+cosine_direction(const vec3& normal, float u, float v)
+{
+  float sign = std::copysign(1.0f, normal.z());
+  float a = -1.0f / (sign + normal.z());
+  float b = normal.x() * normal.y() * a;
+  vec3 tangent(1.0f + sign * normal.x() * normal.x() * a,
+               sign * b,
+               -sign * normal.x());
+  vec3 bitangent(b, sign + normal.y() * normal.y() * a, -normal.y());
+  float radius = std::sqrt(u);
+  float angle = 2.0f * static_cast<float>(M_PI) * v;
+  return tangent * (radius * std::cos(angle)) +
+         bitangent * (radius * std::sin(angle)) +
+         normal * std::sqrt(std::max(1.0f - u, 0.0f));
+}
+
+/// Whether list holds other elements than pointers, which are updated to them
+template<typename T>
+bool
+update_pointers(const std::vector<std::shared_ptr<const T>>& list,
+                std::vector<const T*>& pointers)
+{
+  bool changed = list.size() != pointers.size();
+  pointers.resize(list.size());
+  for (size_t i = 0; i < list.size(); ++i) {
+    changed |= list[i].get() != pointers[i];
+    pointers[i] = list[i].get();
+  }
+  return changed;
+}
+
+} // namespace
+
+RendererPath::RendererPath(SDL_Window* window)
+  : presenter(std::make_unique<FramePresenter>(window))
+  , width(0)
+  , height(0)
+  , max_bounces(8)
+  , samples_per_pixel(1)
+  , accumulated_samples(0)
+  , accumulated_scene(nullptr)
+  , accumulated_geometry_version(0)
+  , accumulated_materials()
+  , accumulated_lights()
+  , thread_pool(std::make_unique<ThreadPool>())
+  , tile_scheduler(std::make_unique<TileScheduler>())
+  , thread_counters()
+  , frame_counters()
+  , frame_time(0)
+  , upload_time(0)
+  , accumulation_buffer()
+  , display_buffer()
+  , frame_camera(nullptr)
+{}
+
+RendererPath::~RendererPath() = default;
+
+bool
+RendererPath::intersect(const Scene& scene,
+                        const Ray& r,
+                        float _t_min,
+                        float _t_max,
+                        hit_record& rec) const
+{
+  auto& object_list = scene.get_world();
+  hit_record temp_rec;
+  bool hit_anything = false;
+  auto closest_so_far = _t_max;
+
+  for (auto& object : object_list) {
+    if (object->hit(r, false, _t_min, closest_so_far, temp_rec) &&
+        closest_so_far > temp_rec.t) {
+      hit_anything = true;
+      closest_so_far = temp_rec.t;
+      rec = temp_rec;
+    }
+  }
+  return hit_anything;
+}
+
+bool
+RendererPath::occluded(const Scene& scene,
+                       const Ray& r,
+                       float _t_min,
+                       float _t_max) const
+{
+  for (auto& object : scene.get_world()) {
+    hit_record rec;
+    if (object->hit(r, true, _t_min, _t_max, rec)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+vec3
+RendererPath::sample_light(const Scene& scene,
+                           const vec3& position,
+                           const vec3& normal,
+                           uint32_t pixel,
+                           uint32_t sample,
+                           uint32_t bounce) const
+{
+  auto& lights = scene.get_lights();
+  if (lights.empty()) {
+    return vec3(0, 0, 0);
+  }
+  auto light_index = std::min(
+    static_cast<size_t>(
+      random_unit_float(pixel, sample, bounce, light_choice) * lights.size()),
+    lights.size() - 1);
+  auto& light = *lights[light_index];
+  if (light.get_mat_id() == std::numeric_limits<uint16_t>::max()) {
+    return vec3(0, 0, 0);
+  }
+  float u = random_unit_float(pixel, sample, bounce, light_u);
+  float v = random_unit_float(pixel, sample, bounce, light_v);
+
+  // Lights with an area emit what a point light of their material would,
+  // spread over their surface, from the side their normal faces. Their
+  // shadows are soft
+  vec3 target;
+  vec3 light_normal;
+  bool area = true;
+  if (auto point = dynamic_cast<const Point*>(&light)) {
+    target = point->position;
+    area = false;
+  } else if (auto plane = dynamic_cast<const Plane*>(&light)) {
+    // The plane spans the two axes its normal is not on, as in Plane::hit
+    uint8_t axis = plane->n.x() != 0.f ? 0 : (plane->n.y() != 0.f ? 1 : 2);
+    target = plane->min;
+    target.e[(axis + 1) % 3] +=
+      (plane->max.e[(axis + 1) % 3] - plane->min.e[(axis + 1) % 3]) * u;
+    target.e[(axis + 2) % 3] +=
+      (plane->max.e[(axis + 2) % 3] - plane->min.e[(axis + 2) % 3]) * v;
+    light_normal = plane->n;
+  } else if (auto sphere = dynamic_cast<const Sphere*>(&light)) {
+    float z = 1.0f - 2.0f * u;
+    float radius = std::sqrt(std::max(1.0f - z * z, 0.0f));
+    float angle = 2.0f * static_cast<float>(M_PI) * v;
+    light_normal =
+      vec3(radius * std::cos(angle), radius * std::sin(angle), z);
+    target = sphere->center + light_normal * std::abs(sphere->radius);
+  } else {
+    // Meshes and other objects cannot be sampled
+    return vec3(0, 0, 0);
+  }
+
+  auto to_light = target - position;
+  float distance = to_light.length();
+  auto direction = to_light / distance;
+  float cosine = dot(normal, direction);
+  float light_cosine = area ? -dot(light_normal, direction) : 1.0f;
+  if (cosine <= 0.0f || light_cosine <= 0.0f) {
+    return vec3(0, 0, 0);
+  }
+
+  auto& counters = Counters::local();
+  counters.shadow_rays++;
+  if (occluded(scene, Ray(position, direction), t_min, distance - t_min)) {
+    return vec3(0, 0, 0);
+  }
+  counters.shading_calls++;
+  RayPayload payload;
+  payload.distance = distance;
+  scene.get_material(light.get_mat_id())
+    .fill_type_data(scene, payload, vec3(0, 0, 0));
+  if (payload.type != RayPayload::Type::Emissive) {
+    return vec3(0, 0, 0);
+  }
+  return payload.emission *
+         (cosine * light_cosine * static_cast<float>(lights.size()));
+}
+
+vec3
+RendererPath::trace_path(const Ray& primary_ray,
+                         const Scene& scene,
+                         uint32_t pixel,
+                         uint32_t sample) const
+{
+  auto& counters = Counters::local();
+  vec3 radiance(0, 0, 0);
+  vec3 throughput(1, 1, 1);
+  Ray ray = primary_ray;
+  // Light hit after a diffuse bounce was already sampled at the bounce
+  bool count_emission = true;
+
+  for (uint32_t bounce = 1; bounce <= max_bounces + 1u; ++bounce) {
+    if (bounce == 1) {
+      counters.primary_rays++;
+    } else {
+      counters.secondary_rays++;
+    }
+    hit_record rec;
+    if (!intersect(scene, ray, t_min, t_max, rec)) {
+      radiance += throughput * sky(ray.direction);
+      break;
+    }
+    counters.shading_calls++;
+    RayPayload payload;
+    payload.distance = rec.t;
+    payload.normal = rec.normal;
+    payload.tangent = rec.tangent;
+    payload.attenuation = vec3(1.f, 1.f, 1.f);
+    payload.mat_id = rec.mat_id;
+    scene.get_material(rec.mat_id).fill_type_data(scene, payload, rec.uv);
+    vec3 position = ray.origin + ray.direction * rec.t;
+
+    if (payload.type == RayPayload::Type::Emissive) {
+      if (count_emission) {
+        radiance += throughput * payload.emission;
+      }
+      break;
+    } else if (payload.type == RayPayload::Type::Lambert) {
+      // Surfaces are shaded on the side the ray hit
+      vec3 normal = dot(payload.normal, ray.direction) > 0.0f
+                      ? -payload.normal
+                      : payload.normal;
+      radiance +=
+        throughput * payload.attenuation *
+        sample_light(scene, position, normal, pixel, sample, bounce);
+      // Cosine weighted directions cancel the cosine and pi of the brdf
+      ray = Ray(position + normal * t_min,
+                cosine_direction(
+                  normal,
+                  random_unit_float(pixel, sample, bounce, direction_u),
+                  random_unit_float(pixel, sample, bounce, direction_v)));
+      throughput *= payload.attenuation;
+      count_emission = false;
+    } else if (payload.type == RayPayload::Type::Metal) {
+      vec3 normal = dot(payload.normal, ray.direction) > 0.0f
+                      ? -payload.normal
+                      : payload.normal;
+      ray = Ray(position + normal * t_min, reflect(ray.direction, normal));
+      throughput *= payload.attenuation;
+      count_emission = true;
+    } else if (payload.type == RayPayload::Type::Dielectric) {
+      // Turned to face the ray by refract
+      vec3 normal = payload.normal;
+      vec3 refracted_direction;
+      bool inside_dielectric = false;
+      float reflectance = 1.0f;
+      if (refract(ray.direction,
+                  normal,
+                  payload.dielectric.ni,
+                  payload.dielectric.nt,
+                  refracted_direction,
+                  inside_dielectric)) {
+        reflectance = fresnel_rate(ray.direction,
+                                   payload.normal,
+                                   payload.dielectric.ni,
+                                   payload.dielectric.nt);
+      }
+      // Beer's law, as in the Whitted renderer
+      if (inside_dielectric) {
+        float dist = payload.distance * 15.f;
+        throughput *= vec3(expf(-payload.attenuation.r() * dist),
+                           expf(-payload.attenuation.g() * dist),
+                           expf(-payload.attenuation.b() * dist));
+      }
+      // Either reflect or refract, as likely as the share of each
+      if (random_unit_float(pixel, sample, bounce, fresnel) < reflectance) {
+        ray = Ray(position + normal * t_min, reflect(ray.direction, normal));
+      } else {
+        ray = Ray(position - normal * t_min, refracted_direction);
+      }
+      count_emission = true;
+    } else {
+      break;
+    }
+
+    // Dim paths are likely to end, the ones going on are brightened so the
+    // average stays the same
+    if (bounce >= roulette_bounces) {
+      float survival = std::min(
+        std::max({ throughput.e[0], throughput.e[1], throughput.e[2] }),
+        max_survival);
+      if (random_unit_float(pixel, sample, bounce, roulette) >= survival) {
+        break;
+      }
+      throughput /= survival;
+    }
+  }
+  return radiance;
+}
+
+void
+RendererPath::render_tile(const Scene& scene, const Tile& tile)
+{
+  auto& camera = *frame_camera;
+  auto& kernels = Kernels::get();
+  Ray rays[TileScheduler::tile_size];
+  float jitter[TileScheduler::tile_size * 2];
+
+  for (uint16_t y = tile.y; y < tile.y + tile.height; ++y) {
+    auto first = tile.x + y * width;
+    if (accumulated_samples == 0) {
+      std::fill_n(&accumulation_buffer[first], tile.width, vec3(0, 0, 0));
+    }
+    for (uint8_t i = 0; i < samples_per_pixel; ++i) {
+      // Each sample of a pixel continues the sequence of its past ones, so the
+      // accumulated samples spread evenly over it
+      uint32_t sample = accumulated_samples + i;
+      for (uint16_t x = 0; x < tile.width; ++x) {
+        auto offset = low_discrepancy_sample(first + x, sample, 0, 0);
+        jitter[x * 2] = offset.e[0];
+        jitter[x * 2 + 1] = offset.e[1];
+      }
+      kernels.camera_rays(
+        camera, width, height, tile.x, y, tile.width, jitter, rays);
+      for (uint16_t x = 0; x < tile.width; ++x) {
+        auto color = trace_path(rays[x], scene, first + x, sample);
+        // A single NaN or infinity would stay in the pixel for as long as it
+        // accumulates
+        if (std::isfinite(color.e[0] + color.e[1] + color.e[2])) {
+          accumulation_buffer[first + x] += color;
+        }
+      }
+    }
+  }
+}
+
+void
+RendererPath::resolve(uint32_t thread_index, uint32_t thread_count)
+{
+  float scale = 1.0f / static_cast<float>(accumulated_samples);
+  for (uint32_t y = thread_index; y < height; y += thread_count) {
+    for (uint32_t x = 0; x < width; ++x) {
+      display_buffer[x + y * width] =
+        pack_rgba8(sqrt(accumulation_buffer[x + y * width] * scale));
+    }
+  }
+}
+
+void
+RendererPath::run(const Scene& scene)
+{
+  auto zone = Profiler::ScopedZone("RendererPath::run");
+
+  using clock = std::chrono::steady_clock;
+  auto frame_start = clock::now();
+
+  // Samples only add up while they see the same thing
+  auto& camera = scene.get_camera();
+  auto geometry_version = scene.get_geometry_version();
+  bool materials_changed =
+    update_pointers(scene.get_material_list(), accumulated_materials);
+  bool lights_changed = update_pointers(scene.get_lights(), accumulated_lights);
+  if (camera.is_dirty() || &scene != accumulated_scene ||
+      geometry_version != accumulated_geometry_version || materials_changed ||
+      lights_changed) {
+    accumulated_samples = 0;
+  }
+  accumulated_scene = &scene;
+  accumulated_geometry_version = geometry_version;
+  if (frame_camera) {
+    *frame_camera = camera;
+  } else {
+    frame_camera = std::make_unique<Camera>(camera);
+  }
+
+  auto thread_count = thread_pool->get_thread_count();
+  tile_scheduler->reset(width, height, thread_count);
+  thread_counters.resize(thread_count);
+  thread_pool->run([this, &scene](uint32_t thread_index) {
+    // Drop whatever the thread counted outside of frames
+    Counters::take();
+    Tile tile;
+    while (tile_scheduler->next(thread_index, tile)) {
+      auto tile_zone = Profiler::ScopedZone("render tile");
+      render_tile(scene, tile);
+    }
+    thread_counters[thread_index] = Counters::take();
+  });
+  accumulated_samples += samples_per_pixel;
+
+  thread_pool->run([this, thread_count](uint32_t thread_index) {
+    auto worker_zone = Profiler::ScopedZone("resolve");
+    resolve(thread_index, thread_count);
+  });
+  frame_time = clock::now() - frame_start;
+
+  frame_counters = Counters::Frame();
+  for (auto& counters : thread_counters) {
+    frame_counters += counters;
+  }
+
+  auto upload_start = clock::now();
+  presenter->present(display_buffer, true);
+  upload_time = clock::now() - upload_start;
+}
+
+void
+RendererPath::set_backbuffer_size(uint16_t w, uint16_t h)
+{
+  if (w != width || h != height) {
+    width = w;
+    height = h;
+
+    rebuild_backbuffers();
+  }
+}
+
+uint8_t
+RendererPath::get_recursion_depth() const
+{
+  return max_bounces;
+}
+void
+RendererPath::set_recursion_depth(uint8_t value)
+{
+  if (value != max_bounces) {
+    reset_accumulation();
+  }
+  max_bounces = value;
+}
+
+uint32_t
+RendererPath::get_thread_count() const
+{
+  return thread_pool->get_thread_count();
+}
+void
+RendererPath::set_thread_count(uint32_t value)
+{
+  if (value == 0) {
+    value = std::thread::hardware_concurrency();
+  }
+  if (value != thread_pool->get_thread_count()) {
+    thread_pool = std::make_unique<ThreadPool>(value);
+  }
+}
+
+uint8_t
+RendererPath::get_samples_per_pixel() const
+{
+  return samples_per_pixel;
+}
+void
+RendererPath::set_samples_per_pixel(uint8_t value)
+{
+  samples_per_pixel = value > 0 ? value : 1;
+}
+
+uint32_t
+RendererPath::get_accumulated_samples() const
+{
+  return accumulated_samples;
+}
+
+void
+RendererPath::reset_accumulation()
+{
+  accumulated_samples = 0;
+}
+
+const std::vector<uint32_t>&
+RendererPath::get_frame() const
+{
+  return display_buffer;
+}
+
+std::vector<std::pair<std::string, float>>
+RendererPath::evaluate_metrics()
+{
+  using duration_format = std::chrono::duration<float, std::milli>;
+  using seconds_format = std::chrono::duration<float>;
+
+  auto& kernels = Kernels::get();
+  auto frame_seconds =
+    std::chrono::duration_cast<seconds_format>(frame_time).count();
+  auto frame_samples =
+    static_cast<float>(width) * height * static_cast<float>(samples_per_pixel);
+  std::vector<std::pair<std::string, float>> result = {
+    { std::string("kernels: ") + kernels.name + " (%.0f-wide)",
+      static_cast<float>(kernels.width) },
+    { "threads: %.0f", static_cast<float>(thread_pool->get_thread_count()) },
+    { "samples per second: %.0f",
+      frame_seconds > 0.0f ? frame_samples / frame_seconds : 0.0f },
+    { "accumulated samples: %.0f", static_cast<float>(accumulated_samples) },
+    { "[STAT] mean path length: %.2f",
+      frame_counters.primary_rays > 0
+        ? static_cast<float>(frame_counters.primary_rays +
+                             frame_counters.secondary_rays) /
+            frame_counters.primary_rays
+        : 0.0f },
+  };
+
+  const std::pair<const char*, uint64_t> counters[] = {
+    { "primary rays", frame_counters.primary_rays },
+    { "secondary rays", frame_counters.secondary_rays },
+    { "shadow rays", frame_counters.shadow_rays },
+    { "bvh nodes visited", frame_counters.bvh_nodes },
+    { "aabb tests", frame_counters.aabb_tests },
+    { "triangle tests", frame_counters.triangle_tests },
+    { "sdf march steps", frame_counters.sdf_steps },
+    { "shading calls", frame_counters.shading_calls },
+  };
+  for (auto& [name, count] : counters) {
+    result.emplace_back(std::string("[STAT] ") + name + ": %.0f",
+                        static_cast<float>(count));
+  }
+  result.emplace_back(
+    "[STAT] trace: %.2f ms",
+    std::chrono::duration_cast<duration_format>(frame_time).count());
+  result.emplace_back(
+    "[STAT] upload: %.2f ms",
+    std::chrono::duration_cast<duration_format>(upload_time).count());
+  return result;
+}
+
+void
+RendererPath::rebuild_backbuffers()
+{
+  accumulation_buffer.assign(width * height, vec3(0, 0, 0));
+  display_buffer.assign(width * height, 0xFF000000u);
+  accumulated_samples = 0;
+
+  presenter->resize(width, height);
+}
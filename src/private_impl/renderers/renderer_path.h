@@ -0,0 +1,133 @@
+#pragma once
+
+#include "renderer.h"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "counters.h"
+#include "frame_presenter.h"
+#include "ray.h"
+
+namespace Raytracer {
+class Camera;
+struct hit_record;
+namespace Hittable {
+struct Object;
+} // namespace Hittable
+namespace Materials {
+struct Material;
+} // namespace Materials
+namespace Threading {
+class ThreadPool;
+class TileScheduler;
+struct Tile;
+} // namespace Threading
+namespace Graphics {
+/// Monte Carlo path tracer on the cpu. Each sample follows one path from the
+/// camera, bouncing off diffuse surfaces in a cosine weighted direction and
+/// off metals and dielectrics like the Whitted renderer does. At each diffuse
+/// hit, one light of the scene is sampled and shaded if nothing blocks it,
+/// and paths end by russian roulette once they are long enough. Samples keep
+/// accumulating over the frames for as long as the camera, the scene, its
+/// geometry, materials and lights stay the same.
+class RendererPath : public Renderer
+{
+public:
+  /// Without a window, frames are rendered to get_frame() without any GL
+  explicit RendererPath(SDL_Window* window);
+  ~RendererPath() override;
+
+  void run(const Scene& scene) override;
+  void set_backbuffer_size(uint16_t w, uint16_t h) override;
+  bool get_debug() const override { return false; }
+  void set_debug(bool) override {}
+  void set_debug_data(uint32_t) override {}
+  /// Longest path, in bounces after the camera ray
+  uint8_t get_recursion_depth() const override;
+  void set_recursion_depth(uint8_t value) override;
+  uint32_t get_thread_count() const override;
+  void set_thread_count(uint32_t value) override;
+  bool get_asynchronous() const override { return false; }
+  void set_asynchronous(bool) override {}
+  uint8_t get_samples_per_pixel() const;
+  /// Samples each frame adds to every pixel
+  void set_samples_per_pixel(uint8_t value);
+  /// Samples averaged by each pixel of the last frame
+  uint32_t get_accumulated_samples() const;
+  /// Start accumulating over from the next frame
+  void reset_accumulation();
+  /// Last frame presented at the backbuffer size, gamma corrected RGBA8 with
+  /// red in the lowest byte, bottom row first
+  const std::vector<uint32_t>& get_frame() const;
+
+  std::vector<std::pair<std::string, float>> evaluate_metrics() override;
+  std::vector<std::pair<std::string, uintptr_t>> debug_textures() override
+  {
+    return {};
+  }
+
+  /// Radiance carried by one path through a pixel, sample is the index of the
+  /// path among all the samples accumulated by the pixel
+  vec3 trace_path(const Ray& ray,
+                  const Scene& scene,
+                  uint32_t pixel,
+                  uint32_t sample) const;
+
+private:
+  /// Closest hit of the world
+  bool intersect(const Scene& scene,
+                 const Ray& r,
+                 float t_min,
+                 float t_max,
+                 hit_record& rec) const;
+  /// Whether anything of the world is hit between t_min and t_max
+  bool occluded(const Scene& scene,
+                const Ray& r,
+                float t_min,
+                float t_max) const;
+  /// Light reaching a diffuse hit from one light of the scene picked at
+  /// random, already divided by the probability of picking it
+  vec3 sample_light(const Scene& scene,
+                    const vec3& position,
+                    const vec3& normal,
+                    uint32_t pixel,
+                    uint32_t sample,
+                    uint32_t bounce) const;
+  void render_tile(const Scene& scene, const Threading::Tile& tile);
+  /// Average the samples accumulated so far to the display buffer
+  void resolve(uint32_t thread_index, uint32_t thread_count);
+  void rebuild_backbuffers();
+
+  std::unique_ptr<FramePresenter> presenter;
+  uint16_t width;
+  uint16_t height;
+  uint8_t max_bounces;
+  uint8_t samples_per_pixel;
+  /// Samples accumulated by every pixel before the current frame
+  uint32_t accumulated_samples;
+  /// What the accumulated samples were traced from, a change starts over
+  const Scene* accumulated_scene;
+  uint32_t accumulated_geometry_version;
+  /// Edited materials and lights are replaced, so an edit changes one of the
+  /// pointers
+  std::vector<const Materials::Material*> accumulated_materials;
+  std::vector<const Hittable::Object*> accumulated_lights;
+
+  std::unique_ptr<Threading::ThreadPool> thread_pool;
+  std::unique_ptr<Threading::TileScheduler> tile_scheduler;
+  std::vector<Counters::Frame> thread_counters;
+  Counters::Frame frame_counters;
+  std::chrono::nanoseconds frame_time;
+  /// Time run took to upload and draw the last frame
+  std::chrono::nanoseconds upload_time;
+  /// Sum of the samples of each pixel
+  std::vector<vec3> accumulation_buffer;
+  /// accumulation_buffer as uploaded
+  std::vector<uint32_t> display_buffer;
+  /// Camera of the frame being traced
+  std::unique_ptr<Camera> frame_camera;
+};
+} // namespace Graphics
+} // namespace Raytracer
@@ -1,129 +1,250 @@
 #include "renderer_whitted.h"
 
-#include <thread>
+#include <algorithm>
+#include <new>
 #include <vector>
 
-#include <SDL_video.h>
-
-#include <glad/glad.h>
-
-#if __EMSCRIPTEN__
-#include <emscripten/emscripten.h>
-#include <emscripten/html5.h>
-#endif
-
 #include "camera.h"
+#include "cpu_shading.h"
+#include "frame_arena.h"
 #include "hit_record.h"
 #include "hittable/point.h"
+#include "kernels.h"
 #include "materials/material.h"
-#include "pipeline.h"
+#include "math/random.h"
+#include "profiler.h"
 #include "ray.h"
 #include "scene.h"
 
 #include "../../shaders/bridging_header.h"
-#include "shaders/fullscreen_fs.h"
-#include "shaders/passthrough_flip_y_vs.h"
 
-#include "../graphics/indexed_mesh.h"
-#include "../graphics/texture.h"
-#include "../graphics/framebuffer.h"
+#include "../threading/thread_pool.h"
+#include "../threading/tile_scheduler.h"
+#include "../threading/topology.h"
 
-using Raytracer::Graphics::IndexedMesh;
 using Raytracer::Graphics::RendererWhitted;
-using Raytracer::Graphics::Framebuffer;
+using Raytracer::Graphics::FrameArena;
+using Raytracer::Graphics::FrameBudget;
+using Raytracer::Graphics::FramePresenter;
 using Raytracer::Hittable::Point;
+using Raytracer::Threading::ThreadPool;
+using Raytracer::Threading::Tile;
+using Raytracer::Threading::TileScheduler;
+using Raytracer::Threading::Topology;
 using namespace Raytracer::Math;
 using namespace Raytracer;
 
 namespace {
-void GLAPIENTRY
-MessageCallback([[maybe_unused]] GLenum source,
-                GLenum type,
-                [[maybe_unused]] GLuint id,
-                GLenum severity,
-                [[maybe_unused]] GLsizei length,
-                const GLchar* message,
-                [[maybe_unused]] const void* userParam)
-{
-  fprintf(stderr,
-          "GL CALLBACK: %s type = 0x%x, severity = 0x%x, message = %s\n",
-          (type == GL_DEBUG_TYPE_ERROR ? "** GL ERROR **" : ""),
-          type,
-          severity,
-          message);
+/// Offsets in each 2x2 block of the pixels traced by each refinement pass,
+/// diagonals first so the first two passes already cover every row and column
+constexpr uint8_t refinement_pattern[][2] = {
+  { 0, 0 },
+  { 1, 1 },
+  { 1, 0 },
+  { 0, 1 },
+};
+/// Refinement pass tracing each pixel of a 2x2 block, indexed by y * 2 + x
+constexpr uint8_t refinement_pass_of_pixel[] = { 0, 2, 3, 1 };
+
+/// Color difference with a neighbour above which a pixel is anti-aliased
+constexpr float edge_color_threshold = 0.1f;
+/// Relative difference in depth with a neighbour making a pixel an edge
+constexpr float edge_depth_threshold = 0.05f;
+/// Material of the pixels whose primary ray hit nothing
+constexpr uint16_t no_hit_material = std::numeric_limits<uint16_t>::max();
+
+struct AttenuatedRay
+{
+  Ray ray;
+  vec3 attenuation;
+};
+struct AttenuatedRayMaxed
+{
+  AttenuatedRay ray;
+  uint16_t mat_id;
+  float t_max;
+  uint32_t light;
+};
+
+/// Arena raygen needs for the ray queues of a pixel
+size_t
+raygen_arena_size(uint8_t max_secondary_rays, size_t light_count)
+{
+  return FrameArena::size_of<AttenuatedRay>(max_secondary_rays) +
+         FrameArena::size_of<AttenuatedRayMaxed>(max_secondary_rays *
+                                                 light_count);
+}
+
+/// Whether an edit replaced objects, lights or materials of the scene since
+/// the snapshot was taken. Edits replace what they change, so comparing the
+/// pointers is enough
+bool
+scene_edited(const Scene& snapshot, const Scene& scene)
+{
+  return snapshot.get_geometry_version() != scene.get_geometry_version() ||
+         snapshot.get_world() != scene.get_world() ||
+         snapshot.get_lights() != scene.get_lights() ||
+         snapshot.get_material_list() != scene.get_material_list();
 }
 } // namespace
 
 RendererWhitted::RendererWhitted(SDL_Window* window)
-  : width(0)
+  : presenter(std::make_unique<FramePresenter>(window))
+  , width(0)
   , height(0)
   , debug_bvh(false)
   , debug_bvh_count(100)
-{
-  // Request opengl 3.2 context.
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-#if __EMSCRIPTEN__
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
-#else
-  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
-#endif
-
-  // Turn on double buffering with a 24bit Z buffer.
-  SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-  SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-
-  context = SDL_GL_CreateContext(window);
-  if (context) {
-    gladLoadGLES2Loader(SDL_GL_GetProcAddress);
-
-#if !__EMSCRIPTEN__
-    glEnable(GL_DEBUG_OUTPUT);
-    glDebugMessageCallback(MessageCallback, this);
-#endif
-    backbuffer = Framebuffer::default_framebuffer();
-    create_geometry();
-    create_pipeline();
-  }
-}
+  , samples_per_pixel(1)
+  , frame_budget()
+  , render_width(0)
+  , render_height(0)
+  , secondary_ray_limit(std::numeric_limits<uint8_t>::max())
+  , progressive(true)
+  , refinement_pass(refinement_passes)
+  , restart_refinement(false)
+  , adaptive_anti_aliasing(false)
+  , adaptive_samples(4)
+  , adaptive_sample_budget(0.5f)
+  , adaptive_rays(0)
+  , light_tree()
+  , light_threshold(1e-5f)
+  , reuse_primary_hits(true)
+  , primary_hits_valid(false)
+  , primary_hits_geometry_version(0)
+  , primary_hit_use(PrimaryHitUse::None)
+  , frame_raygen_kernel(
+      &RendererWhitted::raygen_kernel<false, true, PrimaryHitUse::None>)
+  , thread_pool(std::make_unique<ThreadPool>())
+  , tile_scheduler(std::make_unique<TileScheduler>())
+  , node_local_buffers(false)
+  , buffers_released(false)
+  , scene_replicas(false)
+  , node_replicas()
+  , node_scenes()
+  , thread_busy_time()
+  , thread_ray_generation_time()
+  , thread_counters()
+  , frame_time(0)
+  , phase_times()
+  , upload_time(0)
+  , frame_counters()
+  , cpu_buffer()
+  , display_buffer()
+  , render_buffer()
+  , render_target(nullptr)
+  , depth_buffer()
+  , material_buffer()
+  , primary_hits()
+  , thread_edge_pixels()
+  , edge_pixels()
+  , frame_camera(nullptr)
+  , asynchronous(false)
+  , render_thread()
+  , render_mutex()
+  , render_condition()
+  , render_requested(false)
+  , render_thread_stopping(false)
+  , render_scene()
+  , render_camera_moving(false)
+  , camera_moved(false)
+  , frame_cancelled(false)
+  , cancelled_frames(0)
+  , finished_frames()
+  , presented_metrics()
+{}
 
 RendererWhitted::~RendererWhitted()
 {
-  SDL_GL_DeleteContext(context);
+  stop_render_thread();
 }
 
 bool
-RendererWhitted::trace(RayPayload& payload,
-                       const Scene& scene,
-                       const Ray& r,
-                       bool early_out,
-                       float t_min,
-                       float t_max) const
+RendererWhitted::intersect(const Scene& scene,
+                           const Ray& r,
+                           float t_min,
+                           float t_max,
+                           hit_record& rec) const
 {
   auto& object_list = scene.get_world();
-  hit_record rec;
   hit_record temp_rec;
   bool hit_anything = false;
   auto closest_so_far = t_max;
 
   for (auto& object : object_list) {
-    if (object->hit(r, early_out, t_min, closest_so_far, temp_rec) &&
+    if (object->hit(r, false, t_min, closest_so_far, temp_rec) &&
         closest_so_far > temp_rec.t) {
       hit_anything = true;
       closest_so_far = temp_rec.t;
       temp_rec.bvh_hits += rec.bvh_hits;
       rec = temp_rec;
-      if (early_out) {
-        break;
-      }
     } else {
       rec.bvh_hits += temp_rec.bvh_hits;
     }
   }
-  if (hit_anything) {
+  return hit_anything;
+}
+
+bool
+RendererWhitted::occluded(const Scene& scene,
+                          const Ray& r,
+                          float t_min,
+                          float t_max,
+                          uint32_t light) const
+{
+  // Neighbouring pixels of a tile mostly have their shadow rays blocked by the
+  // same primitive. Occluders are kept by index so an edited world only makes
+  // them miss
+  struct Occluder
+  {
+    uint32_t object;
+    uint32_t primitive;
+  };
+  thread_local std::vector<Occluder> last_occluders;
+  if (light >= last_occluders.size()) {
+    last_occluders.resize(light + 1,
+                          { std::numeric_limits<uint32_t>::max(), 0 });
+  }
+  auto& occluder = last_occluders[light];
+  auto& object_list = scene.get_world();
+  // An object tested whole is not tested again if it missed
+  auto tested_object = std::numeric_limits<uint32_t>::max();
+  if (occluder.object < object_list.size()) {
+    if (object_list[occluder.object]->hit_primitive(
+          r, occluder.primitive, t_min, t_max)) {
+      Counters::local().shadow_cache_hits++;
+      return true;
+    }
+    if (occluder.primitive == hit_record::whole_object) {
+      tested_object = occluder.object;
+    }
+  }
+
+  for (uint32_t i = 0; i < object_list.size(); ++i) {
+    hit_record rec;
+    if (i != tested_object && object_list[i]->hit(r, true, t_min, t_max, rec)) {
+      occluder = { i, rec.primitive };
+      return true;
+    }
+  }
+  return false;
+}
+
+template<bool textured>
+void
+RendererWhitted::shade(RayPayload& payload,
+                       const Scene& scene,
+                       const hit_record& rec,
+                       bool hit) const
+{
+  if (hit) {
     payload.distance = rec.t;
     payload.normal = rec.normal;
-    payload.tangent = rec.tangent;
+    if constexpr (textured) {
+      payload.tangent = rec.tangent;
+    }
     payload.attenuation = vec3(1.f, 1.f, 1.f);
+    payload.mat_id = rec.mat_id;
+    Counters::local().shading_calls++;
     auto& mat = scene.get_material(rec.mat_id);
     mat.fill_type_data(scene, payload, rec.uv);
   } else {
@@ -131,34 +252,81 @@ RendererWhitted::trace(RayPayload& payload,
     payload.type = RayPayload::Type::NoHit;
   }
   payload.bvh_hits = rec.bvh_hits;
-  return hit_anything;
 }
 
 uint32_t
-RendererWhitted::raygen(const Ray& primary_ray,
+RendererWhitted::raygen(const Ray& ray,
                         const Scene& scene,
                         bool _debug_bvh,
-                        vec3& color) const
+                        vec3& color,
+                        RayPayload* primary_payload,
+                        PrimaryHit* primary_hit,
+                        bool reuse_primary_hit) const
 {
-  struct AttenuatedRay
-  {
-    Ray ray;
-    vec3 attenuation;
-  };
-  struct AttenuatedRayMaxed
-  {
-    AttenuatedRay ray;
-    uint16_t mat_id;
-    float t_max;
-  };
-  thread_local std::vector<AttenuatedRay> secondary_rays;
-  secondary_rays.resize(scene.max_secondary_rays);
-  thread_local std::vector<AttenuatedRayMaxed> shadow_rays;
-  // TODO: reserve
-  shadow_rays.clear();
+  auto hit_use = primary_hit == nullptr ? PrimaryHitUse::None
+                 : reuse_primary_hit    ? PrimaryHitUse::Reuse
+                                        : PrimaryHitUse::Store;
+  auto kernel =
+    select_raygen_kernel(_debug_bvh, scene.has_textures(), hit_use);
+  return (this->*kernel)(ray, scene, color, primary_payload, primary_hit);
+}
+
+template<bool debug, bool textured>
+RendererWhitted::RaygenKernel
+RendererWhitted::select_raygen_kernel(PrimaryHitUse hit_use)
+{
+  switch (hit_use) {
+    case PrimaryHitUse::Store:
+      return &RendererWhitted::raygen_kernel<debug,
+                                             textured,
+                                             PrimaryHitUse::Store>;
+    case PrimaryHitUse::Reuse:
+      return &RendererWhitted::raygen_kernel<debug,
+                                             textured,
+                                             PrimaryHitUse::Reuse>;
+    case PrimaryHitUse::None:
+    default:
+      return &RendererWhitted::raygen_kernel<debug,
+                                             textured,
+                                             PrimaryHitUse::None>;
+  }
+}
+
+RendererWhitted::RaygenKernel
+RendererWhitted::select_raygen_kernel(bool debug,
+                                      bool textured,
+                                      PrimaryHitUse hit_use)
+{
+  if (debug) {
+    return textured ? select_raygen_kernel<true, true>(hit_use)
+                    : select_raygen_kernel<true, false>(hit_use);
+  }
+  return textured ? select_raygen_kernel<false, true>(hit_use)
+                  : select_raygen_kernel<false, false>(hit_use);
+}
+
+template<bool debug, bool textured, RendererWhitted::PrimaryHitUse hit_use>
+uint32_t
+RendererWhitted::raygen_kernel(const Ray& primary_ray,
+                               const Scene& scene,
+                               vec3& color,
+                               RayPayload* primary_payload,
+                               PrimaryHit* primary_hit) const
+{
+  const uint8_t max_secondary_rays =
+    std::min(scene.max_secondary_rays, secondary_ray_limit);
+  // Every ray of the pixel may have a shadow ray towards each light
+  auto& lights = scene.get_lights();
+  auto& arena = FrameArena::local();
+  arena.reserve(raygen_arena_size(max_secondary_rays, lights.size()));
+  FrameArena::Scope arena_scope(arena);
+  auto secondary_rays = arena.allocate<AttenuatedRay>(max_secondary_rays);
+  auto shadow_rays =
+    arena.allocate<AttenuatedRayMaxed>(max_secondary_rays * lights.size());
+  uint32_t shadow_ray_count = 0;
 
   // Insert primary ray as first in queue
-  secondary_rays[0] = AttenuatedRay{ primary_ray, vec3(1, 1, 1) };
+  new (&secondary_rays[0]) AttenuatedRay{ primary_ray, vec3(1, 1, 1) };
   uint8_t next_secondary = 1;
 
   RayPayload payload;
@@ -166,16 +334,46 @@ RendererWhitted::raygen(const Ray& primary_ray,
   constexpr float t_max = std::numeric_limits<float>::max();
 
   // Primary and Secondary rays
-  for (uint8_t i = 0; i < next_secondary && i < scene.max_secondary_rays; ++i) {
+  for (uint8_t i = 0; i < next_secondary && i < max_secondary_rays; ++i) {
     if (dot(secondary_rays[i].attenuation, secondary_rays[i].attenuation) <
         scene.min_attenuation_magnitude) {
       payload.distance = 1.0f;
       payload.type = RayPayload::Type::NoHit;
+    } else if (hit_use == PrimaryHitUse::Reuse && i == 0) {
+      Counters::local().reused_primary_hits++;
+      hit_record rec;
+      rec.t = primary_hit->distance;
+      rec.normal = primary_hit->normal;
+      if constexpr (textured) {
+        rec.tangent = primary_hit->tangent;
+        rec.uv = primary_hit->uv;
+      }
+      rec.mat_id = primary_hit->mat_id;
+      shade<textured>(payload, scene, rec, rec.mat_id != no_hit_material);
     } else {
-      trace(payload, scene, secondary_rays[i].ray, false, t_min, t_max);
+      auto& counters = Counters::local();
+      if (i == 0) {
+        counters.primary_rays++;
+      } else {
+        counters.secondary_rays++;
+      }
+      hit_record rec;
+      bool hit = intersect(scene, secondary_rays[i].ray, t_min, t_max, rec);
+      shade<textured>(payload, scene, rec, hit);
+      if (hit_use == PrimaryHitUse::Store && i == 0) {
+        *primary_hit = hit ? PrimaryHit{ rec.normal,
+                                         rec.tangent,
+                                         rec.uv,
+                                         rec.t,
+                                         rec.mat_id }
+                           : PrimaryHit{ {}, {}, {}, 0.0f, no_hit_material };
+      }
+    }
+    if (i == 0 && primary_payload) {
+      *primary_payload = payload;
     }
 
-    if (_debug_bvh) {
+    if constexpr (debug) {
       float bvh_debug = payload.bvh_hits / static_cast<float>(debug_bvh_count);
       color = vec3(bvh_debug, bvh_debug, bvh_debug);
       if (payload.bvh_hits > debug_bvh_count * 3) {
@@ -196,31 +394,43 @@ RendererWhitted::raygen(const Ray& primary_ray,
       color = vec3(1, 1, 0);
       return next_secondary;
     } else if (payload.type == RayPayload::Type::Lambert) {
-      // Add ray to shadow rays
-      for (auto& light : scene.get_lights()) {
-        auto point_light = dynamic_cast<const Point*>(light.get());
-        if (point_light == nullptr) {
-          // This is not a point light and is not supported by Whitted
-          // TODO: support textured spot lights, directional lights
-          continue;
-        }
-        vec3 target = point_light->position;
-
-        auto& ray = shadow_rays.emplace_back();
-        ray.ray.ray.direction = target - hit_pos;
-        ray.t_max = (target - hit_pos).length();
-        ray.ray.ray.direction /= ray.t_max;
-        ray.mat_id = point_light->mat_id;
-        ray.ray.ray.origin = hit_pos + ray.ray.ray.direction * t_min;
-        ray.ray.attenuation = secondary_rays[i].attenuation *
-                              payload.attenuation *
-                              dot(payload.normal, ray.ray.ray.direction);
-      }
+      // Add ray to shadow rays of the lights which may light the hit enough
+      auto surface_attenuation =
+        std::abs(secondary_rays[i].attenuation * payload.attenuation);
+      auto weight = std::max({ surface_attenuation.e[0],
+                               surface_attenuation.e[1],
+                               surface_attenuation.e[2] });
+      light_tree.visit_lights(
+        hit_pos, weight, light_threshold, [&](uint32_t light) {
+          // Lights may have been edited since the tree was built
+          if (light >= lights.size()) {
+            return;
+          }
+          auto point_light = dynamic_cast<const Point*>(lights[light].get());
+          if (point_light == nullptr) {
+            // This is not a point light and is not supported by Whitted
+            // TODO: support textured spot lights, directional lights
+            return;
+          }
+          vec3 target = point_light->position;
+
+          auto& ray = *new (&shadow_rays[shadow_ray_count++])
+            AttenuatedRayMaxed;
+          ray.ray.ray.direction = target - hit_pos;
+          ray.t_max = (target - hit_pos).length();
+          ray.ray.ray.direction /= ray.t_max;
+          ray.mat_id = point_light->mat_id;
+          ray.light = light;
+          ray.ray.ray.origin = hit_pos + ray.ray.ray.direction * t_min;
+          ray.ray.attenuation = secondary_rays[i].attenuation *
+                                payload.attenuation *
+                                dot(payload.normal, ray.ray.ray.direction);
+        });
     } else if (payload.type == RayPayload::Type::Metal) {
       // Add ray in secondary ray queue
-      if (next_secondary < scene.max_secondary_rays) {
+      if (next_secondary < max_secondary_rays) {
         // fully reflective per light)
-        auto& ray = secondary_rays[next_secondary];
+        auto& ray = *new (&secondary_rays[next_secondary]) AttenuatedRay;
         ray.ray.origin = hit_pos + payload.normal * 0.001f;
         ray.ray.direction =
           reflect(secondary_rays[i].ray.direction, payload.normal);
@@ -229,10 +439,10 @@ RendererWhitted::raygen(const Ray& primary_ray,
       }
     } else if (payload.type == RayPayload::Type::Dielectric) {
       float fraction_refracted = 0.0f;
-      thread_local vec3 refracted_direction;
+      vec3 refracted_direction;
       bool inside_dielectric = false;
       // Prevent loss of energy
-      if (next_secondary + 2 != scene.max_secondary_rays &&
+      if (next_secondary + 2 != max_secondary_rays &&
           refract(secondary_rays[i].ray.direction,
                   payload.normal,
                   payload.dielectric.ni,
@@ -259,8 +469,8 @@ RendererWhitted::raygen(const Ray& primary_ray,
 
       // Add refraction in secondary ray queue
       if (fraction_refracted > 0.001f &&
-          next_secondary < scene.max_secondary_rays) {
-        auto& new_ray = secondary_rays[next_secondary];
+          next_secondary < max_secondary_rays) {
+        auto& new_ray = *new (&secondary_rays[next_secondary]) AttenuatedRay;
         new_ray.ray.origin = hit_pos - payload.normal * 0.001f;
         new_ray.ray.direction = refracted_direction;
 
@@ -270,8 +480,8 @@ RendererWhitted::raygen(const Ray& primary_ray,
       }
       // Add reflection in secondary ray queue
       if (fraction_refracted < 0.999f &&
-          next_secondary < scene.max_secondary_rays) {
-        auto& new_ray = secondary_rays[next_secondary];
+          next_secondary < max_secondary_rays) {
+        auto& new_ray = *new (&secondary_rays[next_secondary]) AttenuatedRay;
         new_ray.ray.origin = hit_pos + payload.normal * 0.001f;
         new_ray.ray.direction =
           reflect(secondary_rays[i].ray.direction, payload.normal);
@@ -282,11 +492,8 @@ RendererWhitted::raygen(const Ray& primary_ray,
       }
     } else {
       // No hit or hit light, add sky
-      vec3 unit_direction = normalize(secondary_rays[i].ray.direction);
-      float t = 0.5f * (unit_direction.y() + 1.0f);
-      static constexpr vec3 top = vec3(0.5f, 0.7f, 1.0f);
-      static constexpr vec3 bot = vec3(1.0f, 1.0f, 1.0f);
-      color += lerp(top, bot, t) * secondary_rays[i].attenuation;
+      color += sky(secondary_rays[i].ray.direction) *
+               secondary_rays[i].attenuation;
       if (payload.type == RayPayload::Type::Emissive) {
         // Hit a light, this should happen very rarely
         color += secondary_rays[i].attenuation * payload.emission;
@@ -300,87 +507,599 @@ RendererWhitted::raygen(const Ray& primary_ray,
   }
 
   // Shadow Rays
-  for (auto& ray : shadow_rays) {
-    if (!trace(payload, scene, ray.ray.ray, true, t_min, ray.t_max)) {
+  auto& counters = Counters::local();
+  counters.shadow_rays += shadow_ray_count;
+  for (uint32_t i = 0; i < shadow_ray_count; ++i) {
+    auto& ray = shadow_rays[i];
+    if (!occluded(scene, ray.ray.ray, t_min, ray.t_max, ray.light)) {
+      counters.shading_calls++;
       auto& mat = scene.get_material(ray.mat_id);
       vec3 uv;
+      payload.type = RayPayload::Type::NoHit;
       payload.distance = ray.t_max;
       mat.fill_type_data(scene, payload, uv);
       color += payload.emission * ray.ray.attenuation;
     }
   }
 
-  return next_secondary + static_cast<uint32_t>(shadow_rays.size());
+  return next_secondary + shadow_ray_count;
 }
 
 void
-RendererWhitted::compute_primary_rays(const Camera& camera)
+RendererWhitted::build_light_tree(const Scene& scene)
 {
-  for (uint32_t y = 0; y < height; ++y) {
+  light_tree.build(scene);
+}
+
+void
+RendererWhitted::render_tile(const Scene& scene,
+                             const Tile& tile,
+                             uint32_t thread_index)
+{
+  using clock = std::chrono::steady_clock;
+  std::chrono::nanoseconds ray_generation_time(0);
+  auto& camera = *frame_camera;
+  auto& kernels = Kernels::get();
+  Ray rays[TileScheduler::tile_size];
+  vec3 colors[TileScheduler::tile_size];
+  float jitter[TileScheduler::tile_size * 2];
+
+  // Tiles start on even pixels, so the pattern of the refinement pass can be
+  // applied relative to them
+  bool sparse = refinement_pass < refinement_passes;
+  uint16_t first_x = sparse ? refinement_pattern[refinement_pass][0] : 0;
+  uint16_t step = sparse ? 2 : 1;
+
+  // A single sample goes through the corner of its pixel, unless
+  // anti-aliasing may add jittered samples around it, then it is centered
+  bool centered = samples_per_pixel == 1 && adaptive_anti_aliasing;
+  if (centered) {
+    for (auto& offset : jitter) {
+      offset = 0.5f;
+    }
+  }
+
+  for (uint16_t y = tile.y; y < tile.y + tile.height; ++y) {
+    if (sparse && (y & 1u) != refinement_pattern[refinement_pass][1]) {
+      continue;
+    }
+    for (uint16_t x = first_x; x < tile.width; x += step) {
+      colors[x] = vec3(0, 0, 0);
+    }
+    for (uint8_t sample = 0; sample < samples_per_pixel; ++sample) {
+      // Jitter depends only on the pixel and sample so still frames are
+      // stable, and the samples of a pixel spread evenly over it
+      if (samples_per_pixel > 1) {
+        for (uint16_t x = 0; x < tile.width; ++x) {
+          auto offset =
+            low_discrepancy_sample(tile.x + x + y * render_width, sample, 0, 0);
+          jitter[x * 2] = offset.e[0];
+          jitter[x * 2 + 1] = offset.e[1];
+        }
+      }
+      auto ray_generation_start = clock::now();
+      kernels.camera_rays(camera,
+                          render_width,
+                          render_height,
+                          tile.x,
+                          y,
+                          tile.width,
+                          samples_per_pixel > 1 || centered ? jitter
+                                                            : nullptr,
+                          rays);
+      ray_generation_time += clock::now() - ray_generation_start;
+      for (uint16_t x = first_x; x < tile.width; x += step) {
+        auto index = tile.x + x + y * render_width;
+        vec3 color = vec3(0, 0, 0);
+        RayPayload primary;
+        (this->*frame_raygen_kernel)(rays[x],
+                                     scene,
+                                     color,
+                                     &primary,
+                                     primary_hit_use != PrimaryHitUse::None
+                                       ? &primary_hits[index]
+                                       : nullptr);
+        colors[x] += color;
+        if (sample == 0) {
+          depth_buffer[index] = primary.distance;
+          material_buffer[index] = primary.type == RayPayload::Type::NoHit
+                                     ? no_hit_material
+                                     : primary.mat_id;
+        }
+      }
+    }
+    for (uint16_t x = first_x; x < tile.width; x += step) {
+      render_target[tile.x + x + y * render_width] =
+        std::sqrt(colors[x] / static_cast<float>(samples_per_pixel));
+    }
+  }
+  thread_ray_generation_time[thread_index] += ray_generation_time;
+}
+
+void
+RendererWhitted::upsample(uint32_t thread_index, uint32_t thread_count)
+{
+  float scale_x = static_cast<float>(render_width) / width;
+  float scale_y = static_cast<float>(render_height) / height;
+  for (uint32_t y = thread_index; y < height; y += thread_count) {
+    // Sample at pixel centers, clamped to the edges of the render buffer
+    float source_y = std::max((y + 0.5f) * scale_y - 0.5f, 0.0f);
+    auto y0 = std::min(static_cast<uint32_t>(source_y), render_height - 1u);
+    auto y1 = std::min(y0 + 1u, render_height - 1u);
+    float weight_y = std::min(source_y - y0, 1.0f);
     for (uint32_t x = 0; x < width; ++x) {
-      float u = static_cast<float>(x) / width;
-      float v = static_cast<float>(y) / height;
-      rays[x + y * width] = camera.get_ray(u, v);
+      float source_x = std::max((x + 0.5f) * scale_x - 0.5f, 0.0f);
+      auto x0 = std::min(static_cast<uint32_t>(source_x), render_width - 1u);
+      auto x1 = std::min(x0 + 1u, render_width - 1u);
+      float weight_x = std::min(source_x - x0, 1.0f);
+      // lerp weighs its first argument by t
+      auto top = lerp(render_buffer[x1 + y1 * render_width],
+                      render_buffer[x0 + y1 * render_width],
+                      weight_x);
+      auto bottom = lerp(render_buffer[x1 + y0 * render_width],
+                         render_buffer[x0 + y0 * render_width],
+                         weight_x);
+      cpu_buffer[x + y * width] = lerp(top, bottom, weight_y);
     }
   }
 }
 
 void
-RendererWhitted::run(const Scene& scene)
+RendererWhitted::quantize(uint32_t thread_index, uint32_t thread_count)
 {
-  static const vec4 clear_color = { 1.0f, 1.0f, 0.0f, 1.0f };
+  for (uint32_t y = thread_index; y < height; y += thread_count) {
+    for (uint32_t x = 0; x < width; ++x) {
+      display_buffer[x + y * width] = pack_rgba8(cpu_buffer[x + y * width]);
+    }
+  }
+}
 
-  auto& cam = scene.get_camera();
+bool
+RendererWhitted::is_traced(uint16_t x, uint16_t y) const
+{
+  return refinement_pass_of_pixel[(y & 1u) * 2 + (x & 1u)] <= refinement_pass;
+}
 
-  // raytracing
-  if (cam.is_dirty()) {
-    compute_primary_rays(scene.get_camera());
+void
+RendererWhitted::reconstruct(uint32_t thread_index, uint32_t thread_count)
+{
+  for (uint32_t y = thread_index; y < render_height; y += thread_count) {
+    for (uint32_t x = 0; x < render_width; ++x) {
+      if (is_traced(x, y)) {
+        continue;
+      }
+      // Average of the traced pixels around this one, there are always some
+      // since every 2x2 block has at least its first pixel traced
+      vec3 sum = vec3(0, 0, 0);
+      uint8_t count = 0;
+      for (uint32_t ny = y > 0 ? y - 1 : 0;
+           ny <= y + 1 && ny < render_height;
+           ++ny) {
+        for (uint32_t nx = x > 0 ? x - 1 : 0;
+             nx <= x + 1 && nx < render_width;
+             ++nx) {
+          if (is_traced(nx, ny)) {
+            sum += render_target[nx + ny * render_width];
+            count++;
+          }
+        }
+      }
+      if (count > 0) {
+        render_target[x + y * render_width] = sum / static_cast<float>(count);
+      }
+    }
   }
+}
 
-  std::vector<std::thread> threads;
-  uint32_t num_cores = std::thread::hardware_concurrency();
-  auto block_height = height / num_cores;
-  if (height % num_cores) {
-    block_height++;
+float
+RendererWhitted::edge_contrast(uint16_t x, uint16_t y) const
+{
+  const int32_t offsets[][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+  uint32_t index = x + y * render_width;
+  float contrast = 0.0f;
+  bool geometric_edge = false;
+  for (auto& offset : offsets) {
+    int32_t nx = x + offset[0];
+    int32_t ny = y + offset[1];
+    if (nx < 0 || ny < 0 || nx >= render_width || ny >= render_height) {
+      continue;
+    }
+    uint32_t neighbour = nx + ny * render_width;
+    auto depth = depth_buffer[index];
+    auto neighbour_depth = depth_buffer[neighbour];
+    if (material_buffer[neighbour] != material_buffer[index] ||
+        std::abs(neighbour_depth - depth) >
+          edge_depth_threshold * std::max(neighbour_depth, depth)) {
+      geometric_edge = true;
+    }
+    auto difference = abs(render_target[neighbour] - render_target[index]);
+    contrast = std::max(
+      { contrast, difference.e[0], difference.e[1], difference.e[2] });
   }
-  for (uint32_t i = 0; i < num_cores; ++i) {
-    uint32_t offset = i * block_height * width;
-    uint32_t length = block_height * width;
+  return geometric_edge ? 1.0f + contrast : contrast;
+}
 
-    threads.emplace_back([this, offset, length, &scene]() {
-      for (uint32_t i = offset;
-           i < offset + length && static_cast<int>(i) < width * height;
-           ++i) {
-        vec3 color = vec3(0, 0, 0);
-        raygen(rays[i], scene, debug_bvh, color);
-        cpu_buffer[i] = std::sqrt(color);
+void
+RendererWhitted::detect_edges(uint32_t thread_index, uint32_t thread_count)
+{
+  auto& result = thread_edge_pixels[thread_index];
+  result.clear();
+  for (uint32_t y = thread_index; y < render_height; y += thread_count) {
+    for (uint32_t x = 0; x < render_width; ++x) {
+      auto contrast = edge_contrast(x, y);
+      if (contrast > edge_color_threshold) {
+        result.push_back(EdgePixel{ x + y * render_width, contrast });
       }
+    }
+  }
+}
+
+void
+RendererWhitted::select_edge_pixels(uint32_t thread_count)
+{
+  edge_pixels.clear();
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    edge_pixels.insert(edge_pixels.end(),
+                       thread_edge_pixels[i].begin(),
+                       thread_edge_pixels[i].end());
+  }
+  auto extra_samples = adaptive_samples - samples_per_pixel;
+  auto max_pixels = static_cast<size_t>(
+    adaptive_sample_budget * render_width * render_height / extra_samples);
+  if (edge_pixels.size() > max_pixels) {
+    std::nth_element(edge_pixels.begin(),
+                     edge_pixels.begin() + max_pixels,
+                     edge_pixels.end(),
+                     [](const EdgePixel& a, const EdgePixel& b) {
+                       return a.contrast > b.contrast;
+                     });
+    edge_pixels.resize(max_pixels);
+  }
+  adaptive_rays = static_cast<uint32_t>(edge_pixels.size() * extra_samples);
+}
+
+void
+RendererWhitted::anti_alias(const Scene& scene,
+                            uint32_t thread_index,
+                            uint32_t thread_count)
+{
+  auto& camera = *frame_camera;
+  auto& kernels = Kernels::get();
+  for (size_t i = thread_index; i < edge_pixels.size(); i += thread_count) {
+    if (frame_cancelled.load(std::memory_order_relaxed)) {
+      return;
+    }
+    auto index = edge_pixels[i].index;
+    auto x = static_cast<uint16_t>(index % render_width);
+    auto y = static_cast<uint16_t>(index / render_width);
+    // Undo the gamma of the samples already traced
+    vec3 sum = render_target[index] * render_target[index] *
+               static_cast<float>(samples_per_pixel);
+    for (uint8_t sample = samples_per_pixel; sample < adaptive_samples;
+         ++sample) {
+      // Continues the sequence of the samples already traced
+      auto offset = low_discrepancy_sample(index, sample, 0, 0);
+      float jitter[2] = { offset.e[0], offset.e[1] };
+      Ray ray;
+      kernels.camera_rays(
+        camera, render_width, render_height, x, y, 1, jitter, &ray);
+      vec3 color = vec3(0, 0, 0);
+      raygen(ray, scene, false, color);
+      sum += color;
+    }
+    render_target[index] =
+      std::sqrt(sum / static_cast<float>(adaptive_samples));
+  }
+}
+
+void
+RendererWhitted::render_frame(const Scene& scene, bool camera_moving)
+{
+  auto zone = Profiler::ScopedZone("RendererWhitted::render_frame");
+
+  using clock = std::chrono::steady_clock;
+  auto frame_start = clock::now();
+
+  auto previous_width = render_width;
+  auto previous_height = render_height;
+  auto scale = frame_budget.get_resolution_scale(camera_moving);
+  auto scaled = [scale](uint16_t size) {
+    auto result = static_cast<uint16_t>(std::lround(size * scale));
+    return std::min(size, std::max<uint16_t>(result, 1));
+  };
+  render_width = scaled(width);
+  render_height = scaled(height);
+  secondary_ray_limit = frame_budget.get_max_secondary_rays(
+    camera_moving, scene.max_secondary_rays);
+  bool upsampled = render_width != width || render_height != height;
+  auto previous_target = render_target;
+  render_target = upsampled ? render_buffer.data() : cpu_buffer.data();
+
+  // Progressive refinement starts over whenever the pixels traced by previous
+  // passes no longer match the frame
+  if (!progressive) {
+    refinement_pass = refinement_passes;
+  } else if (camera_moving || restart_refinement ||
+             render_target != previous_target ||
+             render_width != previous_width ||
+             render_height != previous_height) {
+    refinement_pass = 0;
+  } else if (refinement_pass < refinement_passes) {
+    refinement_pass++;
+  }
+  restart_refinement = false;
+
+  // Full frames of a single sample keep what their primary rays hit, which the
+  // next ones shade again for as long as nothing it depends on changes
+  auto geometry_version = scene.get_geometry_version();
+  if (!reuse_primary_hits || samples_per_pixel > 1 || debug_bvh ||
+      refinement_pass < refinement_passes) {
+    primary_hit_use = PrimaryHitUse::None;
+  } else if (primary_hits_valid && !camera_moving &&
+             render_target == previous_target &&
+             render_width == previous_width &&
+             render_height == previous_height &&
+             geometry_version == primary_hits_geometry_version) {
+    primary_hit_use = PrimaryHitUse::Reuse;
+  } else {
+    primary_hit_use = PrimaryHitUse::Store;
+  }
+  primary_hits_valid = false;
+  frame_raygen_kernel =
+    select_raygen_kernel(debug_bvh, scene.has_textures(), primary_hit_use);
+
+  // Lights are bounded again every frame since their materials may have been
+  // edited
+  build_light_tree(scene);
+
+  auto phase_start = clock::now();
+  // Each NUMA node traces its own copy of the scene
+  if (scene_replicas && thread_pool->is_pinned() &&
+      Topology::get().get_node_count() > 1) {
+    replicate_scene(scene);
+  } else {
+    node_replicas.clear();
+    node_scenes.clear();
+  }
+  phase_times.scene_replication = clock::now() - phase_start;
+  if (buffers_released) {
+    place_buffers();
+  }
+
+  auto thread_count = thread_pool->get_thread_count();
+  tile_scheduler->reset(render_width, render_height, thread_count);
+  thread_busy_time.resize(thread_count);
+  thread_ray_generation_time.assign(thread_count, std::chrono::nanoseconds(0));
+  thread_counters.resize(thread_count);
+
+  phase_start = clock::now();
+  thread_pool->run([this, &scene](uint32_t thread_index) {
+    // Drop whatever the thread counted outside of frames
+    Counters::take();
+    auto& thread_scene = get_thread_scene(scene, thread_index);
+    std::chrono::nanoseconds busy_time(0);
+    Tile tile;
+    // The ray queues of the frame fit in the arena before tracing starts
+    auto& arena = FrameArena::local();
+    arena.reset();
+    arena.reserve(raygen_arena_size(secondary_ray_limit,
+                                    thread_scene.get_lights().size()));
+    while (!frame_cancelled.load(std::memory_order_relaxed) &&
+           tile_scheduler->next(thread_index, tile)) {
+      auto tile_zone = Profiler::ScopedZone("render tile");
+      auto tile_start = clock::now();
+      render_tile(thread_scene, tile, thread_index);
+      busy_time += clock::now() - tile_start;
+    }
+    thread_busy_time[thread_index] = busy_time;
+    thread_counters[thread_index] = Counters::take();
+  });
+  // Camera rays are computed in between tracing, their share of the wall time
+  // is their share of the time the threads were busy
+  auto tiles_time = clock::now() - phase_start;
+  std::chrono::nanoseconds busy_time(0);
+  std::chrono::nanoseconds ray_generation_time(0);
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    busy_time += thread_busy_time[i];
+    ray_generation_time += thread_ray_generation_time[i];
+  }
+  phase_times.ray_generation =
+    busy_time.count() > 0 ? tiles_time * ray_generation_time.count() /
+                              busy_time.count()
+                          : std::chrono::nanoseconds(0);
+  phase_times.trace = tiles_time - phase_times.ray_generation;
+
+  // What is left of a cancelled frame is never shown
+  if (frame_cancelled.load(std::memory_order_relaxed)) {
+    return;
+  }
+  primary_hits_valid = primary_hit_use != PrimaryHitUse::None;
+  primary_hits_geometry_version = geometry_version;
+
+  // The last pass traces the last missing pixels
+  phase_start = clock::now();
+  if (refinement_pass + 1 < refinement_passes) {
+    thread_pool->run([this, thread_count](uint32_t thread_index) {
+      auto worker_zone = Profiler::ScopedZone("reconstruct");
+      reconstruct(thread_index, thread_count);
+    });
+  }
+  phase_times.reconstruction = clock::now() - phase_start;
+
+  // Only full frames have the depth and material of every pixel
+  phase_start = clock::now();
+  adaptive_rays = 0;
+  if (adaptive_anti_aliasing && !debug_bvh &&
+      adaptive_samples > samples_per_pixel &&
+      refinement_pass == refinement_passes) {
+    thread_edge_pixels.resize(thread_count);
+    thread_pool->run([this, thread_count](uint32_t thread_index) {
+      auto worker_zone = Profiler::ScopedZone("detect edges");
+      detect_edges(thread_index, thread_count);
+    });
+    select_edge_pixels(thread_count);
+    thread_pool->run([this, &scene, thread_count](uint32_t thread_index) {
+      auto worker_zone = Profiler::ScopedZone("anti-alias");
+      anti_alias(
+        get_thread_scene(scene, thread_index), thread_index, thread_count);
+      thread_counters[thread_index] += Counters::take();
     });
   }
+  phase_times.anti_aliasing = clock::now() - phase_start;
+  frame_time = clock::now() - frame_start;
 
-  for (auto& t : threads) {
-    t.join();
+  frame_counters = Counters::Frame();
+  for (auto& counters : thread_counters) {
+    frame_counters += counters;
+  }
+
+  phase_start = clock::now();
+  if (upsampled) {
+    thread_pool->run([this, thread_count](uint32_t thread_index) {
+      auto worker_zone = Profiler::ScopedZone("upsample");
+      upsample(thread_index, thread_count);
+    });
   }
+  phase_times.upsample = clock::now() - phase_start;
+
+  phase_start = clock::now();
+  thread_pool->run([this, thread_count](uint32_t thread_index) {
+    auto worker_zone = Profiler::ScopedZone("quantize");
+    quantize(thread_index, thread_count);
+  });
+  phase_times.quantize = clock::now() - phase_start;
+}
+
+void
+RendererWhitted::present(const std::vector<uint32_t>& pixels, bool upload)
+{
+  using clock = std::chrono::steady_clock;
+  auto upload_start = clock::now();
+  presenter->present(pixels, upload);
+  upload_time = clock::now() - upload_start;
+}
+
+void
+RendererWhitted::run(const Scene& scene)
+{
+  auto zone = Profiler::ScopedZone("RendererWhitted::run");
+
+  using clock = std::chrono::steady_clock;
+  auto& camera = scene.get_camera();
+  bool camera_moving = camera.is_dirty();
 
-  // binding texture
-  if (context) {
-    if (gpu_buffer) {
-      gpu_buffer->upload(
-        cpu_buffer.data(),
-        static_cast<uint32_t>(cpu_buffer.size() * sizeof(cpu_buffer[0])));
+  if (!asynchronous) {
+    auto frame_start = clock::now();
+    if (frame_camera) {
+      *frame_camera = camera;
+    } else {
+      frame_camera = std::make_unique<Camera>(camera);
     }
+    render_frame(scene, camera_moving);
+    present(display_buffer, true);
+    frame_budget.update(clock::now() - frame_start, camera_moving);
+    return;
+  }
 
-    // clearing screen
-    backbuffer->clear({ clear_color });
+  {
+    std::lock_guard<std::mutex> lock(render_mutex);
+    // Frames started while the camera moves are cheap and keep up with it, but
+    // a still frame is out of date as soon as the camera starts moving, and
+    // any frame is as soon as the scene is edited
+    if (render_requested &&
+        ((camera_moving && !render_camera_moving) ||
+         scene_edited(*render_scene, scene))) {
+      frame_cancelled.store(true, std::memory_order_relaxed);
+      render_condition.notify_all();
+    }
+    camera_moved |= camera_moving;
+    if (!render_requested) {
+      if (frame_camera) {
+        *frame_camera = camera;
+      } else {
+        frame_camera = std::make_unique<Camera>(camera);
+      }
+      // The scene is only edited on this thread, so it can be copied as is
+      render_scene = scene.snapshot();
+      render_camera_moving = camera_moved;
+      camera_moved = false;
+      frame_cancelled.store(false, std::memory_order_relaxed);
+      render_requested = true;
+      render_condition.notify_all();
+    }
+  }
+
+  bool finished = finished_frames.update();
+  if (finished) {
+    presented_metrics = finished_frames.front().metrics;
+  }
+  present(finished_frames.front().pixels, finished);
+}
 
-    // Actually putting it to the screen?
-    screen_space_pipeline->bind();
-    if (gpu_buffer) {
-      gpu_buffer->bind(0);
+void
+RendererWhitted::render_loop()
+{
+  Profiler::set_thread_name("render");
+  using clock = std::chrono::steady_clock;
+  std::unique_lock<std::mutex> lock(render_mutex);
+  for (;;) {
+    render_condition.wait(
+      lock, [this] { return render_requested || render_thread_stopping; });
+    if (render_thread_stopping) {
+      return;
     }
-    fullscreen_quad->draw();
+    lock.unlock();
+
+    auto frame_start = clock::now();
+    render_frame(*render_scene, render_camera_moving);
+    if (frame_cancelled.load(std::memory_order_relaxed)) {
+      // The tiles traced are not worth refining
+      restart_refinement = true;
+      cancelled_frames++;
+    } else {
+      frame_budget.update(clock::now() - frame_start, render_camera_moving);
+      auto& frame = finished_frames.back();
+      frame.pixels = display_buffer;
+      frame.metrics = frame_metrics();
+      finished_frames.publish();
+    }
+
+    lock.lock();
+    render_scene.reset();
+    render_requested = false;
+    render_condition.notify_all();
+  }
+}
 
-    glFinish();
+void
+RendererWhitted::stop_render_thread()
+{
+  if (!render_thread.joinable()) {
+    return;
+  }
+  cancel_frame();
+  {
+    std::lock_guard<std::mutex> lock(render_mutex);
+    render_thread_stopping = true;
+  }
+  render_condition.notify_all();
+  render_thread.join();
+  render_thread_stopping = false;
+  // Frames rendered on this thread from now on are never cancelled
+  frame_cancelled.store(false, std::memory_order_relaxed);
+}
+
+void
+RendererWhitted::cancel_frame()
+{
+  if (!render_thread.joinable()) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock(render_mutex);
+  if (render_requested) {
+    frame_cancelled.store(true, std::memory_order_relaxed);
+    render_condition.notify_all();
+    render_condition.wait(lock, [this] { return !render_requested; });
   }
 }
 
@@ -388,6 +1107,7 @@ void
 RendererWhitted::set_backbuffer_size(uint16_t w, uint16_t h)
 {
   if (w != width || h != height) {
+    cancel_frame();
     width = w;
     height = h;
 
@@ -403,18 +1123,371 @@ RendererWhitted::get_debug() const
 void
 RendererWhitted::set_debug(bool value)
 {
+  if (value != debug_bvh) {
+    cancel_frame();
+    restart_refinement = true;
+  }
   debug_bvh = value;
 }
 void
 RendererWhitted::set_debug_data(uint32_t data)
 {
+  if (data != debug_bvh_count) {
+    cancel_frame();
+  }
   debug_bvh_count = data;
 }
 
+uint32_t
+RendererWhitted::get_thread_count() const
+{
+  return thread_pool->get_thread_count();
+}
+void
+RendererWhitted::set_thread_count(uint32_t value)
+{
+  if (value == 0) {
+    value = std::thread::hardware_concurrency();
+  }
+  if (value != thread_pool->get_thread_count()) {
+    cancel_frame();
+    thread_pool = std::make_unique<ThreadPool>(value, thread_pool->is_pinned());
+    // Tiles are dealt to other threads
+    release_buffers();
+  }
+}
+
+bool
+RendererWhitted::get_asynchronous() const
+{
+  return asynchronous;
+}
+void
+RendererWhitted::set_asynchronous(bool value)
+{
+  if (value == asynchronous) {
+    return;
+  }
+  if (value) {
+    render_thread = std::thread(&RendererWhitted::render_loop, this);
+  } else {
+    stop_render_thread();
+  }
+  asynchronous = value;
+}
+
+uint8_t
+RendererWhitted::get_samples_per_pixel() const
+{
+  return samples_per_pixel;
+}
+void
+RendererWhitted::set_samples_per_pixel(uint8_t value)
+{
+  value = value > 0 ? value : 1;
+  if (value != samples_per_pixel) {
+    cancel_frame();
+    restart_refinement = true;
+  }
+  samples_per_pixel = value;
+}
+
+FrameBudget::Policy
+RendererWhitted::get_frame_budget_policy() const
+{
+  return frame_budget.get_policy();
+}
+void
+RendererWhitted::set_frame_budget_policy(FrameBudget::Policy value)
+{
+  if (value != frame_budget.get_policy()) {
+    cancel_frame();
+  }
+  frame_budget.set_policy(value);
+}
+std::chrono::microseconds
+RendererWhitted::get_frame_time_target() const
+{
+  return frame_budget.get_target();
+}
+void
+RendererWhitted::set_frame_time_target(std::chrono::microseconds value)
+{
+  if (value != frame_budget.get_target()) {
+    cancel_frame();
+  }
+  frame_budget.set_target(value);
+}
+
+const std::vector<uint32_t>&
+RendererWhitted::get_frame() const
+{
+  return asynchronous ? finished_frames.front().pixels : display_buffer;
+}
+
+bool
+RendererWhitted::get_progressive() const
+{
+  return progressive;
+}
+
+void
+RendererWhitted::set_progressive(bool value)
+{
+  if (value != progressive) {
+    cancel_frame();
+  }
+  progressive = value;
+}
+
+bool
+RendererWhitted::get_adaptive_anti_aliasing() const
+{
+  return adaptive_anti_aliasing;
+}
+
+void
+RendererWhitted::set_adaptive_anti_aliasing(bool value)
+{
+  if (value != adaptive_anti_aliasing) {
+    cancel_frame();
+    // Single samples move to the center of their pixel
+    primary_hits_valid = false;
+  }
+  adaptive_anti_aliasing = value;
+}
+
+uint8_t
+RendererWhitted::get_adaptive_samples() const
+{
+  return adaptive_samples;
+}
+
+void
+RendererWhitted::set_adaptive_samples(uint8_t value)
+{
+  if (value != adaptive_samples) {
+    cancel_frame();
+  }
+  adaptive_samples = value;
+}
+
+float
+RendererWhitted::get_adaptive_sample_budget() const
+{
+  return adaptive_sample_budget;
+}
+
+void
+RendererWhitted::set_adaptive_sample_budget(float value)
+{
+  value = std::max(value, 0.0f);
+  if (value != adaptive_sample_budget) {
+    cancel_frame();
+  }
+  adaptive_sample_budget = value;
+}
+
+float
+RendererWhitted::get_light_threshold() const
+{
+  return light_threshold;
+}
+
+void
+RendererWhitted::set_light_threshold(float value)
+{
+  value = std::max(value, 0.0f);
+  if (value != light_threshold) {
+    cancel_frame();
+  }
+  light_threshold = value;
+}
+
+bool
+RendererWhitted::get_reuse_primary_hits() const
+{
+  return reuse_primary_hits;
+}
+
+void
+RendererWhitted::set_reuse_primary_hits(bool value)
+{
+  if (value != reuse_primary_hits) {
+    cancel_frame();
+    primary_hits_valid = false;
+  }
+  reuse_primary_hits = value;
+}
+
+bool
+RendererWhitted::get_pinned_threads() const
+{
+  return thread_pool->is_pinned();
+}
+
+void
+RendererWhitted::set_pinned_threads(bool value)
+{
+  if (value != thread_pool->is_pinned()) {
+    cancel_frame();
+    thread_pool =
+      std::make_unique<ThreadPool>(thread_pool->get_thread_count(), value);
+    release_buffers();
+  }
+}
+
+bool
+RendererWhitted::get_node_local_buffers() const
+{
+  return node_local_buffers;
+}
+
+void
+RendererWhitted::set_node_local_buffers(bool value)
+{
+  if (value != node_local_buffers) {
+    cancel_frame();
+    node_local_buffers = value;
+    release_buffers();
+  }
+}
+
+bool
+RendererWhitted::get_scene_replicas() const
+{
+  return scene_replicas;
+}
+
+void
+RendererWhitted::set_scene_replicas(bool value)
+{
+  if (value != scene_replicas) {
+    cancel_frame();
+  }
+  scene_replicas = value;
+}
+
+std::vector<std::pair<std::string, float>>
+RendererWhitted::evaluate_metrics()
+{
+  using duration_format = std::chrono::duration<float, std::milli>;
+
+  auto result = asynchronous ? presented_metrics : frame_metrics();
+  result.emplace_back(
+    "[STAT] upload: %.2f ms",
+    std::chrono::duration_cast<duration_format>(upload_time).count());
+  return result;
+}
+
+std::vector<std::pair<std::string, float>>
+RendererWhitted::frame_metrics() const
+{
+  using duration_format = std::chrono::duration<float, std::milli>;
+
+  auto& kernels = Kernels::get();
+  std::vector<std::pair<std::string, float>> result = {
+    { std::string("kernels: ") + kernels.name + " (%.0f-wide)",
+      static_cast<float>(kernels.width) },
+    { "threads: %.0f", static_cast<float>(thread_pool->get_thread_count()) },
+    { "[STAT] numa nodes: %.0f",
+      thread_pool->is_pinned()
+        ? static_cast<float>(Topology::get().get_node_count())
+        : 1.0f },
+    { std::string("frame budget: ") +
+        FrameBudget::get_policy_name(frame_budget.get_policy()) +
+        " %.1f ms",
+      std::chrono::duration_cast<duration_format>(frame_budget.get_target())
+        .count() },
+    { "render resolution: %.0f%%",
+      width > 0 ? 100.0f * render_width / width : 100.0f },
+    { "secondary ray limit: %.0f", static_cast<float>(secondary_ray_limit) },
+    { "refinement pass: %.0f/" + std::to_string(refinement_passes),
+      static_cast<float>(std::min(refinement_pass + 1, +refinement_passes)) },
+  };
+  if (adaptive_anti_aliasing) {
+    // Uniform supersampling reaching the same samples on edges traces the
+    // extra samples on every pixel
+    auto uniform_rays = static_cast<float>(render_width) * render_height *
+                        std::max(adaptive_samples - samples_per_pixel, 0);
+    result.emplace_back("anti-aliasing rays: %.0f",
+                        static_cast<float>(adaptive_rays));
+    result.emplace_back("anti-aliasing rays vs uniform " +
+                          std::to_string(adaptive_samples) + "x: %.1f%%",
+                        uniform_rays > 0.0f
+                          ? 100.0f * adaptive_rays / uniform_rays
+                          : 0.0f);
+  }
+
+  // Work and time of each stage of the last frame
+  const std::pair<const char*, uint64_t> counters[] = {
+    { "primary rays", frame_counters.primary_rays },
+    { "reused primary hits", frame_counters.reused_primary_hits },
+    { "secondary rays", frame_counters.secondary_rays },
+    { "shadow rays", frame_counters.shadow_rays },
+    { "light tree nodes visited", frame_counters.light_nodes },
+    { "bvh nodes visited", frame_counters.bvh_nodes },
+    { "aabb tests", frame_counters.aabb_tests },
+    { "triangle tests", frame_counters.triangle_tests },
+    { "sdf march steps", frame_counters.sdf_steps },
+    { "shading calls", frame_counters.shading_calls },
+  };
+  for (auto& [name, count] : counters) {
+    result.emplace_back(std::string("[STAT] ") + name + ": %.0f",
+                        static_cast<float>(count));
+  }
+  result.emplace_back("[STAT] shadow rays blocked by cached occluder: %.1f%%",
+                      frame_counters.shadow_rays > 0
+                        ? 100.0f * frame_counters.shadow_cache_hits /
+                            frame_counters.shadow_rays
+                        : 0.0f);
+  if (asynchronous) {
+    result.emplace_back("[STAT] cancelled frames: %.0f",
+                        static_cast<float>(cancelled_frames));
+  }
+  const std::pair<const char*, std::chrono::nanoseconds> phases[] = {
+    { "scene replication", phase_times.scene_replication },
+    { "ray generation", phase_times.ray_generation },
+    { "trace", phase_times.trace },
+    { "reconstruction", phase_times.reconstruction },
+    { "anti-aliasing", phase_times.anti_aliasing },
+    { "upsample", phase_times.upsample },
+    { "quantize", phase_times.quantize },
+  };
+  for (auto& [name, time] : phases) {
+    result.emplace_back(
+      std::string("[STAT] ") + name + ": %.2f ms",
+      std::chrono::duration_cast<duration_format>(time).count());
+  }
+
+  // Load balance of the last frame, everything but tile rendering counts as
+  // idle time
+  for (uint32_t i = 0; i < thread_busy_time.size(); ++i) {
+    auto busy_time = thread_busy_time[i];
+    auto idle_time = frame_time > busy_time ? frame_time - busy_time
+                                            : std::chrono::nanoseconds(0);
+    result.emplace_back(
+      "[GRAPH:" + std::to_string(i) + "] thread busy (ms)",
+      std::chrono::duration_cast<duration_format>(busy_time).count());
+    result.emplace_back(
+      "[GRAPH:" + std::to_string(i) + "] thread idle (ms)",
+      std::chrono::duration_cast<duration_format>(idle_time).count());
+    result.emplace_back(
+      "[GRAPH:" + std::to_string(i) + "] tiles stolen",
+      static_cast<float>(tile_scheduler->get_stolen_count(i)));
+  }
+  return result;
+}
+
 void
 RendererWhitted::rebuild_backbuffers()
 {
   cpu_buffer.resize(width * height);
+  display_buffer.resize(width * height);
+  render_buffer.resize(width * height);
+  depth_buffer.resize(width * height);
+  material_buffer.resize(width * height);
+  primary_hits.resize(width * height);
 
   for (uint32_t y = 0; y < height; ++y) {
     for (uint32_t x = 0; x < width; ++x) {
@@ -425,34 +1498,76 @@ RendererWhitted::rebuild_backbuffers()
       cpu_buffer[y * width + x][2] = 0;
     }
   }
+  release_buffers();
 
-  rays.resize(width * height);
-
-  if (context) {
-    gpu_buffer = Texture::create(
-      width, height, Texture::MipMapFilter::linear, Texture::Format::rgb32f);
-    gpu_buffer->set_debug_name("CPU-GPU buffer");
+  presenter->resize(width, height);
+}
 
-    glViewport(0, 0, width, height);
+void
+RendererWhitted::release_buffers()
+{
+  if (!node_local_buffers || !thread_pool->is_pinned()) {
+    return;
   }
+  // What the buffers held reads as zero once released, frames trace them over
+  // from scratch
+  auto release = [](auto& buffer) {
+    Topology::release_pages(buffer.data(), buffer.size() * sizeof(buffer[0]));
+  };
+  release(cpu_buffer);
+  release(render_buffer);
+  release(depth_buffer);
+  release(material_buffer);
+  release(primary_hits);
+  restart_refinement = true;
+  primary_hits_valid = false;
+  buffers_released = true;
 }
 
 void
-RendererWhitted::create_geometry()
+RendererWhitted::place_buffers()
 {
-  fullscreen_quad = IndexedMesh::create_fullscreen_quad();
+  auto zone = Profiler::ScopedZone("RendererWhitted::place_buffers");
+  // Tiles are dealt at the display resolution, frames traced below it only
+  // roughly match
+  tile_scheduler->reset(width, height, thread_pool->get_thread_count());
+  thread_pool->run([this](uint32_t thread_index) {
+    Tile tile;
+    while (tile_scheduler->next_dealt(thread_index, tile)) {
+      for (uint32_t y = tile.y; y < tile.y + tile.height; ++y) {
+        auto first = y * width + tile.x;
+        std::fill_n(&cpu_buffer[first], tile.width, vec3(0, 0, 0));
+        std::fill_n(&render_buffer[first], tile.width, vec3(0, 0, 0));
+        std::fill_n(&depth_buffer[first], tile.width, 0.0f);
+        std::fill_n(&material_buffer[first], tile.width, uint16_t(0));
+        std::fill_n(&primary_hits[first], tile.width, PrimaryHit());
+      }
+    }
+  });
+  buffers_released = false;
 }
 
 void
-RendererWhitted::create_pipeline()
+RendererWhitted::replicate_scene(const Scene& scene)
 {
-  PipelineCreateInfo info;
-  info.vertex_shader_binary = passthrough_flip_y_vs;
-  info.vertex_shader_size =
-    sizeof(passthrough_flip_y_vs) / sizeof(passthrough_flip_y_vs[0]);
-  info.vertex_shader_entry_point = "main";
-  info.fragment_shader_binary = fullscreen_fs;
-  info.fragment_shader_size = sizeof(fullscreen_fs) / sizeof(fullscreen_fs[0]);
-  info.fragment_shader_entry_point = "main";
-  screen_space_pipeline = Pipeline::create(Pipeline::Type::RasterOpenGL, info);
+  auto node_count = Topology::get().get_node_count();
+  node_replicas.resize(node_count);
+  node_scenes.assign(node_count, nullptr);
+  thread_pool->run([this, &scene](uint32_t thread_index) {
+    // The first thread of each node copies the scene for the others
+    auto node = thread_pool->get_node(thread_index);
+    if (thread_index == 0 || thread_pool->get_node(thread_index - 1) != node) {
+      node_scenes[node] = scene.replicate(node_replicas[node]);
+    }
+  });
+}
+
+const Scene&
+RendererWhitted::get_thread_scene(const Scene& scene,
+                                  uint32_t thread_index) const
+{
+  if (node_scenes.empty()) {
+    return scene;
+  }
+  return *node_scenes[thread_pool->get_node(thread_index)];
 }
@@ -2,28 +2,38 @@
 
 #include "renderer.h"
 
+#include <atomic>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include "counters.h"
+#include "frame_budget.h"
+#include "frame_presenter.h"
+#include "light_tree.h"
 #include "ray.h"
+#include "scene.h"
 
-typedef void* SDL_GLContext;
+#include "../threading/triple_buffer.h"
 
 namespace Raytracer {
 class Camera;
+struct hit_record;
+namespace Threading {
+class ThreadPool;
+class TileScheduler;
+struct Tile;
+} // namespace Threading
 namespace Graphics {
-class Pipeline;
-struct IndexedMesh;
-struct Texture;
-struct Framebuffer;
-
 class RendererWhitted : public Renderer
 {
 public:
+  /// Without a window, frames are rendered to get_frame() without any GL
   explicit RendererWhitted(SDL_Window* window);
   ~RendererWhitted() override;
 
-  void compute_primary_rays(const Camera& camera);
   void run(const Scene& scene) override;
   void set_backbuffer_size(uint16_t w, uint16_t h) override;
   bool get_debug() const override;
@@ -31,41 +41,287 @@ public:
   void set_debug_data(uint32_t data) override;
   uint8_t get_recursion_depth() const override { return 1; }
   void set_recursion_depth(uint8_t) override {}
+  uint32_t get_thread_count() const override;
+  void set_thread_count(uint32_t value) override;
+  bool get_asynchronous() const override;
+  void set_asynchronous(bool value) override;
+  uint8_t get_samples_per_pixel() const;
+  /// Above 1, the samples of each pixel are jittered and averaged
+  void set_samples_per_pixel(uint8_t value);
+  FrameBudget::Policy get_frame_budget_policy() const;
+  void set_frame_budget_policy(FrameBudget::Policy value);
+  std::chrono::microseconds get_frame_time_target() const;
+  void set_frame_time_target(std::chrono::microseconds value);
+  /// Last frame presented at the backbuffer size, gamma corrected RGBA8 with
+  /// red in the lowest byte, bottom row first
+  const std::vector<uint32_t>& get_frame() const;
+  bool get_progressive() const;
+  /// Trace a quarter of the pixels while the camera moves and fill in the rest
+  /// over the following frames once it stops
+  void set_progressive(bool value);
+  bool get_adaptive_anti_aliasing() const;
+  /// Trace more samples on color, depth and material edges of full frames
+  void set_adaptive_anti_aliasing(bool value);
+  uint8_t get_adaptive_samples() const;
+  /// Samples per pixel on edges once anti-aliased
+  void set_adaptive_samples(uint8_t value);
+  float get_adaptive_sample_budget() const;
+  /// Extra rays anti-aliasing may trace each frame, per pixel of the frame
+  void set_adaptive_sample_budget(float value);
+  float get_light_threshold() const;
+  /// Lights which cannot add more than this to a pixel are not shaded, 0 to
+  /// shade every light
+  void set_light_threshold(float value);
+  bool get_reuse_primary_hits() const;
+  /// Shade what the primary rays of the last full frame hit again instead of
+  /// tracing them, while the camera and the geometry stay still
+  void set_reuse_primary_hits(bool value);
+  bool get_pinned_threads() const;
+  /// Keep each render thread to a cpu, the threads of a NUMA node together
+  void set_pinned_threads(bool value);
+  bool get_node_local_buffers() const;
+  /// With pinned threads, place the pages of the frame buffers on the node of
+  /// the thread dealt their tiles by letting it write them first
+  void set_node_local_buffers(bool value);
+  bool get_scene_replicas() const;
+  /// With pinned threads, have each NUMA node trace its own copy of the
+  /// geometry, bvhs and textures of the scene
+  void set_scene_replicas(bool value);
 
-  std::vector<std::pair<std::string, float>> evaluate_metrics() override { return {}; }
+  std::vector<std::pair<std::string, float>> evaluate_metrics() override;
   std::vector<std::pair<std::string, uintptr_t>> debug_textures() override
   {
     return {};
   }
 
+  /// What the primary ray of a pixel hit, enough to shade it again
+  struct PrimaryHit
+  {
+    vec3 normal;
+    vec3 tangent;
+    vec3 uv;
+    float distance;
+    /// Set to the highest id if the ray hit nothing
+    uint16_t mat_id;
+  };
+
+  /// Bound the lights of the scene for raygen, run does it every frame
+  void build_light_tree(const Scene& scene);
+  /// Also copies what the ray itself hit to primary_payload if not null, and
+  /// to primary_hit if not null. If reuse_primary_hit is set, primary_hit is
+  /// shaded instead of tracing the ray itself
   uint32_t raygen(const Ray& ray,
                   const Scene& scene,
                   bool debug_bvh,
-                  vec3& color) const;
+                  vec3& color,
+                  RayPayload* primary_payload = nullptr,
+                  PrimaryHit* primary_hit = nullptr,
+                  bool reuse_primary_hit = false) const;
 
 private:
+  struct EdgePixel
+  {
+    uint32_t index;
+    float contrast;
+  };
+  /// Frame handed from the render thread to run when rendering asynchronously
+  struct FinishedFrame
+  {
+    std::vector<uint32_t> pixels;
+    std::vector<std::pair<std::string, float>> metrics;
+  };
+  /// What the frame being traced does with primary_hits
+  enum class PrimaryHitUse : uint8_t
+  {
+    None,
+    Store,
+    Reuse,
+  };
+  using RaygenKernel = uint32_t (RendererWhitted::*)(const Ray&,
+                                                     const Scene&,
+                                                     vec3&,
+                                                     RayPayload*,
+                                                     PrimaryHit*) const;
+
+  /// raygen specialized on the features of a frame so its loop over the rays
+  /// of a pixel carries no branch on them. Without textures, hits need neither
+  /// their uv nor their tangent
+  template<bool debug, bool textured, PrimaryHitUse hit_use>
+  uint32_t raygen_kernel(const Ray& ray,
+                         const Scene& scene,
+                         vec3& color,
+                         RayPayload* primary_payload,
+                         PrimaryHit* primary_hit) const;
+  static RaygenKernel select_raygen_kernel(bool debug,
+                                           bool textured,
+                                           PrimaryHitUse hit_use);
+  template<bool debug, bool textured>
+  static RaygenKernel select_raygen_kernel(PrimaryHitUse hit_use);
+
+  /// Trace, refine, anti-alias and upsample a frame seen from frame_camera
+  /// into cpu_buffer
+  void render_frame(const Scene& scene, bool camera_moving);
+  /// Draw a frame to the window, uploading it first if upload is set
+  void present(const std::vector<uint32_t>& pixels, bool upload);
+  /// Metrics of the last frame rendered
+  std::vector<std::pair<std::string, float>> frame_metrics() const;
+  void render_loop();
+  void stop_render_thread();
+  /// Stop the frame traced in the background, returns once the render thread
+  /// is idle so the renderer can be changed
+  void cancel_frame();
+  void render_tile(const Scene& scene,
+                   const Threading::Tile& tile,
+                   uint32_t thread_index);
+  /// Bilinear filter of the render buffer to the display resolution
+  void upsample(uint32_t thread_index, uint32_t thread_count);
+  /// Clamp and round the frame to the display buffer
+  void quantize(uint32_t thread_index, uint32_t thread_count);
+  /// Whether the current refinement pass or an earlier one traced a pixel
+  bool is_traced(uint16_t x, uint16_t y) const;
+  /// Fill pixels not traced yet from their traced neighbours
+  void reconstruct(uint32_t thread_index, uint32_t thread_count);
+  /// Largest color difference with the neighbours of a pixel, above 1 if one
+  /// of them has a different material or depth
+  float edge_contrast(uint16_t x, uint16_t y) const;
+  void detect_edges(uint32_t thread_index, uint32_t thread_count);
+  /// Keep the edge pixels with the most contrast that fit in the budget
+  void select_edge_pixels(uint32_t thread_count);
+  void anti_alias(const Scene& scene,
+                  uint32_t thread_index,
+                  uint32_t thread_count);
   void rebuild_backbuffers();
-  void create_geometry();
-  void create_pipeline();
-  bool trace(RayPayload& payload,
+  /// Drop the pages of the frame buffers for place_buffers to place, if they
+  /// are node local
+  void release_buffers();
+  /// Have each thread write the pages of the tiles it is dealt first
+  void place_buffers();
+  /// Copy the scene on each node with threads
+  void replicate_scene(const Scene& scene);
+  /// Scene the thread of that index traces, the copy of its node if any
+  const Scene& get_thread_scene(const Scene& scene,
+                                uint32_t thread_index) const;
+  /// Closest hit of the world, occluded looks for any hit instead
+  bool intersect(const Scene& scene,
+                 const Ray& r,
+                 float t_min,
+                 float t_max,
+                 hit_record& rec) const;
+  /// Whether anything blocks a shadow ray towards the light of that index,
+  /// testing what blocked the last one towards it on this thread first
+  bool occluded(const Scene& scene,
+                const Ray& r,
+                float t_min,
+                float t_max,
+                uint32_t light) const;
+  /// Fill the payload with the material at a hit, or the sky without one
+  template<bool textured>
+  void shade(RayPayload& payload,
              const Scene& scene,
-             const Ray& r,
-             bool early_out,
-             float t_min,
-             float t_max) const;
+             const hit_record& rec,
+             bool hit) const;
 
-  SDL_GLContext context;
+  std::unique_ptr<FramePresenter> presenter;
   uint16_t width;
   uint16_t height;
   bool debug_bvh;
   uint32_t debug_bvh_count;
+  uint8_t samples_per_pixel;
+  FrameBudget frame_budget;
+  /// Resolution of the frame being traced, lower than the display's if the
+  /// frame budget requires it
+  uint16_t render_width;
+  uint16_t render_height;
+  /// Secondary rays per pixel allowed by the frame budget
+  uint8_t secondary_ray_limit;
+  bool progressive;
+  /// Each pass of progressive refinement traces one pixel of every 2x2 block,
+  /// the frame is complete once refinement_pass reaches refinement_passes
+  static constexpr uint8_t refinement_passes = 4;
+  uint8_t refinement_pass;
+  /// Whether the next frame traces the first pass again, set when what the
+  /// previous passes traced is stale
+  bool restart_refinement;
+  bool adaptive_anti_aliasing;
+  uint8_t adaptive_samples;
+  float adaptive_sample_budget;
+  /// Extra rays traced by anti-aliasing during the last frame
+  uint32_t adaptive_rays;
+  LightTree light_tree;
+  float light_threshold;
+  bool reuse_primary_hits;
+  /// Whether primary_hits holds every pixel of the last full frame, traced
+  /// with the same camera, resolution and geometry_version as the next one
+  bool primary_hits_valid;
+  uint32_t primary_hits_geometry_version;
+  PrimaryHitUse primary_hit_use;
+  /// Instantiation of raygen the tiles of the frame being traced use
+  RaygenKernel frame_raygen_kernel;
 
-  std::vector<Ray> rays;
+  std::unique_ptr<Threading::ThreadPool> thread_pool;
+  std::unique_ptr<Threading::TileScheduler> tile_scheduler;
+  bool node_local_buffers;
+  /// The pages of the frame buffers were dropped and wait to be placed
+  bool buffers_released;
+  bool scene_replicas;
+  /// Copy of the scene each NUMA node traces and what it copied, empty
+  /// unless replicated
+  std::vector<Scene::Replicas> node_replicas;
+  std::vector<std::shared_ptr<const Scene>> node_scenes;
+  /// Time each thread spent rendering tiles during the last frame
+  std::vector<std::chrono::nanoseconds> thread_busy_time;
+  /// Part of the busy time spent computing camera rays
+  std::vector<std::chrono::nanoseconds> thread_ray_generation_time;
+  std::vector<Counters::Frame> thread_counters;
+  std::chrono::nanoseconds frame_time;
+  /// Wall time of each phase of the last frame
+  struct PhaseTimes
+  {
+    std::chrono::nanoseconds scene_replication;
+    std::chrono::nanoseconds ray_generation;
+    std::chrono::nanoseconds trace;
+    std::chrono::nanoseconds reconstruction;
+    std::chrono::nanoseconds anti_aliasing;
+    std::chrono::nanoseconds upsample;
+    std::chrono::nanoseconds quantize;
+  } phase_times;
+  /// Time run took to upload and draw the last frame
+  std::chrono::nanoseconds upload_time;
+  /// Counters of all threads during the last frame
+  Counters::Frame frame_counters;
   std::vector<vec3> cpu_buffer;
-  std::unique_ptr<Framebuffer> backbuffer;
-  std::unique_ptr<Texture> gpu_buffer;
-  std::unique_ptr<Pipeline> screen_space_pipeline;
-  std::unique_ptr<IndexedMesh> fullscreen_quad;
+  /// cpu_buffer as uploaded, a third of its size
+  std::vector<uint32_t> display_buffer;
+  /// Frame traced below the display resolution before it is upsampled
+  std::vector<vec3> render_buffer;
+  vec3* render_target;
+  /// Distance and material of the first hit of each pixel in render_target
+  std::vector<float> depth_buffer;
+  std::vector<uint16_t> material_buffer;
+  std::vector<PrimaryHit> primary_hits;
+  std::vector<std::vector<EdgePixel>> thread_edge_pixels;
+  std::vector<EdgePixel> edge_pixels;
+  /// Camera of the frame being traced, a copy so the scene's can move meanwhile
+  std::unique_ptr<Camera> frame_camera;
+
+  bool asynchronous;
+  std::thread render_thread;
+  /// Guards the frame requests to the render thread
+  std::mutex render_mutex;
+  std::condition_variable render_condition;
+  /// Set by run to start a frame, cleared by the render thread once it is done
+  bool render_requested;
+  bool render_thread_stopping;
+  /// Snapshot of the scene the render thread traces, released once it is done
+  std::shared_ptr<const Scene> render_scene;
+  bool render_camera_moving;
+  /// The camera moved since the frame being traced was started
+  bool camera_moved;
+  std::atomic<bool> frame_cancelled;
+  uint32_t cancelled_frames;
+  Threading::TripleBuffer<FinishedFrame> finished_frames;
+  /// Metrics of the frame presented by run
+  std::vector<std::pair<std::string, float>> presented_metrics;
 };
 } // namespace Graphics
 } // namespace Raytracer
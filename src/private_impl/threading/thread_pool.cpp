@@ -0,0 +1,169 @@
+#include "thread_pool.h"
+
+#include "profiler.h"
+#include "topology.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+using Raytracer::Threading::ThreadPool;
+using Raytracer::Threading::Topology;
+
+namespace {
+/// Frames follow each other closely, spinning this many times before sleeping
+/// spares most wake ups the latency of the condition variable
+constexpr uint32_t max_spin_count = 4096;
+
+inline void
+relax()
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  _mm_pause();
+#else
+  std::this_thread::yield();
+#endif
+}
+} // namespace
+
+ThreadPool::ThreadPool(uint32_t thread_count, bool _pinned)
+  : workers()
+  , pinned(_pinned)
+  , spin_count(0)
+  , task(nullptr)
+  , generation(0)
+  , pending(0)
+  , stopping(false)
+  , mutex()
+  , wake()
+  , done()
+{
+  uint32_t hardware_threads = std::thread::hardware_concurrency();
+  if (thread_count == 0) {
+    thread_count = hardware_threads;
+  }
+  // Spinning threads would only take time away from the ones doing the work
+  // if there are more of them than hardware threads
+  if (thread_count <= hardware_threads) {
+    spin_count = max_spin_count;
+  }
+  // The calling thread is the first one
+  for (uint32_t i = 1; i < thread_count; ++i) {
+    workers.emplace_back(&ThreadPool::work, this, i, thread_count);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  stopping.store(true, std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+}
+
+uint32_t
+ThreadPool::get_thread_count() const
+{
+  return static_cast<uint32_t>(workers.size()) + 1;
+}
+
+bool
+ThreadPool::is_pinned() const
+{
+  return pinned;
+}
+
+uint32_t
+ThreadPool::get_node(uint32_t thread_index) const
+{
+  if (!pinned) {
+    return 0;
+  }
+  return Topology::get().get_thread_node(thread_index, get_thread_count());
+}
+
+void
+ThreadPool::run(const Task& _task)
+{
+  if (pinned) {
+    auto& topology = Topology::get();
+    topology.pin_current_thread(
+      topology.get_thread_cpu(0, get_thread_count()));
+  }
+  if (workers.empty()) {
+    _task(0);
+    if (pinned) {
+      Topology::get().unpin_current_thread();
+    }
+    return;
+  }
+
+  task = &_task;
+  pending.store(static_cast<uint32_t>(workers.size()),
+                std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    generation.fetch_add(1, std::memory_order_release);
+  }
+  wake.notify_all();
+
+  _task(0);
+
+  for (uint32_t i = 0;
+       i < spin_count && pending.load(std::memory_order_acquire) != 0;
+       ++i) {
+    relax();
+  }
+  if (pending.load(std::memory_order_acquire) != 0) {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock,
+              [this] { return pending.load(std::memory_order_acquire) == 0; });
+  }
+  task = nullptr;
+  if (pinned) {
+    Topology::get().unpin_current_thread();
+  }
+}
+
+void
+ThreadPool::work(uint32_t thread_index, uint32_t thread_count)
+{
+  Profiler::set_thread_name("worker " + std::to_string(thread_index));
+  if (pinned) {
+    auto& topology = Topology::get();
+    topology.pin_current_thread(
+      topology.get_thread_cpu(thread_index, thread_count));
+  }
+  uint32_t seen = 0;
+  for (;;) {
+    uint32_t current = generation.load(std::memory_order_acquire);
+    for (uint32_t i = 0; i < spin_count && current == seen; ++i) {
+      relax();
+      current = generation.load(std::memory_order_acquire);
+    }
+    if (current == seen) {
+      std::unique_lock<std::mutex> lock(mutex);
+      wake.wait(lock, [this, seen, &current] {
+        current = generation.load(std::memory_order_acquire);
+        return current != seen;
+      });
+    }
+    seen = current;
+
+    if (stopping.load(std::memory_order_relaxed)) {
+      return;
+    }
+
+    (*task)(thread_index);
+
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      std::lock_guard<std::mutex> lock(mutex);
+      done.notify_one();
+    }
+  }
+}
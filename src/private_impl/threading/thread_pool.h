@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Raytracer::Threading {
+/// Workers kept alive between frames. Each call to run wakes them, runs the
+/// task once on every thread, the calling thread included, and returns when
+/// all of them are done. Pinned threads each keep to a cpu, grouped by NUMA
+/// node, so what they first write stays local to their node.
+class ThreadPool
+{
+public:
+  using Task = std::function<void(uint32_t thread_index)>;
+
+  /// A thread_count of 0 uses one thread per hardware thread
+  explicit ThreadPool(uint32_t thread_count = 0, bool pinned = false);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /// Threads running a task, the calling thread included
+  uint32_t get_thread_count() const;
+  bool is_pinned() const;
+  /// NUMA node the thread of that index runs on, always 0 unless pinned
+  uint32_t get_node(uint32_t thread_index) const;
+  /// The calling thread is pinned only for the duration of the task
+  void run(const Task& task);
+
+private:
+  void work(uint32_t thread_index, uint32_t thread_count);
+
+  std::vector<std::thread> workers;
+  bool pinned;
+  uint32_t spin_count;
+  const Task* task;
+  /// Incremented for every task and on shutdown to wake the workers
+  std::atomic<uint32_t> generation;
+  /// Workers which have not finished the current task yet
+  std::atomic<uint32_t> pending;
+  std::atomic<bool> stopping;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable done;
+};
+} // namespace Raytracer::Threading
@@ -0,0 +1,161 @@
+#include "tile_scheduler.h"
+
+#include <algorithm>
+
+using Raytracer::Threading::Tile;
+using Raytracer::Threading::TileScheduler;
+
+namespace {
+/// Spread the bits of a 16 bit value over the even bits of the result
+uint32_t
+part_by_one(uint32_t value)
+{
+  value = (value | (value << 8)) & 0x00FF00FFu;
+  value = (value | (value << 4)) & 0x0F0F0F0Fu;
+  value = (value | (value << 2)) & 0x33333333u;
+  value = (value | (value << 1)) & 0x55555555u;
+  return value;
+}
+
+uint32_t
+morton_code(uint16_t x, uint16_t y)
+{
+  return part_by_one(x) | (part_by_one(y) << 1);
+}
+
+inline uint64_t
+pack_range(uint32_t begin, uint32_t end)
+{
+  return (static_cast<uint64_t>(end) << 32) | begin;
+}
+} // namespace
+
+TileScheduler::TileScheduler()
+  : width(0)
+  , height(0)
+  , tiles()
+  , queues()
+  , queue_count(0)
+{}
+
+void
+TileScheduler::reset(uint16_t _width, uint16_t _height, uint32_t worker_count)
+{
+  if (_width != width || _height != height) {
+    width = _width;
+    height = _height;
+
+    uint16_t columns = (width + tile_size - 1) / tile_size;
+    uint16_t rows = (height + tile_size - 1) / tile_size;
+    tiles.clear();
+    tiles.reserve(columns * rows);
+    for (uint16_t row = 0; row < rows; ++row) {
+      for (uint16_t column = 0; column < columns; ++column) {
+        uint16_t x = column * tile_size;
+        uint16_t y = row * tile_size;
+        tiles.push_back(Tile{ x,
+                              y,
+                              std::min<uint16_t>(tile_size, width - x),
+                              std::min<uint16_t>(tile_size, height - y) });
+      }
+    }
+    // Neighbouring tiles in the list are close on screen, which keeps each
+    // worker's run coherent in memory and in the bvh
+    std::sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) {
+      return morton_code(a.x / tile_size, a.y / tile_size) <
+             morton_code(b.x / tile_size, b.y / tile_size);
+    });
+  }
+
+  if (worker_count != queue_count) {
+    queue_count = worker_count;
+    queues = std::make_unique<Queue[]>(queue_count);
+  }
+  auto tile_count = static_cast<uint32_t>(tiles.size());
+  for (uint32_t i = 0; i < queue_count; ++i) {
+    uint32_t begin = tile_count * i / queue_count;
+    uint32_t end = tile_count * (i + 1) / queue_count;
+    queues[i].range.store(pack_range(begin, end), std::memory_order_relaxed);
+    queues[i].stolen = 0;
+  }
+}
+
+bool
+TileScheduler::next(uint32_t worker, Tile& tile)
+{
+  uint32_t index;
+  if (take_front(queues[worker], index)) {
+    tile = tiles[index];
+    return true;
+  }
+  for (uint32_t i = 1; i < queue_count; ++i) {
+    auto& victim = queues[(worker + i) % queue_count];
+    if (take_back(victim, index)) {
+      queues[worker].stolen++;
+      tile = tiles[index];
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+TileScheduler::next_dealt(uint32_t worker, Tile& tile)
+{
+  uint32_t index;
+  if (!take_front(queues[worker], index)) {
+    return false;
+  }
+  tile = tiles[index];
+  return true;
+}
+
+uint32_t
+TileScheduler::get_tile_count() const
+{
+  return static_cast<uint32_t>(tiles.size());
+}
+
+uint32_t
+TileScheduler::get_stolen_count(uint32_t worker) const
+{
+  return queues[worker].stolen;
+}
+
+bool
+TileScheduler::take_front(Queue& queue, uint32_t& index)
+{
+  auto range = queue.range.load(std::memory_order_relaxed);
+  for (;;) {
+    auto begin = static_cast<uint32_t>(range);
+    auto end = static_cast<uint32_t>(range >> 32);
+    if (begin >= end) {
+      return false;
+    }
+    if (queue.range.compare_exchange_weak(range,
+                                          pack_range(begin + 1, end),
+                                          std::memory_order_relaxed)) {
+      index = begin;
+      return true;
+    }
+  }
+}
+
+bool
+TileScheduler::take_back(Queue& queue, uint32_t& index)
+{
+  auto range = queue.range.load(std::memory_order_relaxed);
+  for (;;) {
+    auto begin = static_cast<uint32_t>(range);
+    auto end = static_cast<uint32_t>(range >> 32);
+    if (begin >= end) {
+      return false;
+    }
+    if (queue.range.compare_exchange_weak(range,
+                                          pack_range(begin, end - 1),
+                                          std::memory_order_relaxed)) {
+      index = end - 1;
+      return true;
+    }
+  }
+}
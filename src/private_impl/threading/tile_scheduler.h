@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace Raytracer::Threading {
+struct Tile
+{
+  uint16_t x;
+  uint16_t y;
+  uint16_t width;
+  uint16_t height;
+};
+
+/// Splits frames into small square tiles in Morton order and deals a
+/// contiguous run of them to each worker. Workers take tiles from the front of
+/// their own run and, once it is empty, steal from the back of the others', so
+/// expensive regions of the image do not hold up the whole frame.
+class TileScheduler
+{
+public:
+  static constexpr uint16_t tile_size = 16;
+
+  TileScheduler();
+
+  /// Deal the tiles of a frame between workers, must not be called while
+  /// workers are taking tiles
+  void reset(uint16_t width, uint16_t height, uint32_t worker_count);
+  /// Returns false once every tile of the frame has been taken
+  bool next(uint32_t worker, Tile& tile);
+  /// Like next, without stealing the tiles dealt to other workers
+  bool next_dealt(uint32_t worker, Tile& tile);
+
+  uint32_t get_tile_count() const;
+  /// Tiles a worker took from the others during the current frame
+  uint32_t get_stolen_count(uint32_t worker) const;
+
+private:
+  /// Remaining tiles of a worker, the first index in the low half and one past
+  /// the last in the high half so both ends move with a single exchange
+  struct alignas(64) Queue
+  {
+    std::atomic<uint64_t> range;
+    uint32_t stolen;
+  };
+
+  bool take_front(Queue& queue, uint32_t& index);
+  bool take_back(Queue& queue, uint32_t& index);
+
+  uint16_t width;
+  uint16_t height;
+  std::vector<Tile> tiles;
+  std::unique_ptr<Queue[]> queues;
+  uint32_t queue_count;
+};
+} // namespace Raytracer::Threading
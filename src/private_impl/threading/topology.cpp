@@ -0,0 +1,209 @@
+#include "topology.h"
+
+#include <cstdlib>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#if __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using Raytracer::Threading::Topology;
+
+namespace {
+#if __linux__
+/// Highest node id looked for in sysfs, ids may have gaps
+constexpr uint32_t max_node_id = 256;
+
+/// Parse a sysfs cpu list such as 0-3,8-11
+std::vector<uint32_t>
+parse_cpu_list(const std::string& list)
+{
+  std::vector<uint32_t> cpus;
+  std::stringstream stream(list);
+  std::string range;
+  while (std::getline(stream, range, ',')) {
+    char* end = nullptr;
+    auto first = std::strtoul(range.c_str(), &end, 10);
+    if (end == range.c_str()) {
+      continue;
+    }
+    auto last = first;
+    if (*end == '-') {
+      last = std::strtoul(end + 1, nullptr, 10);
+    }
+    for (auto cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(static_cast<uint32_t>(cpu));
+    }
+  }
+  return cpus;
+}
+#endif
+} // namespace
+
+Topology::Topology()
+  : node_cpus()
+  , process_cpus()
+{
+#if __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+    for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        process_cpus.push_back(cpu);
+      }
+    }
+  }
+
+  auto emulated = std::getenv("RAYTRACER_NUMA_NODES");
+  if (emulated != nullptr && !process_cpus.empty()) {
+    auto node_count = std::strtoul(emulated, nullptr, 10);
+    if (node_count == 0 || node_count > max_node_id) {
+      std::cerr << "Warn: Invalid RAYTRACER_NUMA_NODES=" << emulated
+                << ", using the nodes of the machine." << std::endl;
+    } else {
+      node_cpus.resize(node_count);
+      auto cpu_count = process_cpus.size();
+      // Emulated nodes share cpus if there are more of them than cpus
+      for (size_t i = 0; i < std::max(node_count, cpu_count); ++i) {
+        node_cpus[i * node_count / std::max(node_count, cpu_count)]
+          .push_back(process_cpus[i % cpu_count]);
+      }
+      return;
+    }
+  }
+
+  // Nodes without any cpu of the process, such as memory only nodes, get no
+  // threads
+  for (uint32_t node = 0; node < max_node_id; ++node) {
+    std::ifstream file("/sys/devices/system/node/node" +
+                       std::to_string(node) + "/cpulist");
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+      continue;
+    }
+    std::vector<uint32_t> cpus;
+    for (auto cpu : parse_cpu_list(list)) {
+      if (std::binary_search(process_cpus.begin(), process_cpus.end(), cpu)) {
+        cpus.push_back(cpu);
+      }
+    }
+    if (!cpus.empty()) {
+      node_cpus.emplace_back(std::move(cpus));
+    }
+  }
+#endif
+  if (node_cpus.empty()) {
+    if (process_cpus.empty()) {
+      for (uint32_t cpu = 0; cpu < std::thread::hardware_concurrency();
+           ++cpu) {
+        process_cpus.push_back(cpu);
+      }
+    }
+    node_cpus.emplace_back(process_cpus);
+  }
+}
+
+const Topology&
+Topology::get()
+{
+  static const Topology topology;
+  return topology;
+}
+
+uint32_t
+Topology::get_node_count() const
+{
+  return static_cast<uint32_t>(node_cpus.size());
+}
+
+const std::vector<uint32_t>&
+Topology::get_cpus(uint32_t node) const
+{
+  return node_cpus[node];
+}
+
+uint32_t
+Topology::get_first_thread(uint32_t node, uint32_t thread_count) const
+{
+  size_t cpus_before = 0;
+  size_t cpu_count = 0;
+  for (uint32_t i = 0; i < node_cpus.size(); ++i) {
+    if (i < node) {
+      cpus_before += node_cpus[i].size();
+    }
+    cpu_count += node_cpus[i].size();
+  }
+  return static_cast<uint32_t>(thread_count * cpus_before / cpu_count);
+}
+
+uint32_t
+Topology::get_thread_node(uint32_t thread_index, uint32_t thread_count) const
+{
+  // Nodes getting no thread share their first thread with the next node
+  uint32_t node = 0;
+  for (uint32_t i = 1; i < node_cpus.size(); ++i) {
+    if (get_first_thread(i, thread_count) <= thread_index) {
+      node = i;
+    }
+  }
+  return node;
+}
+
+uint32_t
+Topology::get_thread_cpu(uint32_t thread_index, uint32_t thread_count) const
+{
+  auto node = get_thread_node(thread_index, thread_count);
+  auto& cpus = node_cpus[node];
+  return cpus[(thread_index - get_first_thread(node, thread_count)) %
+              cpus.size()];
+}
+
+bool
+Topology::pin_current_thread([[maybe_unused]] uint32_t cpu) const
+{
+#if __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  CPU_SET(cpu, &cpus);
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  return false;
+#endif
+}
+
+void
+Topology::unpin_current_thread() const
+{
+#if __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (auto cpu : process_cpus) {
+    CPU_SET(cpu, &cpus);
+  }
+  sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+}
+
+void
+Topology::release_pages([[maybe_unused]] void* data,
+                        [[maybe_unused]] size_t size)
+{
+#if __linux__
+  auto page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  auto begin = reinterpret_cast<uintptr_t>(data);
+  auto first = (begin + page_size - 1) & ~(page_size - 1);
+  auto last = (begin + size) & ~(page_size - 1);
+  if (first < last) {
+    madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+  }
+#endif
+}
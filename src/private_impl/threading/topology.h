@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <vector>
+
+namespace Raytracer::Threading {
+/// NUMA nodes of the machine and the cpus of each the process may run on.
+/// Setting RAYTRACER_NUMA_NODES splits these cpus between that many emulated
+/// nodes instead, shared if there are fewer of them, to exercise the placement
+/// of threads and memory on a machine with a single socket. Without NUMA
+/// support there is a single node.
+class Topology
+{
+public:
+  static const Topology& get();
+
+  uint32_t get_node_count() const;
+  const std::vector<uint32_t>& get_cpus(uint32_t node) const;
+  /// Node of a thread among thread_count, each node gets a contiguous range of
+  /// threads in proportion to its cpus
+  uint32_t get_thread_node(uint32_t thread_index, uint32_t thread_count) const;
+  /// Cpu of a thread among thread_count, the threads of a node take its cpus
+  /// in turn
+  uint32_t get_thread_cpu(uint32_t thread_index, uint32_t thread_count) const;
+
+  /// Restrict the calling thread to a cpu, false if the platform cannot
+  bool pin_current_thread(uint32_t cpu) const;
+  /// Let the calling thread run on every cpu of the process again
+  void unpin_current_thread() const;
+  /// Drop the pages entirely within a zeroed buffer, they read as zero again
+  /// and the first thread writing each one places it on its own node
+  static void release_pages(void* data, size_t size);
+
+private:
+  Topology();
+
+  /// Index of the first thread of a node among thread_count
+  uint32_t get_first_thread(uint32_t node, uint32_t thread_count) const;
+
+  std::vector<std::vector<uint32_t>> node_cpus;
+  std::vector<uint32_t> process_cpus;
+};
+} // namespace Raytracer::Threading
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <atomic>
+
+namespace Raytracer::Threading {
+/// Hands the latest of a series of values from one producer thread to one
+/// consumer thread, neither of them ever waiting for the other. The producer
+/// fills the back slot and publishes it in place of the middle one, the
+/// consumer takes the middle slot in place of its front one whenever a newer
+/// value was published, so the values it was too slow for are skipped.
+template<typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer()
+    : slots()
+    , back_index(0)
+    , middle(1)
+    , front_index(2)
+  {}
+  TripleBuffer(const TripleBuffer&) = delete;
+  TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+  /// Slot the producer fills before publishing it
+  T& back() { return slots[back_index]; }
+  void publish()
+  {
+    auto previous =
+      middle.exchange(back_index | fresh_bit, std::memory_order_acq_rel);
+    back_index = previous & index_mask;
+  }
+
+  /// Take the last value published, returns false if the front slot already
+  /// holds it
+  bool update()
+  {
+    if ((middle.load(std::memory_order_relaxed) & fresh_bit) == 0) {
+      return false;
+    }
+    auto previous = middle.exchange(front_index, std::memory_order_acq_rel);
+    front_index = previous & index_mask;
+    return true;
+  }
+  /// Slot the consumer reads
+  const T& front() const { return slots[front_index]; }
+
+private:
+  static constexpr uint8_t index_mask = 0x3;
+  /// Set on the middle index while it holds a value the consumer has not taken
+  static constexpr uint8_t fresh_bit = 0x4;
+
+  std::array<T, 3> slots;
+  uint8_t back_index;
+  std::atomic<uint8_t> middle;
+  uint8_t front_index;
+};
+} // namespace Raytracer::Threading
@@ -0,0 +1,241 @@
+#include "profiler.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using Raytracer::Profiler::ScopedZone;
+
+namespace {
+using clock = std::chrono::steady_clock;
+
+struct Event
+{
+  const char* name;
+  uint64_t start;
+  uint64_t duration;
+};
+
+/// Most recent events of a thread, the oldest are overwritten once it is full
+struct ThreadBuffer
+{
+  static constexpr uint32_t capacity = 1u << 16;
+
+  std::unique_ptr<Event[]> events;
+  /// Events ever recorded, only written by the thread using the buffer
+  std::atomic<uint64_t> count;
+  std::string thread_name;
+  uint32_t thread_id;
+  bool in_use;
+};
+
+struct Registry
+{
+  std::mutex mutex;
+  /// Buffers outlive their threads so their zones can still be dumped, and are
+  /// reused by new threads
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+Registry&
+get_registry()
+{
+  static Registry registry;
+  return registry;
+}
+
+const clock::time_point epoch = clock::now();
+std::atomic<bool> enabled(std::getenv("RAYTRACER_PROFILE") != nullptr);
+
+uint64_t
+now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() -
+                                                              epoch)
+    .count();
+}
+
+/// Buffer of the calling thread, handed back when the thread exits
+class BufferHandle
+{
+public:
+  BufferHandle()
+    : buffer(nullptr)
+    , thread_name()
+  {}
+  ~BufferHandle()
+  {
+    if (buffer) {
+      std::lock_guard<std::mutex> lock(get_registry().mutex);
+      buffer->in_use = false;
+    }
+  }
+  BufferHandle(const BufferHandle&) = delete;
+  BufferHandle& operator=(const BufferHandle&) = delete;
+
+  ThreadBuffer& get()
+  {
+    if (buffer == nullptr) {
+      auto& registry = get_registry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (auto& candidate : registry.buffers) {
+        if (!candidate->in_use) {
+          buffer = candidate.get();
+          break;
+        }
+      }
+      if (buffer == nullptr) {
+        auto& created =
+          registry.buffers.emplace_back(std::make_unique<ThreadBuffer>());
+        created->events =
+          std::make_unique<Event[]>(ThreadBuffer::capacity);
+        created->count.store(0, std::memory_order_relaxed);
+        created->thread_id = static_cast<uint32_t>(registry.buffers.size());
+        buffer = created.get();
+      }
+      buffer->in_use = true;
+      if (!thread_name.empty()) {
+        buffer->thread_name = thread_name;
+      } else {
+        buffer->thread_name = "thread " + std::to_string(buffer->thread_id);
+      }
+    }
+    return *buffer;
+  }
+
+  void set_thread_name(const std::string& name)
+  {
+    thread_name = name;
+    if (buffer) {
+      std::lock_guard<std::mutex> lock(get_registry().mutex);
+      buffer->thread_name = name;
+    }
+  }
+
+private:
+  ThreadBuffer* buffer;
+  std::string thread_name;
+};
+
+thread_local BufferHandle buffer_handle;
+
+void
+write_events(std::ostream& stream, const ThreadBuffer& buffer, bool& first)
+{
+  char line[256];
+  std::snprintf(line,
+                sizeof(line),
+                "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                "\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n",
+                buffer.thread_id,
+                buffer.thread_name.c_str());
+  stream << line;
+  first = false;
+
+  // Copy the events out, then drop those the thread overwrote meanwhile
+  auto count = buffer.count.load(std::memory_order_acquire);
+  auto begin = count > ThreadBuffer::capacity ? count - ThreadBuffer::capacity
+                                              : 0;
+  std::vector<Event> events;
+  events.reserve(count - begin);
+  for (auto i = begin; i < count; ++i) {
+    events.push_back(buffer.events[i % ThreadBuffer::capacity]);
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto count_after = buffer.count.load(std::memory_order_relaxed);
+  auto valid_begin = count_after > ThreadBuffer::capacity
+                       ? count_after - ThreadBuffer::capacity + 1
+                       : 0;
+
+  for (auto i = std::max(begin, valid_begin); i < count; ++i) {
+    auto& event = events[i - begin];
+    std::snprintf(line,
+                  sizeof(line),
+                  ",\n{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+                  "\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+                  event.name,
+                  event.start / 1000.0,
+                  event.duration / 1000.0,
+                  buffer.thread_id);
+    stream << line;
+  }
+}
+} // namespace
+
+bool
+Raytracer::Profiler::is_enabled()
+{
+  return enabled.load(std::memory_order_relaxed);
+}
+
+void
+Raytracer::Profiler::set_enabled(bool value)
+{
+  enabled.store(value, std::memory_order_relaxed);
+}
+
+void
+Raytracer::Profiler::set_thread_name(const std::string& name)
+{
+  buffer_handle.set_thread_name(name);
+}
+
+bool
+Raytracer::Profiler::dump(const std::string& file_name)
+{
+  std::ofstream file(file_name);
+  if (!file) {
+    std::cerr << "Err: Could not open " << file_name << " to write the trace"
+              << std::endl;
+    return false;
+  }
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  bool first = true;
+  {
+    auto& registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (auto& buffer : registry.buffers) {
+      write_events(file, *buffer, first);
+    }
+  }
+  file << "\n]}\n";
+  return static_cast<bool>(file);
+}
+
+bool
+Raytracer::Profiler::dump()
+{
+  auto file_name = std::getenv("RAYTRACER_PROFILE");
+  return dump(file_name && file_name[0] != '\0' ? file_name : "trace.json");
+}
+
+ScopedZone::ScopedZone(const char* _name) noexcept
+  : name(_name)
+  , start(0)
+  , recording(enabled.load(std::memory_order_relaxed))
+{
+  if (recording) {
+    start = now();
+  }
+}
+
+ScopedZone::~ScopedZone()
+{
+  if (!recording) {
+    return;
+  }
+  auto& buffer = buffer_handle.get();
+  auto index = buffer.count.load(std::memory_order_relaxed);
+  buffer.events[index % ThreadBuffer::capacity] =
+    Event{ name, start, now() - start };
+  buffer.count.store(index + 1, std::memory_order_release);
+}
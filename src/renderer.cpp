@@ -1,6 +1,7 @@
 #include "renderer.h"
 
 #include "private_impl/renderers/renderer_gpu.h"
+#include "private_impl/renderers/renderer_path.h"
 #include "private_impl/renderers/renderer_whitted.h"
 
 using namespace Raytracer::Graphics;
@@ -13,6 +14,8 @@ Renderer::create(Type type, SDL_Window* window)
       return std::make_unique<RendererWhitted>(window);
     case Renderer::Type::Gpu:
       return std::make_unique<RendererGpu>(window);
+    case Renderer::Type::Path:
+      return std::make_unique<RendererPath>(window);
   }
   return nullptr;
 }
@@ -1,7 +1,9 @@
 #include "scene.h"
 
 #define _USE_MATH_DEFINES
+#include <atomic>
 #include <cassert>
+#include <functional>
 #include <math.h>
 #include <sdf.h>
 
@@ -25,7 +27,9 @@
 #include "materials/emissive_quadratic_drop_off.h"
 #include "materials/lambert.h"
 #include "materials/metal.h"
-#include "math/vec4.h"
+#include "math/mat3x4.h"
+#include "private_impl/threading/thread_pool.h"
+#include "profiler.h"
 #include "scene_node.h"
 #include "texture.h"
 
@@ -53,6 +57,68 @@ copy_buffer_view(dstT* dst, const uint8_t* src, size_t count)
 }
 } // namespace __details
 
+namespace {
+/// Lists of a scene hold what they own as shared and immutable
+template<typename T>
+std::vector<std::shared_ptr<const T>>
+share(std::vector<std::unique_ptr<T>>&& list)
+{
+  std::vector<std::shared_ptr<const T>> result;
+  result.reserve(list.size());
+  for (auto& item : list) {
+    result.emplace_back(std::move(item));
+  }
+  return result;
+}
+
+void
+report(Scene::LoadProgress* progress, const char* stage, float fraction)
+{
+  if (progress != nullptr) {
+    progress->stage.store(stage, std::memory_order_relaxed);
+    progress->fraction.store(fraction, std::memory_order_relaxed);
+  }
+}
+
+/// Run work once for each index up to count on every thread of the pool,
+/// reporting the fraction of indices done
+void
+parallel_for(Threading::ThreadPool& pool,
+             uint32_t count,
+             Scene::LoadProgress* progress,
+             const std::function<void(uint32_t index)>& work)
+{
+  std::atomic<uint32_t> next(0);
+  std::atomic<uint32_t> done(0);
+  pool.run([&](uint32_t) {
+    for (auto i = next++; i < count; i = next++) {
+      work(i);
+      auto finished = ++done;
+      if (progress != nullptr) {
+        progress->fraction.store(static_cast<float>(finished) / count,
+                                 std::memory_order_relaxed);
+      }
+    }
+  });
+}
+
+/// Images are only decoded once the whole file is parsed, on every thread
+bool
+keep_encoded_image(tinygltf::Image* image,
+                   const int,
+                   std::string*,
+                   std::string*,
+                   int,
+                   int,
+                   const unsigned char* bytes,
+                   int size,
+                   void*)
+{
+  image->image.assign(bytes, bytes + size);
+  return true;
+}
+} // namespace
+
 template<typename desT>
 void
 copy_buffer_view(desT* dst,
@@ -92,9 +158,12 @@ copy_buffer_view(desT* dst,
 }
 
 std::unique_ptr<Scene>
-Scene::load_from_gltf(const std::string& file_name)
+Scene::load_from_gltf(const std::string& file_name, LoadProgress* progress)
 {
+  auto zone = Profiler::ScopedZone("Scene::load_from_gltf");
+  report(progress, "Parsing glTF", 0.0f);
   tinygltf::TinyGLTF loader;
+  loader.SetImageLoader(keep_encoded_image, nullptr);
   tinygltf::Model gltf;
   std::string err;
   std::string warn;
@@ -130,6 +199,37 @@ Scene::load_from_gltf(const std::string& file_name)
     return nullptr;
   }
 
+  Threading::ThreadPool workers;
+
+  report(progress, "Decoding textures", 0.0f);
+  std::atomic<bool> images_decoded(true);
+  parallel_for(
+    workers,
+    static_cast<uint32_t>(gltf.images.size()),
+    progress,
+    [&gltf, &images_decoded](uint32_t i) {
+      auto& image = gltf.images[i];
+      auto encoded = std::move(image.image);
+      image.image.clear();
+      std::string image_err;
+      std::string image_warn;
+      if (!tinygltf::LoadImageData(&image,
+                                   static_cast<int>(i),
+                                   &image_err,
+                                   &image_warn,
+                                   0,
+                                   0,
+                                   encoded.data(),
+                                   static_cast<int>(encoded.size()),
+                                   nullptr)) {
+        std::cerr << "Err: " << image_err << std::endl;
+        images_decoded = false;
+      }
+    });
+  if (!images_decoded) {
+    return nullptr;
+  }
+
   std::vector<std::unique_ptr<Texture>> textures;
   std::vector<std::unique_ptr<Material>> materials;
   std::vector<std::unique_ptr<Object>> meshes;
@@ -145,16 +245,15 @@ Scene::load_from_gltf(const std::string& file_name)
       vec3(1.0f, 1.0f, 1.0f), static_cast<uint16_t>(0))); // 0
     use_default_material = true;
   } else {
-    for (auto& t : gltf.textures) {
-      if (!t.name.empty()) {
-        // std::printf("glTF loader: Loading texture %s\n", t.name.c_str());
-      }
-      auto& image = gltf.images[t.source];
-      if (!image.name.empty()) {
-        // std::printf("glTF loader: Loading image %s\n", t.name.c_str());
-      }
-      textures.emplace_back(Texture::load_from_gltf_image(image));
-    }
+    report(progress, "Converting textures", 0.0f);
+    textures.resize(gltf.textures.size());
+    parallel_for(workers,
+                 static_cast<uint32_t>(gltf.textures.size()),
+                 progress,
+                 [&gltf, &textures](uint32_t i) {
+                   auto& image = gltf.images[gltf.textures[i].source];
+                   textures[i] = Texture::load_from_gltf_image(image);
+                 });
     for (auto& m : gltf.materials) {
       if (!m.name.empty()) {
         // std::printf("glTF loader: Loading material %s\n", m.name.c_str());
@@ -180,6 +279,10 @@ Scene::load_from_gltf(const std::string& file_name)
 
   bool found_lights = false;
   std::vector<std::unique_ptr<Object>> light_list;
+  std::vector<std::vector<std::shared_ptr<const TriangleMesh>>> mesh_blas(
+    gltf.meshes.size());
+  // Bvhs are built together once every mesh is read
+  std::vector<TriangleMesh*> unbuilt_meshes;
 
   // Construct scene graph
   std::vector<SceneNode> nodes;
@@ -205,51 +308,36 @@ Scene::load_from_gltf(const std::string& file_name)
 
   for (auto [i, ancestor_ids] : bfs_gltf_nodes) {
 
-    mat4 matrix;
+    mat3x4 matrix;
     // TODO Full scene graph is necessary to do this properly
     ancestor_ids.push_back(i);
     for (auto p : ancestor_ids) {
       auto& parent_node = gltf.nodes[p];
       if (!parent_node.matrix.empty()) {
         matrix = dot(matrix,
-                     mat4(static_cast<float>(parent_node.matrix[0]),
-                          static_cast<float>(parent_node.matrix[4]),
-                          static_cast<float>(parent_node.matrix[8]),
-                          static_cast<float>(parent_node.matrix[12]),
-                          static_cast<float>(parent_node.matrix[1]),
-                          static_cast<float>(parent_node.matrix[5]),
-                          static_cast<float>(parent_node.matrix[9]),
-                          static_cast<float>(parent_node.matrix[13]),
-                          static_cast<float>(parent_node.matrix[2]),
-                          static_cast<float>(parent_node.matrix[6]),
-                          static_cast<float>(parent_node.matrix[10]),
-                          static_cast<float>(parent_node.matrix[14]),
-                          static_cast<float>(parent_node.matrix[3]),
-                          static_cast<float>(parent_node.matrix[7]),
-                          static_cast<float>(parent_node.matrix[11]),
-                          static_cast<float>(parent_node.matrix[15])));
+                     mat3x4::from_column_major(parent_node.matrix.data()));
       } else {
-        Transform transform;
+        vec3 translation;
+        quat rotation{ 0.0f, 0.0f, 0.0f, 1.0f };
+        vec3 scale(1.0f, 1.0f, 1.0f);
         if (!parent_node.translation.empty()) {
-          transform.translation =
-            vec3(static_cast<float>(parent_node.translation[0]),
-                 static_cast<float>(parent_node.translation[1]),
-                 static_cast<float>(parent_node.translation[2]));
+          translation = vec3(static_cast<float>(parent_node.translation[0]),
+                             static_cast<float>(parent_node.translation[1]),
+                             static_cast<float>(parent_node.translation[2]));
         }
         if (!parent_node.rotation.empty()) {
-          transform.rotation =
-            quat{ static_cast<float>(parent_node.rotation[0]),
-                  static_cast<float>(parent_node.rotation[1]),
-                  static_cast<float>(parent_node.rotation[2]),
-                  static_cast<float>(parent_node.rotation[3]) };
+          rotation = quat{ static_cast<float>(parent_node.rotation[0]),
+                           static_cast<float>(parent_node.rotation[1]),
+                           static_cast<float>(parent_node.rotation[2]),
+                           static_cast<float>(parent_node.rotation[3]) };
         }
         if (!parent_node.scale.empty()) {
-          transform.scale =
-            static_cast<float>(parent_node.scale[0] + parent_node.scale[1] +
-                               parent_node.scale[2]) /
-            3.0f;
+          scale = vec3(static_cast<float>(parent_node.scale[0]),
+                       static_cast<float>(parent_node.scale[1]),
+                       static_cast<float>(parent_node.scale[2]));
         }
-        matrix = dot(matrix, transform.matrix());
+        matrix =
+          dot(matrix, mat3x4::from_trs(translation, rotation, scale));
       }
     }
 
@@ -299,10 +387,8 @@ Scene::load_from_gltf(const std::string& file_name)
         gltf.cameras[gltf_node.camera].type == "perspective" && !found_camera) {
       node.type = SceneNode::Type::Camera;
 
-      auto origin4 = dot(matrix, vec4(0, 0, 0, 1));
-      auto direction4 = dot(matrix, vec4(0, 0, -1, 0));
-      auto origin = vec3(origin4.e[0], origin4.e[1], origin4.e[2]);
-      auto direction = vec3(direction4.e[0], direction4.e[1], direction4.e[2]);
+      auto origin = transform_point(matrix, vec3(0, 0, 0));
+      auto direction = transform_vector(matrix, vec3(0, 0, -1));
       direction.make_unit_vector();
       auto up = vec3(0, 1, 0);
       auto& gltf_camera = gltf.cameras[gltf_node.camera].perspective;
@@ -322,7 +408,7 @@ Scene::load_from_gltf(const std::string& file_name)
       if (light_id >= 0) {
         auto& light = gltf.lights[light_id];
 
-        vec4 position = dot(matrix, vec4(0, 0, 0, 1));
+        auto position = transform_point(matrix, vec3(0, 0, 0));
 
         materials.emplace_back(std::make_unique<EmissiveQuadraticDropOff>(
           static_cast<float>(light.intensity) *
@@ -331,113 +417,121 @@ Scene::load_from_gltf(const std::string& file_name)
                  static_cast<float>(light.color[2])),
           1.0f));
         light_list.emplace_back(std::make_unique<Point>(
-          vec3(position.e[0], position.e[1], position.e[2]),
-          static_cast<uint16_t>(materials.size() - 1)));
+          position, static_cast<uint16_t>(materials.size() - 1)));
 
         found_lights = true;
       }
     } else if (gltf_node.mesh >= 0) {
       auto& gltf_mesh = gltf.meshes[gltf_node.mesh];
+      auto& blas = mesh_blas[gltf_node.mesh];
       // TODO Support multiple primitives
       if (!gltf_mesh.primitives.empty()) {
         node.type = SceneNode::Type::Mesh;
         node.mesh_id = static_cast<uint32_t>(meshes.size());
 
-        for (auto& gltf_primitive : gltf_mesh.primitives) {
-          // Indices
-          std::vector<uint16_t> indices;
-          {
-            auto& accessor = gltf.accessors[gltf_primitive.indices];
-            auto& buffer_view = gltf.bufferViews[accessor.bufferView];
-            auto& buffer = gltf.buffers[buffer_view.buffer];
-            indices.resize(accessor.count);
-            auto offset = buffer_view.byteOffset + accessor.byteOffset;
-            copy_buffer_view(indices.data(),
-                             buffer.data.data() + offset,
-                             indices.size(),
-                             accessor.componentType);
-          }
-
-          // Positions
-          std::vector<vec3> positions;
-          {
-            auto& accessor =
-              gltf.accessors[gltf_primitive.attributes["POSITION"]];
-            assert(accessor.type == TINYGLTF_TYPE_VEC3);
-            auto& buffer_view = gltf.bufferViews[accessor.bufferView];
-            auto& buffer = gltf.buffers[buffer_view.buffer];
-            positions.resize(accessor.count);
-            auto offset = buffer_view.byteOffset + accessor.byteOffset;
-            copy_buffer_view(positions.data(),
-                             buffer.data.data() + offset,
-                             positions.size(),
-                             accessor.componentType);
-          }
-
-          // UV
-          std::vector<vec2> uv;
-          {
-            auto& accessor =
-              gltf.accessors[gltf_primitive.attributes["TEXCOORD_0"]];
-            assert(accessor.type == TINYGLTF_TYPE_VEC2);
-            auto& buffer_view = gltf.bufferViews[accessor.bufferView];
-            auto& buffer = gltf.buffers[buffer_view.buffer];
-            uv.resize(accessor.count);
-            auto offset = buffer_view.byteOffset + accessor.byteOffset;
-            copy_buffer_view(uv.data(),
-                             buffer.data.data() + offset,
-                             uv.size(),
-                             accessor.componentType);
-          }
-          // Normals
-          std::vector<vec3> normals;
-          {
-            auto& accessor =
-              gltf.accessors[gltf_primitive.attributes["NORMAL"]];
-            assert(accessor.type == TINYGLTF_TYPE_VEC3);
-            auto& buffer_view = gltf.bufferViews[accessor.bufferView];
-            auto& buffer = gltf.buffers[buffer_view.buffer];
-            normals.resize(accessor.count);
-            auto offset = buffer_view.byteOffset + accessor.byteOffset;
-            copy_buffer_view(normals.data(),
-                             buffer.data.data() + offset,
-                             normals.size(),
-                             accessor.componentType);
-          }
-
-          assert(uv.size() == normals.size());
-          std::vector<MeshVertexData> data;
-          data.resize(uv.size());
-          for (uint32_t j = 0; j < uv.size(); ++j) {
-            data[j].uv = uv[j];
-            data[j].normal = normals[j];
-            data[j].tangent =
-              cross(data[j].normal,
-                    vec3(0, 1, 0)); // FIXME: This is not a good approximation
-          }
-
-          for (auto& p : positions) {
-            auto moved = dot(matrix, vec4(p.e[0], p.e[1], p.e[2], 1.0f));
-            p.e[0] = moved.e[0];
-            p.e[1] = moved.e[1];
-            p.e[2] = moved.e[2];
-          }
-
-          uint16_t material = 0;
-          if (gltf_primitive.material >= 0) {
-            material = static_cast<uint16_t>(gltf_primitive.material);
+        // Geometry and its bvh are built once in the space of the glTF mesh,
+        // every node referencing it gets an instance
+        if (blas.empty()) {
+          for (auto& gltf_primitive : gltf_mesh.primitives) {
+            // Indices
+            std::vector<uint16_t> indices;
+            {
+              auto& accessor = gltf.accessors[gltf_primitive.indices];
+              auto& buffer_view = gltf.bufferViews[accessor.bufferView];
+              auto& buffer = gltf.buffers[buffer_view.buffer];
+              indices.resize(accessor.count);
+              auto offset = buffer_view.byteOffset + accessor.byteOffset;
+              copy_buffer_view(indices.data(),
+                               buffer.data.data() + offset,
+                               indices.size(),
+                               accessor.componentType);
+            }
+
+            // Positions
+            std::vector<vec3> positions;
+            {
+              auto& accessor =
+                gltf.accessors[gltf_primitive.attributes["POSITION"]];
+              assert(accessor.type == TINYGLTF_TYPE_VEC3);
+              auto& buffer_view = gltf.bufferViews[accessor.bufferView];
+              auto& buffer = gltf.buffers[buffer_view.buffer];
+              positions.resize(accessor.count);
+              auto offset = buffer_view.byteOffset + accessor.byteOffset;
+              copy_buffer_view(positions.data(),
+                               buffer.data.data() + offset,
+                               positions.size(),
+                               accessor.componentType);
+            }
+
+            // UV
+            std::vector<vec2> uv;
+            {
+              auto& accessor =
+                gltf.accessors[gltf_primitive.attributes["TEXCOORD_0"]];
+              assert(accessor.type == TINYGLTF_TYPE_VEC2);
+              auto& buffer_view = gltf.bufferViews[accessor.bufferView];
+              auto& buffer = gltf.buffers[buffer_view.buffer];
+              uv.resize(accessor.count);
+              auto offset = buffer_view.byteOffset + accessor.byteOffset;
+              copy_buffer_view(uv.data(),
+                               buffer.data.data() + offset,
+                               uv.size(),
+                               accessor.componentType);
+            }
+            // Normals
+            std::vector<vec3> normals;
+            {
+              auto& accessor =
+                gltf.accessors[gltf_primitive.attributes["NORMAL"]];
+              assert(accessor.type == TINYGLTF_TYPE_VEC3);
+              auto& buffer_view = gltf.bufferViews[accessor.bufferView];
+              auto& buffer = gltf.buffers[buffer_view.buffer];
+              normals.resize(accessor.count);
+              auto offset = buffer_view.byteOffset + accessor.byteOffset;
+              copy_buffer_view(normals.data(),
+                               buffer.data.data() + offset,
+                               normals.size(),
+                               accessor.componentType);
+            }
+
+            assert(uv.size() == normals.size());
+            std::vector<MeshVertexData> data;
+            data.resize(uv.size());
+            for (uint32_t j = 0; j < uv.size(); ++j) {
+              data[j].uv = uv[j];
+              data[j].normal = normals[j];
+              // FIXME: This is not a good approximation
+              data[j].tangent = cross(data[j].normal, vec3(0, 1, 0));
+            }
+
+            uint16_t material = 0;
+            if (gltf_primitive.material >= 0) {
+              material = static_cast<uint16_t>(gltf_primitive.material);
+            }
+            auto mesh = std::make_shared<TriangleMesh>(std::move(positions),
+                                                       std::move(data),
+                                                       std::move(indices),
+                                                       material);
+            unbuilt_meshes.emplace_back(mesh.get());
+            blas.emplace_back(std::move(mesh));
           }
-          auto mesh = std::make_unique<TriangleMesh>(std::move(positions),
-                                                     std::move(data),
-                                                     std::move(indices),
-                                                     material);
-          mesh->build_bvh();
-          meshes.emplace_back(std::move(mesh));
+        }
+        for (auto& primitive : blas) {
+          meshes.emplace_back(
+            std::make_unique<Instance>(primitive, primitive->aabb, matrix));
         }
       }
     }
   }
 
+  report(progress, "Building BVHs", 0.0f);
+  parallel_for(workers,
+               static_cast<uint32_t>(unbuilt_meshes.size()),
+               progress,
+               [&unbuilt_meshes](uint32_t i) {
+                 unbuilt_meshes[i]->build_bvh();
+               });
+
   // Default light
   if (!found_lights) {
     // Lights
@@ -490,6 +584,7 @@ Scene::load_from_gltf(const std::string& file_name)
 std::unique_ptr<Scene>
 Scene::load_whitted_scene()
 {
+  auto zone = Profiler::ScopedZone("Scene::load_whitted_scene");
   std::vector<std::unique_ptr<Texture>> textures;
   textures.emplace_back(Texture::load_from_file("whitted_floor.png")); // 0
   std::vector<std::unique_ptr<Material>> materials;
@@ -548,9 +643,11 @@ Scene::load_whitted_scene()
 }
 
 std::unique_ptr<Scene>
-Scene::load_cornell_box()
+Scene::load_cornell_box(LoadProgress* progress)
 {
-  auto duck_scene = load_from_gltf("Duck.gltf");
+  auto zone = Profiler::ScopedZone("Scene::load_cornell_box");
+  auto duck_scene = load_from_gltf("Duck.gltf", progress);
+  report(progress, "Loading textures", 0.0f);
 
   std::vector<std::unique_ptr<Texture>> textures;
   std::vector<std::unique_ptr<Material>> materials;
@@ -584,17 +681,26 @@ Scene::load_cornell_box()
 
   std::vector<std::unique_ptr<Object>> list;
 
-  auto duck_mesh = duck_scene->get_world()[0]->copy();
-  auto duck_mesh_typed = dynamic_cast<TriangleMesh*>(duck_mesh.get());
-  duck_mesh_typed->mat_id = 0;
-  for (auto& p : duck_mesh_typed->positions) {
-    std::swap(p.e[0], p.e[2]);
-    p.e[1] -= 130.0f;
-    p.e[2] -= 300.0f;
-    p /= 128.0f;
-  }
-  duck_mesh_typed->build_bvh();
-  list.emplace_back(std::move(duck_mesh));
+  // Swap x and z, move down and back and scale the duck to the box
+  auto duck = dynamic_cast<const Instance*>(duck_scene->get_world()[0].get());
+  constexpr float duck_scale = 1.0f / 128.0f;
+  mat3x4 duck_transform(0.0f,
+                        0.0f,
+                        duck_scale,
+                        0.0f,
+                        0.0f,
+                        duck_scale,
+                        0.0f,
+                        -130.0f * duck_scale,
+                        duck_scale,
+                        0.0f,
+                        0.0f,
+                        -300.0f * duck_scale);
+  list.emplace_back(
+    std::make_unique<Instance>(duck->blas,
+                               duck->blas_bounds,
+                               dot(duck_transform, duck->object_to_world),
+                               static_cast<uint16_t>(0)));
 
   list.emplace_back(std::make_unique<Sphere>(
     vec3(1.5f, -0.5f, -2), 0.5f, static_cast<uint16_t>(3)));
@@ -697,6 +803,7 @@ Scene::load_cornell_box()
 std::unique_ptr<Scene>
 Scene::load_mandrelbulb()
 {
+  auto zone = Profiler::ScopedZone("Scene::load_mandrelbulb");
   std::vector<std::unique_ptr<Texture>> textures;
   std::vector<std::unique_ptr<Material>> materials;
   materials.emplace_back(std::make_unique<Lambert>(
@@ -785,12 +892,89 @@ Scene::Scene(std::vector<SceneNode>&& nodes,
   , max_secondary_rays(max_secondary_rays)
   , nodes(std::move(nodes))
   , camera_index(camera_index)
-  , textures(std::move(textures))
-  , materials(std::move(materials))
-  , world_objects(std::move(world_objects))
-  , lights(std::move(lights))
+  , textures(share(std::move(textures)))
+  , materials(share(std::move(materials)))
+  , world_objects(share(std::move(world_objects)))
+  , lights(share(std::move(lights)))
+  , geometry_version(0)
 {}
 
+std::shared_ptr<const Scene>
+Scene::replicate(Replicas& replicas) const
+{
+  auto zone = Profiler::ScopedZone("Scene::replicate");
+  Replicas current;
+  auto replica = [&replicas, &current](const auto& original, auto&& copy) {
+    using T = typename std::decay_t<decltype(original)>::element_type;
+    auto key = static_cast<const void*>(original.get());
+    auto found = current.copies.find(key);
+    if (found == current.copies.end()) {
+      std::shared_ptr<const void> copied;
+      auto previous = replicas.copies.find(key);
+      if (previous != replicas.copies.end()) {
+        copied = previous->second.second;
+      } else {
+        copied = copy(*original);
+      }
+      found = current.copies.emplace(key, std::make_pair(original, copied))
+                .first;
+    }
+    return std::static_pointer_cast<const T>(found->second.second);
+  };
+  // Instances of a mesh share its copy like they share the mesh
+  auto copy_object =
+    [&replica](const Object& object) -> std::shared_ptr<const Object> {
+    if (auto instance = dynamic_cast<const Instance*>(&object)) {
+      auto copied = std::make_shared<Instance>(*instance);
+      copied->blas = replica(instance->blas, [](const Object& blas) {
+        return std::shared_ptr<const Object>(blas.copy());
+      });
+      return copied;
+    }
+    return object.copy();
+  };
+
+  auto scene = std::shared_ptr<Scene>(new Scene(*this));
+  for (auto& texture : scene->textures) {
+    texture = replica(texture, [](const Texture& original) {
+      return std::make_shared<const Texture>(original);
+    });
+  }
+  for (auto& object : scene->world_objects) {
+    object = replica(object, copy_object);
+  }
+  for (auto& light : scene->lights) {
+    light = replica(light, copy_object);
+  }
+  replicas = std::move(current);
+  return scene;
+}
+
+Scene::Scene(const Scene& other)
+  : min_attenuation_magnitude(other.min_attenuation_magnitude)
+  , max_secondary_rays(other.max_secondary_rays)
+  , nodes(other.nodes.size())
+  , camera_index(other.camera_index)
+  , textures(other.textures)
+  , materials(other.materials)
+  , world_objects(other.world_objects)
+  , lights(other.lights)
+  , geometry_version(other.geometry_version)
+{
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    auto& node = nodes[i];
+    auto& other_node = other.nodes[i];
+    node.local_trs = other_node.local_trs;
+    node.children_id_offset = other_node.children_id_offset;
+    node.children_id_length = other_node.children_id_length;
+    node.type = other_node.type;
+    node.mesh_id = other_node.mesh_id;
+    if (other_node.camera) {
+      node.camera = std::make_unique<Camera>(*other_node.camera);
+    }
+  }
+}
+
 Scene::~Scene() = default;
 
 void
@@ -801,6 +985,13 @@ Scene::run(float width, float height)
   camera.set_aspect(width / height);
 }
 
+std::shared_ptr<const Scene>
+Scene::snapshot() const
+{
+  auto zone = Profiler::ScopedZone("Scene::snapshot");
+  return std::shared_ptr<const Scene>(new Scene(*this));
+}
+
 Camera&
 Scene::get_camera()
 {
@@ -817,13 +1008,13 @@ Scene::get_camera() const
   return *nodes[camera_index].camera;
 }
 
-const std::vector<std::unique_ptr<Object>>&
+const std::vector<std::shared_ptr<const Object>>&
 Scene::get_world() const
 {
   return world_objects;
 }
 
-std::vector<std::unique_ptr<Object>>&
+std::vector<std::shared_ptr<const Object>>&
 Scene::get_world()
 {
   return world_objects;
@@ -835,32 +1026,50 @@ Scene::get_material(uint16_t id) const
   return *materials[id];
 }
 
-const std::vector<std::unique_ptr<Material>>&
+const std::vector<std::shared_ptr<const Material>>&
 Scene::get_material_list() const
 {
   return materials;
 }
 
-std::vector<std::unique_ptr<Material>>&
+std::vector<std::shared_ptr<const Material>>&
 Scene::get_material_list()
 {
   return materials;
 }
 
-const std::vector<std::unique_ptr<Object>>&
+const std::vector<std::shared_ptr<const Object>>&
 Scene::get_lights() const
 {
   return lights;
 }
 
-std::vector<std::unique_ptr<Object>>&
+std::vector<std::shared_ptr<const Object>>&
 Scene::get_lights()
 {
   return lights;
 }
 
+uint32_t
+Scene::get_geometry_version() const
+{
+  return geometry_version;
+}
+
+void
+Scene::mark_geometry_changed()
+{
+  geometry_version++;
+}
+
 const Texture&
 Scene::get_texture(uint16_t id) const
 {
   return *textures[id];
 }
+
+bool
+Scene::has_textures() const
+{
+  return !textures.empty();
+}
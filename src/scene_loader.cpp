@@ -0,0 +1,94 @@
+#include "scene_loader.h"
+
+#include <iostream>
+
+#include "profiler.h"
+
+using namespace Raytracer;
+
+SceneLoader::SceneLoader()
+  : thread()
+  , name()
+  , progress()
+  , loading(false)
+  , loaded_scene()
+{}
+
+SceneLoader::~SceneLoader()
+{
+  if (thread.joinable()) {
+    thread.join();
+  }
+}
+
+bool
+SceneLoader::load(const std::string& scene_name)
+{
+  if (loading.load(std::memory_order_acquire)) {
+    return false;
+  }
+  if (thread.joinable()) {
+    thread.join();
+  }
+  name = scene_name;
+  progress.stage.store("", std::memory_order_relaxed);
+  progress.fraction.store(0.0f, std::memory_order_relaxed);
+  loaded_scene.reset();
+  loading.store(true, std::memory_order_relaxed);
+  thread = std::thread([this]() {
+    Profiler::set_thread_name("scene loader");
+    auto zone = Profiler::ScopedZone("SceneLoader::load");
+    std::unique_ptr<Scene> scene;
+    if (name == "cornell") {
+      scene = Scene::load_cornell_box(&progress);
+    } else if (name == "whitted") {
+      scene = Scene::load_whitted_scene();
+    } else if (name == "mandelbulb") {
+      scene = Scene::load_mandrelbulb();
+    } else {
+      scene = Scene::load_from_gltf(name, &progress);
+    }
+    if (!scene) {
+      std::cerr << "Err: Failed to load " << name << std::endl;
+    }
+    loaded_scene = std::move(scene);
+    loading.store(false, std::memory_order_release);
+  });
+  return true;
+}
+
+bool
+SceneLoader::is_loading() const
+{
+  return loading.load(std::memory_order_acquire);
+}
+
+const std::string&
+SceneLoader::get_name() const
+{
+  return name;
+}
+
+const char*
+SceneLoader::get_stage() const
+{
+  return progress.stage.load(std::memory_order_relaxed);
+}
+
+float
+SceneLoader::get_progress() const
+{
+  return progress.fraction.load(std::memory_order_relaxed);
+}
+
+std::unique_ptr<Scene>
+SceneLoader::take()
+{
+  if (loading.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  if (thread.joinable()) {
+    thread.join();
+  }
+  return std::move(loaded_scene);
+}
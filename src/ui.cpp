@@ -19,8 +19,11 @@
 #include "materials/lambert.h"
 #include "materials/material.h"
 #include "materials/metal.h"
+#include "math/fast_math.h"
+#include "profiler.h"
 #include "renderer.h"
 #include "scene.h"
+#include "scene_loader.h"
 
 using namespace Raytracer;
 using namespace Raytracer::Math;
@@ -42,6 +45,7 @@ Ui::Ui(SDL_Window* window)
 
 void
 Ui::run(std::unique_ptr<Scene>& scene,
+        SceneLoader& scene_loader,
         Graphics::Renderer& renderer,
         const std::vector<std::pair<std::string, float>>& renderer_metrics,
         std::chrono::microseconds& dt)
@@ -52,7 +56,14 @@ Ui::run(std::unique_ptr<Scene>& scene,
 
   ImGui::BeginMainMenuBar();
   std::map<std::string, std::vector<float>> graphs_map;
+  std::vector<std::pair<std::string, float>> stats;
   for (auto [format, value] : renderer_metrics) {
+    if (format.rfind("[STAT] ", 0) == 0) {
+      if (show_stats) {
+        stats.emplace_back(format.substr(7), value);
+      }
+      continue;
+    }
     if (format.find("[GRAPH") != std::string::npos) {
       if (show_stats) {
         auto title_start = format.find("] ");
@@ -71,8 +82,11 @@ Ui::run(std::unique_ptr<Scene>& scene,
   }
   ImGui::EndMainMenuBar();
 
-  if (!graphs_map.empty()) {
+  if (!graphs_map.empty() || !stats.empty()) {
     if (ImGui::Begin("Stats"), &show_stats) {
+      for (auto [format, value] : stats) {
+        ImGui::Text(format.c_str(), value);
+      }
       for (auto [title, values] : graphs_map) {
         ImGui::PlotHistogram(title.c_str(), values.data(), (int)values.size());
       }
@@ -112,9 +126,23 @@ Ui::run(std::unique_ptr<Scene>& scene,
     }
     ImGui::SameLine();
     ImGui::Checkbox("Show stats", &show_stats);
+    {
+      bool fast_math = transcendental_accuracy == Accuracy::Fast;
+      ImGui::Checkbox("Fast transcendental math", &fast_math);
+      transcendental_accuracy = fast_math ? Accuracy::Fast : Accuracy::Exact;
+    }
     if (!debug_textures.empty()) {
       ImGui::Checkbox("Show Intermediate Textures", &show_textures);
     }
+    {
+      bool record_trace = Profiler::is_enabled();
+      ImGui::Checkbox("Record trace", &record_trace);
+      Profiler::set_enabled(record_trace);
+      ImGui::SameLine();
+      if (ImGui::Button("Dump trace")) {
+        Profiler::dump();
+      }
+    }
 
     int recursion_depth = renderer.get_recursion_depth();
     ImGui::InputInt("Max recursion depth", &recursion_depth);
@@ -122,48 +150,68 @@ Ui::run(std::unique_ptr<Scene>& scene,
       renderer.set_recursion_depth((uint8_t)recursion_depth);
     }
 
-    // ImGui::Text("Load Scene");
-    // if (ImGui::Button("Whitted")) {
-    //   SDL_SetWindowSize(window, 512, 512);
-    //   scene = Scene::load_whitted_scene();
-    // }
-    // ImGui::SameLine();
-    // if (ImGui::Button("Cornel Box")) {
-    //   scene = Scene::load_cornell_box();
-    // }
-    // if (ImGui::Button("Mandrelbulb")) {
-    //   scene = Scene::load_mandrelbulb();
-    // }
-    // ImGui::Text("Load glTF Scene");
-    // if (ImGui::Button("BoxTextured.gltf")) {
-    //   scene = Scene::load_from_gltf("BoxTextured.gltf");
-    //   renderer.set_debug_data(10);
-    // }
-    // if (ImGui::IsItemHovered()) {
-    //   ImGui::SetTooltip("12 triangles");
-    // }
-    // if (ImGui::Button("Duck.gltf")) {
-    //   scene = Scene::load_from_gltf("Duck.gltf");
-    //   renderer.set_debug_data(100);
-    // }
-    // if (ImGui::IsItemHovered()) {
-    //   ImGui::SetTooltip("4,212 triangles");
-    // }
-    // if (ImGui::Button("DamagedHelmet.gltf")) {
-    //   scene = Scene::load_from_gltf("DamagedHelmet.gltf");
-    //   renderer.set_debug_data(100);
-    // }
-    // if (ImGui::IsItemHovered()) {
-    //   ImGui::SetTooltip("15,452 triangles");
-    // }
-    // if (ImGui::Button("Sponza.gltf")) {
-    //   scene = Scene::load_from_gltf("Sponza.gltf");
-    //   renderer.set_debug_data(50000);
-    // }
-    // if (ImGui::IsItemHovered()) {
-    //   ImGui::SetTooltip("785,900 triangles");
-    // }
-    if (ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
+    if (renderer.get_thread_count() > 0) {
+      int thread_count = static_cast<int>(renderer.get_thread_count());
+      ImGui::InputInt("Render threads", &thread_count);
+      if (thread_count > 0 && thread_count <= 256) {
+        renderer.set_thread_count(static_cast<uint32_t>(thread_count));
+      }
+      bool asynchronous = renderer.get_asynchronous();
+      ImGui::Checkbox("Render asynchronously", &asynchronous);
+      if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Trace frames in the background and keep the\n"
+                          "interface responsive however long they take");
+      }
+      renderer.set_asynchronous(asynchronous);
+    }
+
+    ImGui::Text("Load Scene");
+    if (ImGui::Button("Whitted") && scene_loader.load("whitted")) {
+      SDL_SetWindowSize(window, 512, 512);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cornel Box")) {
+      scene_loader.load("cornell");
+    }
+    if (ImGui::Button("Mandrelbulb")) {
+      scene_loader.load("mandelbulb");
+    }
+    ImGui::Text("Load glTF Scene");
+    if (ImGui::Button("BoxTextured.gltf") &&
+        scene_loader.load("BoxTextured.gltf")) {
+      renderer.set_debug_data(10);
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip("12 triangles");
+    }
+    if (ImGui::Button("Duck.gltf") && scene_loader.load("Duck.gltf")) {
+      renderer.set_debug_data(100);
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip("4,212 triangles");
+    }
+    if (ImGui::Button("DamagedHelmet.gltf") &&
+        scene_loader.load("DamagedHelmet.gltf")) {
+      renderer.set_debug_data(100);
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip("15,452 triangles");
+    }
+    if (ImGui::Button("Sponza.gltf") && scene_loader.load("Sponza.gltf")) {
+      renderer.set_debug_data(50000);
+    }
+    if (ImGui::IsItemHovered()) {
+      ImGui::SetTooltip("785,900 triangles");
+    }
+    // The scene shown keeps rendering until the one loading replaces it
+    if (scene_loader.is_loading()) {
+      ImGui::Text("Loading %s: %s",
+                  scene_loader.get_name().c_str(),
+                  scene_loader.get_stage());
+      ImGui::ProgressBar(scene_loader.get_progress());
+    }
+    if (scene &&
+        ImGui::CollapsingHeader("Camera", ImGuiTreeNodeFlags_DefaultOpen)) {
       ImGui::Text("Use WASD to move the camera and\n"
                   "Arrow keys for Panning and Tilting.\n"
                   "The shift key increases speed and\n"
@@ -199,48 +247,79 @@ Ui::run(std::unique_ptr<Scene>& scene,
         camera.calculate_camera();
       }
     }
-    if (ImGui::CollapsingHeader("Materials")) {
+    if (scene && ImGui::CollapsingHeader("Materials")) {
+      // Materials are shared with the snapshots being rendered, an edit
+      // replaces one with an edited copy. Fields are edited on the stack, the
+      // copy is only allocated once one of them changed
       auto& material_list = scene->get_material_list();
       uint32_t i = 0;
-      std::vector<std::vector<std::unique_ptr<Material>>::iterator>
+      std::vector<std::vector<std::shared_ptr<const Material>>::iterator>
         remove_index;
       for (auto itr = material_list.begin(); itr < material_list.end(); ++itr) {
-        auto& light = *itr;
-        if (light) {
+        auto& material = *itr;
+        if (material) {
           ImGui::PushID(i);
-          if (dynamic_cast<Dielectric*>(light.get())) {
+          std::unique_ptr<Material> edited;
+          bool changed = false;
+          if (dynamic_cast<const Dielectric*>(material.get())) {
             ImGui::Text("%u. Dielectric", i);
-          } else if (auto emissive = dynamic_cast<Emissive*>(light.get())) {
+          } else if (auto emissive =
+                       dynamic_cast<const Emissive*>(material.get())) {
             ImGui::Text("%u. Emissive (No Drop Off)", i);
-            ImGui::InputFloat3("albedo",
-                               reinterpret_cast<float*>(&emissive->albedo));
-          } else if (auto linear =
-                       dynamic_cast<EmissiveLinearDropOff*>(light.get())) {
+            auto copy = *emissive;
+            changed |= ImGui::InputFloat3(
+              "albedo", reinterpret_cast<float*>(&copy.albedo));
+            if (changed) {
+              edited = std::make_unique<Emissive>(copy);
+            }
+          } else if (auto linear = dynamic_cast<const EmissiveLinearDropOff*>(
+                       material.get())) {
             ImGui::Text("%u. Emissive (Linear Drop Off)", i);
-            ImGui::InputFloat3("albedo",
-                               reinterpret_cast<float*>(&linear->albedo));
-            ImGui::InputFloat(
+            auto copy = *linear;
+            changed |= ImGui::InputFloat3(
+              "albedo", reinterpret_cast<float*>(&copy.albedo));
+            changed |= ImGui::InputFloat(
               "drop-off factor",
-              reinterpret_cast<float*>(&linear->drop_off_factor));
+              reinterpret_cast<float*>(&copy.drop_off_factor));
+            if (changed) {
+              edited = std::make_unique<EmissiveLinearDropOff>(copy);
+            }
           } else if (auto quadratic =
-                       dynamic_cast<EmissiveQuadraticDropOff*>(light.get())) {
+                       dynamic_cast<const EmissiveQuadraticDropOff*>(
+                         material.get())) {
             ImGui::Text("%u. Emissive (Quadratic Drop Off)", i);
-            ImGui::InputFloat3("albedo",
-                               reinterpret_cast<float*>(&quadratic->albedo));
-            ImGui::InputFloat(
+            auto copy = *quadratic;
+            changed |= ImGui::InputFloat3(
+              "albedo", reinterpret_cast<float*>(&copy.albedo));
+            changed |= ImGui::InputFloat(
               "drop-off factor",
-              reinterpret_cast<float*>(&quadratic->drop_off_factor));
-          } else if (auto lambert = dynamic_cast<Lambert*>(light.get())) {
+              reinterpret_cast<float*>(&copy.drop_off_factor));
+            if (changed) {
+              edited = std::make_unique<EmissiveQuadraticDropOff>(copy);
+            }
+          } else if (auto lambert =
+                       dynamic_cast<const Lambert*>(material.get())) {
             ImGui::Text("%u. Lambert (Shadow Ray)", i);
-            ImGui::InputFloat3("albedo",
-                               reinterpret_cast<float*>(&lambert->albedo));
-          } else if (auto metal = dynamic_cast<Metal*>(light.get())) {
+            auto copy = *lambert;
+            changed |= ImGui::InputFloat3(
+              "albedo", reinterpret_cast<float*>(&copy.albedo));
+            if (changed) {
+              edited = std::make_unique<Lambert>(copy);
+            }
+          } else if (auto metal = dynamic_cast<const Metal*>(material.get())) {
             ImGui::Text("%u. Metal", i);
-            ImGui::InputFloat3("albedo",
-                               reinterpret_cast<float*>(&metal->albedo));
+            auto copy = *metal;
+            changed |= ImGui::InputFloat3(
+              "albedo", reinterpret_cast<float*>(&copy.albedo));
+            if (changed) {
+              edited = std::make_unique<Metal>(copy);
+            }
           } else {
             ImGui::Text("%u. Material", i);
           }
+          if (changed) {
+            material = std::move(edited);
+          }
           ImGui::PopID();
           ++i;
           if (ImGui::Button("Remove##materials")) {
@@ -277,38 +356,62 @@ Ui::run(std::unique_ptr<Scene>& scene,
         material_list.emplace_back(new Metal(albedo));
       }
     }
-    if (ImGui::CollapsingHeader("Geometry", ImGuiTreeNodeFlags_DefaultOpen)) {
+    if (scene &&
+        ImGui::CollapsingHeader("Geometry", ImGuiTreeNodeFlags_DefaultOpen)) {
+      // Objects are replaced by an edited copy like materials
       auto& geometry_list = scene->get_world();
+      bool geometry_changed = false;
       uint32_t i = 0;
-      std::vector<std::vector<std::unique_ptr<Object>>::iterator> remove_index;
+      std::vector<std::vector<std::shared_ptr<const Object>>::iterator>
+        remove_index;
       for (auto itr = geometry_list.begin(); itr < geometry_list.end(); ++itr) {
-        auto& light = *itr;
-        if (light) {
+        auto& object = *itr;
+        if (object) {
           ImGui::PushID(i);
-          if (auto point = dynamic_cast<Point*>(light.get())) {
+          std::unique_ptr<Object> edited;
+          bool changed = false;
+          if (auto point = dynamic_cast<const Point*>(object.get())) {
             ImGui::Text("%u. Point", i + 1);
-            ImGui::InputFloat3("position",
-                               reinterpret_cast<float*>(&point->position));
-            ImGui::InputScalar("mat_id", ImGuiDataType_U16, &point->mat_id);
+            auto copy = *point;
+            changed |= ImGui::InputFloat3(
+              "position", reinterpret_cast<float*>(&copy.position));
+            changed |=
+              ImGui::InputScalar("mat_id", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<Point>(copy);
+            }
           } else if (auto line_segment =
-                       dynamic_cast<LineSegment*>(light.get())) {
+                       dynamic_cast<const LineSegment*>(object.get())) {
             ImGui::Text("%u. Line", i + 1);
-            ImGui::InputFloat3(
-              "start", reinterpret_cast<float*>(&line_segment->position[0]));
-            ImGui::InputFloat3(
-              "end", reinterpret_cast<float*>(&line_segment->position[1]));
-            ImGui::InputScalar(
-              "mat_id", ImGuiDataType_U16, &line_segment->mat_id);
-          } else if (auto sphere = dynamic_cast<Sphere*>(light.get())) {
+            auto copy = *line_segment;
+            changed |= ImGui::InputFloat3(
+              "start", reinterpret_cast<float*>(&copy.position[0]));
+            changed |= ImGui::InputFloat3(
+              "end", reinterpret_cast<float*>(&copy.position[1]));
+            changed |=
+              ImGui::InputScalar("mat_id", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<LineSegment>(copy);
+            }
+          } else if (auto sphere = dynamic_cast<const Sphere*>(object.get())) {
             ImGui::Text("%u. Sphere", i + 1);
-            ImGui::InputFloat3("center",
-                               reinterpret_cast<float*>(&sphere->center));
-            ImGui::InputFloat("radius",
-                              reinterpret_cast<float*>(&sphere->radius));
-            ImGui::InputScalar("mat_id", ImGuiDataType_U16, &sphere->mat_id);
+            auto copy = *sphere;
+            changed |= ImGui::InputFloat3(
+              "center", reinterpret_cast<float*>(&copy.center));
+            changed |= ImGui::InputFloat(
+              "radius", reinterpret_cast<float*>(&copy.radius));
+            changed |=
+              ImGui::InputScalar("mat_id", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<Sphere>(copy);
+            }
           } else {
             ImGui::Text("%u. unsupported", i + 1);
           }
+          if (changed) {
+            object = std::move(edited);
+            geometry_changed = true;
+          }
           ++i;
           if (ImGui::Button("Remove##geometry")) {
             remove_index.push_back(itr);
@@ -318,6 +421,7 @@ Ui::run(std::unique_ptr<Scene>& scene,
       }
       for (auto itr : remove_index) {
         geometry_list.erase(itr);
+        geometry_changed = true;
       }
 
       if (ImGui::Button("New Line")) {
@@ -326,52 +430,75 @@ Ui::run(std::unique_ptr<Scene>& scene,
           vec3{ 1, 0, 0 },
         };
         geometry_list.emplace_back(new LineSegment(position, 0));
+        geometry_changed = true;
       }
       if (ImGui::Button("New Point")) {
         const vec3 position = { 0, 0, 0 };
         geometry_list.emplace_back(new Point(position, 0));
+        geometry_changed = true;
       }
       if (ImGui::Button("New Sphere")) {
         const vec3 position = { 0, 0, 0 };
         geometry_list.emplace_back(new Sphere(position, 1, 0));
+        geometry_changed = true;
+      }
+      if (geometry_changed) {
+        scene->mark_geometry_changed();
       }
     }
-    if (ImGui::CollapsingHeader("Lights", ImGuiTreeNodeFlags_DefaultOpen)) {
+    if (scene &&
+        ImGui::CollapsingHeader("Lights", ImGuiTreeNodeFlags_DefaultOpen)) {
       auto& light_list = scene->get_lights();
       auto& geometry_list = scene->get_world();
       uint32_t i = 0;
-      std::vector<std::vector<std::unique_ptr<Object>>::iterator> remove_index;
+      std::vector<std::vector<std::shared_ptr<const Object>>::iterator>
+        remove_index;
       for (auto& light : light_list) {
         if (light) {
           ImGui::PushID(i);
-          if (auto point = dynamic_cast<Point*>(light.get())) {
+          std::unique_ptr<Object> edited;
+          bool changed = false;
+          if (auto point = dynamic_cast<const Point*>(light.get())) {
             ImGui::Text("%u. Point Light", i + 1);
-            ImGui::InputFloat3("position##light",
-                               reinterpret_cast<float*>(&point->position));
-            ImGui::InputScalar(
-              "mat_id##light", ImGuiDataType_U16, &point->mat_id);
+            auto copy = *point;
+            changed |= ImGui::InputFloat3(
+              "position##light", reinterpret_cast<float*>(&copy.position));
+            changed |= ImGui::InputScalar(
+              "mat_id##light", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<Point>(copy);
+            }
           } else if (auto line_segment =
-                       dynamic_cast<LineSegment*>(light.get())) {
+                       dynamic_cast<const LineSegment*>(light.get())) {
             ImGui::Text("%u. Line Light", i + 1);
-            ImGui::InputFloat3(
-              "start##light",
-              reinterpret_cast<float*>(&line_segment->position[0]));
-            ImGui::InputFloat3(
-              "end##light",
-              reinterpret_cast<float*>(&line_segment->position[1]));
-            ImGui::InputScalar(
-              "mat_id##light", ImGuiDataType_U16, &line_segment->mat_id);
-          } else if (auto sphere = dynamic_cast<Sphere*>(light.get())) {
+            auto copy = *line_segment;
+            changed |= ImGui::InputFloat3(
+              "start##light", reinterpret_cast<float*>(&copy.position[0]));
+            changed |= ImGui::InputFloat3(
+              "end##light", reinterpret_cast<float*>(&copy.position[1]));
+            changed |= ImGui::InputScalar(
+              "mat_id##light", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<LineSegment>(copy);
+            }
+          } else if (auto sphere = dynamic_cast<const Sphere*>(light.get())) {
             ImGui::Text("%u. Sphere Light", i + 1);
-            ImGui::InputFloat3("center##light",
-                               reinterpret_cast<float*>(&sphere->center));
-            ImGui::InputFloat("radius##light",
-                              reinterpret_cast<float*>(&sphere->radius));
-            ImGui::InputScalar(
-              "mat_id##light", ImGuiDataType_U16, &sphere->mat_id);
+            auto copy = *sphere;
+            changed |= ImGui::InputFloat3(
+              "center##light", reinterpret_cast<float*>(&copy.center));
+            changed |= ImGui::InputFloat(
+              "radius##light", reinterpret_cast<float*>(&copy.radius));
+            changed |= ImGui::InputScalar(
+              "mat_id##light", ImGuiDataType_U16, &copy.mat_id);
+            if (changed) {
+              edited = std::make_unique<Sphere>(copy);
+            }
           } else {
             ImGui::Text("%u. Light(unsupported)", i + 1);
           }
+          if (changed) {
+            light = std::move(edited);
+          }
           ++i;
           if (ImGui::Button("Remove##light")) {
             remove_index.push_back(geometry_list.begin() + i);
@@ -382,6 +509,9 @@ Ui::run(std::unique_ptr<Scene>& scene,
       for (auto itr : remove_index) {
         geometry_list.erase(itr);
       }
+      if (!remove_index.empty()) {
+        scene->mark_geometry_changed();
+      }
 
       if (ImGui::Button("New Line##light")) {
         const vec3 position[2] = {